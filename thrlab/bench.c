@@ -0,0 +1,783 @@
+#define _DEFAULT_SOURCE
+#include <argp.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "trace.h"
+
+/******************************************************************************
+ * thrlab-bench: sweep barbers x chairs x rate x policy x pin over a number of seeds
+ *****************************************************************************/
+
+enum format
+{
+	FORMAT_CSV,
+	FORMAT_JSON
+};
+
+/**
+ * A list of values to sweep over.
+ */
+struct sweep
+{
+	size_t *values;
+	size_t len;
+};
+
+struct arguments
+{
+	struct sweep barbers;
+	struct sweep chairs;
+	struct sweep rates;
+	char **policies; /* passed as --policy */
+	size_t num_policies;
+	char **pins; /* passed as --pin */
+	size_t num_pins;
+	size_t customers;
+	size_t seeds;
+	size_t first_seed;
+	enum format format;
+	int real_time;
+	const char *thrlab;
+
+	/* passed through to thrlab */
+	char **extra;
+	size_t num_extra;
+};
+
+/**
+ * A growable array of latencies, in nanoseconds.
+ */
+struct samples
+{
+	uint64_t *values;
+	size_t len;
+	size_t capacity;
+};
+
+/**
+ * Everything collected for one barbers x chairs x rate x policy x pin cell.
+ */
+struct cell
+{
+	size_t barbers;
+	size_t chairs;
+	size_t rate;
+	const char *policy;
+	const char *pin;
+
+	size_t runs;
+	size_t failed;
+	double throughput; /* sum over runs, haircuts per second */
+	double throughput_sq;
+	size_t arrivals;
+	size_t rejections;
+	size_t complaints;
+	size_t haircuts;
+	size_t duty_ms; /* barber time on duty, summed over runs */
+
+	struct samples wait;
+	struct samples service;
+	struct samples turnaround;
+};
+
+enum key
+{
+	KEY_SEED = 0x100,
+	KEY_REAL_TIME,
+	KEY_THRLAB
+};
+
+static void samples_push (struct samples *samples, uint64_t value)
+{
+	if (samples->len == samples->capacity)
+	{
+		samples->capacity = samples->capacity ? 2 * samples->capacity : 256;
+		samples->values = realloc
+			( samples->values
+			, samples->capacity * sizeof (*samples->values)
+			);
+		if (samples->values == NULL) exit (EXIT_FAILURE);
+	}
+
+	samples->values[samples->len++] = value;
+}
+
+static int uint64_compare (const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return (x < y) ? -1 : (x > y);
+}
+
+/**
+ * Nearest-rank percentile in milliseconds; the samples must be sorted.
+ */
+static double samples_percentile (const struct samples *samples, double p)
+{
+	if (samples->len == 0)
+		return NAN;
+
+	size_t rank = ceil (p / 100.0 * samples->len);
+
+	if (rank > 0)
+		--rank;
+
+	return samples->values[rank] / 1000000.0;
+}
+
+/**
+ * Mean in milliseconds.
+ */
+static double samples_mean (const struct samples *samples)
+{
+	if (samples->len == 0)
+		return NAN;
+
+	double sum = 0;
+
+	for (size_t i = 0; i < samples->len; ++i)
+		sum += samples->values[i];
+
+	return sum / samples->len / 1000000.0;
+}
+
+/**
+ * Parse "1,2,4" or "1-8" or a mix of the two.
+ */
+static int sweep_parse (struct sweep *sweep, const char *arg, size_t min, size_t max)
+{
+	char *copy = strdup (arg);
+	char *save = NULL;
+
+	if (copy == NULL) return -1;
+
+	sweep->len = 0;
+
+	for (char *item = strtok_r (copy, ",", &save); item; item = strtok_r (NULL, ",", &save))
+	{
+		char *end;
+		size_t from = strtoul (item, &end, 10);
+		size_t to = from;
+
+		if (*end == '-')
+			to = strtoul (end + 1, &end, 10);
+
+		if (*end || from < min || to > max || from > to)
+			goto error;
+
+		for (size_t value = from; value <= to; ++value)
+		{
+			size_t *values = realloc
+				( sweep->values
+				, (sweep->len + 1) * sizeof (*sweep->values)
+				);
+			if (values == NULL) goto error;
+
+			sweep->values = values;
+			sweep->values[sweep->len++] = value;
+		}
+	}
+
+	free (copy);
+
+	return sweep->len ? 0 : -1;
+
+error:
+	free (copy);
+	return -1;
+}
+
+/**
+ * Split "fifo,sjf,aging:2" into its words.
+ */
+static int names_parse (char ***names, size_t *len, const char *arg)
+{
+	char *copy = strdup (arg);
+	char *save = NULL;
+
+	if (copy == NULL) return -1;
+
+	*len = 0;
+
+	for (char *item = strtok_r (copy, ",", &save); item; item = strtok_r (NULL, ",", &save))
+	{
+		char **words = realloc (*names, (*len + 1) * sizeof (**names));
+		if (words == NULL) goto error;
+
+		*names = words;
+		(*names)[(*len)++] = item;
+	}
+
+	if (*len == 0) goto error;
+
+	/* the words point into `copy', which lives as long as the sweep */
+	return 0;
+
+error:
+	/* and go with it */
+	*len = 0;
+	free (copy);
+	return -1;
+}
+
+/**
+ * Run thrlab once and fold its trace and report into `cell`.
+ */
+static int run_once
+	( const struct arguments *arguments
+	, struct cell *cell
+	, size_t seed
+	, const char *dir
+	)
+{
+	char trace_path[PATH_MAX];
+	char report_path[PATH_MAX];
+	char flags[8][64];
+
+	snprintf (trace_path, sizeof (trace_path), "%s/trace", dir);
+	snprintf (report_path, sizeof (report_path), "%s/report", dir);
+
+	snprintf (flags[0], sizeof (flags[0]), "-b%zu", cell->barbers);
+	snprintf (flags[1], sizeof (flags[1]), "-w%zu", cell->chairs);
+	snprintf (flags[2], sizeof (flags[2]), "-r%zu", cell->rate);
+	snprintf (flags[3], sizeof (flags[3]), "-c%zu", arguments->customers);
+	snprintf (flags[4], sizeof (flags[4]), "--seed=%zu", seed);
+	snprintf (flags[5], sizeof (flags[5]), "--log=none");
+	snprintf (flags[6], sizeof (flags[6]), "--policy=%s", cell->policy);
+	snprintf (flags[7], sizeof (flags[7]), "--pin=%s", cell->pin);
+
+	char trace_flag[PATH_MAX + 16];
+	char report_flag[PATH_MAX + 16];
+
+	snprintf (trace_flag, sizeof (trace_flag), "--trace=%s", trace_path);
+	snprintf (report_flag, sizeof (report_flag), "--report=%s", report_path);
+
+	char *argv[16 + arguments->num_extra];
+	size_t argc = 0;
+
+	argv[argc++] = (char *) arguments->thrlab;
+
+	for (size_t i = 0; i < 8; ++i)
+		argv[argc++] = flags[i];
+
+	argv[argc++] = trace_flag;
+	argv[argc++] = report_flag;
+
+	if (!arguments->real_time)
+		argv[argc++] = "--virtual-time";
+
+	for (size_t i = 0; i < arguments->num_extra; ++i)
+		argv[argc++] = arguments->extra[i];
+
+	argv[argc] = NULL;
+
+	pid_t pid = fork ();
+
+	if (pid == -1)
+		return -1;
+
+	if (pid == 0)
+	{
+		int null = open ("/dev/null", O_WRONLY);
+
+		if (null != -1)
+			dup2 (null, STDOUT_FILENO);
+
+		execv (arguments->thrlab, argv);
+		perror (arguments->thrlab);
+		_exit (127);
+	}
+
+	int status;
+
+	while (waitpid (pid, &status, 0) == -1)
+	{
+		if (errno != EINTR)
+			return -1;
+	}
+
+	if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+		return -1;
+
+	/* complaints and leftovers from the report */
+	FILE *report = fopen (report_path, "r");
+	if (report == NULL) return -1;
+
+	char line[256];
+	char name[128];
+	size_t value;
+
+	/* skip the lines that aren't counts, such as an open day's customers */
+	while (fgets (line, sizeof (line), report))
+	{
+		if (sscanf (line, "%127s %zu", name, &value) != 2)
+			continue;
+
+		if (strncmp (name, "complaint.", 10) == 0 || strncmp (name, "live.", 5) == 0)
+			cell->complaints += value;
+		else if (strcmp (name, "barbers.duty_ms") == 0)
+			cell->duty_ms += value;
+	}
+
+	fclose (report);
+
+	/* throughput and latencies from the trace */
+	struct trace_header header;
+	struct trace_record *records;
+	ssize_t count = trace_read (trace_path, &header, &records);
+
+	if (count == -1)
+		return -1;
+
+	size_t customers = arguments->customers;
+	uint64_t (*times)[4] = malloc (customers * sizeof (*times));
+	if (times == NULL) exit (EXIT_FAILURE);
+
+	memset (times, 0xff, customers * sizeof (*times));
+
+	size_t haircuts = 0;
+
+	for (ssize_t i = 0; i < count; ++i)
+	{
+		const struct trace_record *r = &records[i];
+
+		if (r->customer >= customers)
+			continue;
+
+		if (r->type == TRACE_ARRIVE)
+		{
+			times[r->customer][0] = r->ns;
+			++cell->arrivals;
+		}
+		else if (r->type == TRACE_REJECT && r->detail == TRACE_OK)
+		{
+			++cell->rejections;
+		}
+		else if (r->type == TRACE_ACCEPT && r->detail == TRACE_OK)
+		{
+			times[r->customer][1] = r->ns;
+		}
+		else if (r->type == TRACE_PREPARE && r->detail == TRACE_OK)
+		{
+			times[r->customer][2] = r->ns;
+		}
+		else if (r->type == TRACE_DISMISS && r->detail == TRACE_OK)
+		{
+			times[r->customer][3] = r->ns;
+			++haircuts;
+		}
+	}
+
+	for (size_t i = 0; i < customers; ++i)
+	{
+		/* arrived, accepted, prepared, dismissed */
+		const uint64_t *t = times[i];
+
+		if (t[1] != UINT64_MAX && t[2] != UINT64_MAX)
+			samples_push (&cell->wait, t[2] - t[1]);
+
+		if (t[2] != UINT64_MAX && t[3] != UINT64_MAX)
+			samples_push (&cell->service, t[3] - t[2]);
+
+		if (t[0] != UINT64_MAX && t[3] != UINT64_MAX)
+			samples_push (&cell->turnaround, t[3] - t[0]);
+	}
+
+	double duration = count ? records[count - 1].ns / 1000000000.0 : 0;
+	double throughput = duration > 0 ? haircuts / duration : 0;
+
+	cell->haircuts += haircuts;
+	cell->throughput += throughput;
+	cell->throughput_sq += throughput * throughput;
+	++cell->runs;
+
+	free (times);
+	free (records);
+
+	return 0;
+}
+
+static void print_header (enum format format)
+{
+	if (format == FORMAT_JSON)
+	{
+		printf ("[");
+		return;
+	}
+
+	printf
+		( "barbers,chairs,rate,policy,pin,runs,failed,throughput,throughput_sd"
+		  ",reject_ratio,complaints"
+		  ",wait_mean_ms,wait_p50_ms,wait_p90_ms,wait_p99_ms,wait_max_ms"
+		  ",service_p50_ms"
+		  ",turnaround_p50_ms,turnaround_p90_ms,turnaround_p99_ms"
+		  ",barber_seconds,haircuts_per_barber_second\n"
+		);
+}
+
+static void print_cell (enum format format, struct cell *cell, int first)
+{
+	qsort (cell->wait.values, cell->wait.len, sizeof (uint64_t), uint64_compare);
+	qsort (cell->service.values, cell->service.len, sizeof (uint64_t), uint64_compare);
+	qsort (cell->turnaround.values, cell->turnaround.len, sizeof (uint64_t), uint64_compare);
+
+	double mean = cell->runs ? cell->throughput / cell->runs : NAN;
+	double variance = cell->runs
+		? cell->throughput_sq / cell->runs - mean * mean
+		: NAN;
+	double ratio = cell->arrivals
+		? (double) cell->rejections / cell->arrivals
+		: NAN;
+	double barber_seconds = cell->runs
+		? cell->duty_ms / 1000.0 / cell->runs
+		: NAN;
+	double efficiency = cell->duty_ms
+		? cell->haircuts / (cell->duty_ms / 1000.0)
+		: NAN;
+
+	if (format == FORMAT_CSV)
+	{
+		printf
+			( "%zu,%zu,%zu,%s,%s,%zu,%zu,%.3f,%.3f,%.4f,%zu"
+			  ",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f\n"
+			, cell->barbers
+			, cell->chairs
+			, cell->rate
+			, cell->policy
+			, cell->pin
+			, cell->runs
+			, cell->failed
+			, mean
+			, sqrt (variance > 0 ? variance : 0)
+			, ratio
+			, cell->complaints
+			, samples_mean (&cell->wait)
+			, samples_percentile (&cell->wait, 50)
+			, samples_percentile (&cell->wait, 90)
+			, samples_percentile (&cell->wait, 99)
+			, samples_percentile (&cell->wait, 100)
+			, samples_percentile (&cell->service, 50)
+			, samples_percentile (&cell->turnaround, 50)
+			, samples_percentile (&cell->turnaround, 90)
+			, samples_percentile (&cell->turnaround, 99)
+			, barber_seconds
+			, efficiency
+			);
+		return;
+	}
+
+	const struct
+	{
+		const char *name;
+		double value;
+	} fields[] =
+		{ { "throughput", mean }
+		, { "throughput_sd", sqrt (variance > 0 ? variance : 0) }
+		, { "reject_ratio", ratio }
+		, { "wait_mean_ms", samples_mean (&cell->wait) }
+		, { "wait_p50_ms", samples_percentile (&cell->wait, 50) }
+		, { "wait_p90_ms", samples_percentile (&cell->wait, 90) }
+		, { "wait_p99_ms", samples_percentile (&cell->wait, 99) }
+		, { "wait_max_ms", samples_percentile (&cell->wait, 100) }
+		, { "service_p50_ms", samples_percentile (&cell->service, 50) }
+		, { "turnaround_p50_ms", samples_percentile (&cell->turnaround, 50) }
+		, { "turnaround_p90_ms", samples_percentile (&cell->turnaround, 90) }
+		, { "turnaround_p99_ms", samples_percentile (&cell->turnaround, 99) }
+		, { "barber_seconds", barber_seconds }
+		, { "haircuts_per_barber_second", efficiency }
+		};
+
+	printf
+		( "%s\n  { \"barbers\": %zu, \"chairs\": %zu, \"rate\": %zu"
+		  ", \"policy\": \"%s\", \"pin\": \"%s\""
+		  ", \"runs\": %zu, \"failed\": %zu, \"complaints\": %zu"
+		, first ? "" : ","
+		, cell->barbers
+		, cell->chairs
+		, cell->rate
+		, cell->policy
+		, cell->pin
+		, cell->runs
+		, cell->failed
+		, cell->complaints
+		);
+
+	for (size_t i = 0; i < sizeof (fields) / sizeof (*fields); ++i)
+	{
+		/* JSON has no NaN */
+		if (isnan (fields[i].value))
+			printf (", \"%s\": null", fields[i].name);
+		else
+			printf (", \"%s\": %.4f", fields[i].name, fields[i].value);
+	}
+
+	printf (" }");
+}
+
+static void print_footer (enum format format)
+{
+	if (format == FORMAT_JSON)
+		printf ("\n]\n");
+}
+
+static error_t argparse_opt
+	( int key
+	, char *arg
+	, struct argp_state *state
+	)
+{
+	struct arguments *arguments = state->input;
+	char *end;
+
+	switch (key)
+	{
+		case 'b':
+			if (sweep_parse (&arguments->barbers, arg, 1, 49)) argp_usage (state);
+			break;
+		case 'w':
+			if (sweep_parse (&arguments->chairs, arg, 1, 1000)) argp_usage (state);
+			break;
+		case 'r':
+			if (sweep_parse (&arguments->rates, arg, 1, 10000)) argp_usage (state);
+			break;
+		case 'p':
+			if (names_parse (&arguments->policies, &arguments->num_policies, arg))
+				argp_usage (state);
+			break;
+		case 'P':
+			if (names_parse (&arguments->pins, &arguments->num_pins, arg))
+				argp_usage (state);
+			break;
+		case 'c':
+			arguments->customers = strtoul (arg, &end, 10);
+			if (*end || arguments->customers < 1 || arguments->customers > 1000)
+				argp_usage (state);
+			break;
+		case 'n':
+			arguments->seeds = strtoul (arg, &end, 10);
+			if (*end || arguments->seeds < 1) argp_usage (state);
+			break;
+		case 'f':
+			if (strcmp (arg, "csv") == 0)
+				arguments->format = FORMAT_CSV;
+			else if (strcmp (arg, "json") == 0)
+				arguments->format = FORMAT_JSON;
+			else
+				argp_usage (state);
+			break;
+		case KEY_SEED:
+			arguments->first_seed = strtoul (arg, &end, 10);
+			if (*end) argp_usage (state);
+			break;
+		case KEY_REAL_TIME:
+			arguments->real_time = 1;
+			break;
+		case KEY_THRLAB:
+			arguments->thrlab = arg;
+			break;
+		case ARGP_KEY_ARGS:
+			arguments->extra = state->argv + state->next;
+			arguments->num_extra = state->argc - state->next;
+			break;
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+
+	return 0;
+}
+
+static struct arguments argparse (int argc, char **argv)
+{
+	const struct argp argp =
+		{ .options = (struct argp_option [])
+			{ { .name = "barbers", .key = 'b', .arg = "LIST"
+			  , .doc = "Barber counts, e.g. `1,2,4' or `1-8' [default = 3]"
+			  }
+			, { .name = "chairs", .key = 'w', .arg = "LIST"
+			  , .doc = "Waiting chair counts [default = 2]"
+			  }
+			, { .name = "rates", .key = 'r', .arg = "LIST"
+			  , .doc = "Average milliseconds between customers"
+			           " [default = 1000]"
+			  }
+			, { .name = "policies", .key = 'p', .arg = "LIST"
+			  , .doc = "Waiting room policies, e.g. `fifo,sjf,aging:2'"
+			           " [default = fifo]"
+			  }
+			, { .name = "pins", .key = 'P', .arg = "LIST"
+			  , .doc = "Barber CPU pinnings, e.g. `none,compact,spread';"
+			           " only telling with --real-time [default = none]"
+			  }
+			, { .name = "customers", .key = 'c', .arg = "NUM"
+			  , .doc = "Customers per run [default = 100]"
+			  }
+			, { .name = "seeds", .key = 'n', .arg = "NUM"
+			  , .doc = "Runs per cell, with consecutive seeds [default = 5]"
+			  }
+			, { .name = "seed", .key = KEY_SEED, .arg = "NUM"
+			  , .doc = "First seed [default = 1]"
+			  }
+			, { .name = "format", .key = 'f', .arg = "FORMAT"
+			  , .doc = "`csv' or `json' [default = csv]"
+			  }
+			, { .name = "real-time", .key = KEY_REAL_TIME
+			  , .doc = "Run on the wall clock instead of in virtual time"
+			  }
+			, { .name = "thrlab", .key = KEY_THRLAB, .arg = "PATH"
+			  , .doc = "The thrlab binary [default = next to thrlab-bench]"
+			  }
+			, { .name = NULL }
+			}
+		, .parser = argparse_opt
+		, .args_doc = "[-- THRLAB-OPTIONS...]"
+		, .doc = "thrlab-bench -- sweep shop configurations and tabulate"
+		         " throughput, rejections, complaints and latency, side by"
+		         " side for each waiting room policy and pinning"
+		};
+
+	static size_t default_barbers[] = { 3 };
+	static size_t default_chairs[] = { 2 };
+	static size_t default_rates[] = { 1000 };
+	static char *default_policies[] = { "fifo" };
+	static char *default_pins[] = { "none" };
+
+	struct arguments arguments = (struct arguments)
+		{ .policies = NULL
+		, .num_policies = 0
+		, .pins = NULL
+		, .num_pins = 0
+		, .customers = 100
+		, .seeds = 5
+		, .first_seed = 1
+		, .format = FORMAT_CSV
+		, .real_time = 0
+		, .thrlab = NULL
+		, .extra = NULL
+		, .num_extra = 0
+		};
+
+	argp_parse (&argp, argc, argv, 0, NULL, &arguments);
+
+	if (arguments.barbers.len == 0)
+		arguments.barbers = (struct sweep) { default_barbers, 1 };
+
+	if (arguments.chairs.len == 0)
+		arguments.chairs = (struct sweep) { default_chairs, 1 };
+
+	if (arguments.rates.len == 0)
+		arguments.rates = (struct sweep) { default_rates, 1 };
+
+	if (arguments.num_policies == 0)
+	{
+		arguments.policies = default_policies;
+		arguments.num_policies = 1;
+	}
+
+	if (arguments.num_pins == 0)
+	{
+		arguments.pins = default_pins;
+		arguments.num_pins = 1;
+	}
+
+	return arguments;
+}
+
+int main (int argc, char **argv)
+{
+	struct arguments arguments = argparse (argc, argv);
+	static char thrlab[PATH_MAX];
+
+	if (arguments.thrlab == NULL)
+	{
+		ssize_t len = readlink ("/proc/self/exe", thrlab, sizeof (thrlab) - 1);
+
+		if (len == -1)
+		{
+			perror ("/proc/self/exe");
+			return EXIT_FAILURE;
+		}
+
+		thrlab[len] = '\0';
+		snprintf (thrlab + strlen (dirname (thrlab)), sizeof (thrlab) - strlen (thrlab), "/thrlab");
+		arguments.thrlab = thrlab;
+	}
+
+	char dir[] = "/tmp/thrlab-bench.XXXXXX";
+
+	if (mkdtemp (dir) == NULL)
+	{
+		perror ("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	print_header (arguments.format);
+
+	int first = 1;
+
+	for (size_t b = 0; b < arguments.barbers.len; ++b)
+	for (size_t w = 0; w < arguments.chairs.len; ++w)
+	for (size_t r = 0; r < arguments.rates.len; ++r)
+	for (size_t p = 0; p < arguments.num_policies; ++p)
+	for (size_t q = 0; q < arguments.num_pins; ++q)
+	{
+		struct cell cell = (struct cell)
+			{ .barbers = arguments.barbers.values[b]
+			, .chairs = arguments.chairs.values[w]
+			, .rate = arguments.rates.values[r]
+			, .policy = arguments.policies[p]
+			, .pin = arguments.pins[q]
+			};
+
+		for (size_t i = 0; i < arguments.seeds; ++i)
+		{
+			size_t seed = arguments.first_seed + i;
+
+			if (run_once (&arguments, &cell, seed, dir) != 0)
+			{
+				fprintf
+					( stderr
+					, "thrlab-bench: -b%zu -w%zu -r%zu --policy=%s --pin=%s"
+					  " --seed=%zu failed\n"
+					, cell.barbers
+					, cell.chairs
+					, cell.rate
+					, cell.policy
+					, cell.pin
+					, seed
+					);
+				++cell.failed;
+			}
+		}
+
+		print_cell (arguments.format, &cell, first);
+		fflush (stdout);
+		first = 0;
+
+		free (cell.wait.values);
+		free (cell.service.values);
+		free (cell.turnaround.values);
+	}
+
+	print_footer (arguments.format);
+
+	char path[PATH_MAX];
+
+	snprintf (path, sizeof (path), "%s/trace", dir);
+	unlink (path);
+	snprintf (path, sizeof (path), "%s/report", dir);
+	unlink (path);
+	rmdir (dir);
+
+	return EXIT_SUCCESS;
+}
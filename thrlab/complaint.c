@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include "complaint.h"
+
+const struct complaint_info complaints[NUM_COMPLAINTS] =
+	{ [COMPLAINT_REJECT_AVAIL] =
+		{ "complaint.reject_avail"
+		, "  - %zu %s shown the door, but witnessed that seats were"
+		  " available! (If this is the only complaint, then this might be OK)\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_REJECT_WAIT] =
+		{ "complaint.reject_wait"
+		, "  - %zu %s shown the door whilst waiting for a barber!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_REJECT_CUT] =
+		{ "complaint.reject_cut"
+		, "  - %zu %s shown the door in the middle of a haircut!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_REJECT_DONE] =
+		{ "complaint.reject_done"
+		, "  - %zu %s told to come come back to be shown the door,"
+		  " after having gotten their haircut!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_REJECT_AGAIN] =
+		{ "complaint.reject_again"
+		, "  - %zu %s shown the door, repeatedly!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_ACCEPT_FULL] =
+		{ "complaint.accept_full"
+		, "  - %zu couldn't find a chair and had to wait in the hallway!\n"
+		, ""
+		, ""
+		}
+	, [COMPLAINT_ACCEPT_WAIT] =
+		{ "complaint.accept_wait"
+		, "  - %zu %s told to come inside and wait, whilst already"
+		  " waiting!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_ACCEPT_CUT] =
+		{ "complaint.accept_cut"
+		, "  - %zu %s told to come inside and wait, whilst their"
+		  " barber was alredy cutting their hair!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_ACCEPT_DONE] =
+		{ "complaint.accept_done"
+		, "  - %zu %s told to come inside and wait, already having"
+		  " received their haircuts!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_ACCEPT_REJECT] =
+		{ "complaint.accept_reject"
+		, "  - %zu %s told to come inside and wait, after having been"
+		  " rejected earlier!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_PREPARE_PENDING] =
+		{ "complaint.prepare_pending"
+		, "  - %zu had to have their haircut outside!\n"
+		, ""
+		, ""
+		}
+	, [COMPLAINT_PREPARE_BUSY] =
+		{ "complaint.prepare_busy"
+		, "  - %zu %s told their barber was ready, but it turned out they"
+		  " were otherwise occupied!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_PREPARE_AGAIN] =
+		{ "complaint.prepare_again"
+		, "  - %zu %s told \"their\" barber was ready, but a barber was"
+		  " already cutting their hairs!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_PREPARE_DONE] =
+		{ "complaint.prepare_done"
+		, "  - %zu %s told their barber was ready, but had already just"
+		  " gotten their haircuts!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_PREPARE_REJECT] =
+		{ "complaint.prepare_reject"
+		, "  - %zu %s told their barber was ready, after having previously"
+		  " been rejected!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_PREPARE_SELF] =
+		{ "complaint.prepare_self"
+		, "  - %zu had to cut their own hair!\n"
+		, ""
+		, ""
+		}
+	, [COMPLAINT_PREPARE_SHOP] =
+		{ "complaint.prepare_shop"
+		, "  - %zu %s called to a barber's chair in another shop!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_DISMISS_PENDING] =
+		{ "complaint.dismiss_pending"
+		, "  - %zu %s told they had already received their haircuts when"
+		  " they even hadn't entered the building yet!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_DISMISS_WAIT] =
+		{ "complaint.dismiss_wait"
+		, "  - %zu %s told they had already received their haircuts whilst"
+		  " waiting in the waiting room!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_DISMISS_DONE] =
+		{ "complaint.dismiss_done"
+		, "  - %zu %s asked to leave the barber's room, repeatedly!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_DISMISS_REJECT] =
+		{ "complaint.dismiss_reject"
+		, "  - %zu %s told that they had already received their haircuts,"
+		  " but were previously rejected entry!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_DISMISS_ROOM] =
+		{ "complaint.dismiss_room"
+		, "  - A barber saw a false positive customer on %zu occasion%s!\n"
+		, ""
+		, "s"
+		}
+	, [COMPLAINT_DISMISS_SELF] =
+		{ "complaint.dismiss_self"
+		, "  - %zu had to show themselves to the door!\n"
+		, ""
+		, ""
+		}
+	, [COMPLAINT_DISMISS_SHOP] =
+		{ "complaint.dismiss_shop"
+		, "  - %zu %s shown the door by a barber from another shop!\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_DISMISS_EARLY] =
+		{ "complaint.dismiss_early"
+		, "  - %zu lost their %s while undergoing a haircut!\n"
+		, "life"
+		, "lives"
+		}
+	, [COMPLAINT_CUT_FAST] =
+		{ "complaint.cut_fast"
+		, "  - %zu %s cut way too fast! You better call Saul, neither you"
+		  " nor the public are ready to witness this.\n"
+		, "was"
+		, "were"
+		}
+	, [COMPLAINT_CUT_SLOW] =
+		{ "complaint.cut_slow"
+		, "  - %zu hair was cut too slowly! (This will happen with many threads and is fine)\n"
+		, ""
+		, ""
+		}
+	};
+
+size_t complaint_print
+	( const size_t counts[NUM_COMPLAINTS]
+	, size_t cutting
+	, size_t waiting
+	, size_t pending
+	)
+{
+	size_t total = cutting + waiting + pending;
+
+	for (size_t i = 0; i < NUM_COMPLAINTS; ++i)
+		total += counts[i];
+
+	if (total == 0)
+		return 0;
+
+	printf
+		( "\nOH NO%s! %s submitted %s!\n"
+		, (total > 1) ? "ES" : ""
+		, (total > 1) ? "Some customers" : "A customer"
+		, (total > 1) ? "a number of complaints" : "a complaint"
+		);
+
+	size_t forgotten = cutting + waiting;
+
+	if (forgotten)
+	{
+		printf
+			("  - %zu customer%s locked inside!"
+			, forgotten
+			, (forgotten > 1) ? "s were" : " was"
+			);
+
+		if (cutting)
+		{
+			printf
+				( ", of which %zu %s still being cut!\n"
+				, cutting
+				, (cutting > 1) ? "were" : "was"
+				);
+		}
+		else
+		{
+			printf ("!\n");
+		}
+	}
+
+	if (pending)
+	{
+		printf
+			( "  - %zu %s never greeted at the door!\n"
+			, pending
+			, (pending > 1) ? "were" : "was"
+			);
+	}
+
+	for (size_t i = 0; i < NUM_COMPLAINTS; ++i)
+	{
+		if (counts[i])
+		{
+			printf
+				( complaints[i].format
+				, counts[i]
+				, (counts[i] > 1) ? complaints[i].many : complaints[i].one
+				);
+		}
+	}
+
+	return total;
+}
@@ -0,0 +1,69 @@
+#ifndef _THRLAB_COMPLAINT_H_
+#define _THRLAB_COMPLAINT_H_
+
+#include <stddef.h>
+
+/**
+ * Ways a customer can be let down.
+ */
+enum complaint
+{
+	COMPLAINT_REJECT_AVAIL, /* rejected with seats available */
+	COMPLAINT_REJECT_WAIT, /* a waiting customer was shown the door */
+	COMPLAINT_REJECT_CUT, /* customer rejected mid-cut */
+	COMPLAINT_REJECT_DONE, /* rejected entry after a haircut */
+	COMPLAINT_REJECT_AGAIN, /* rejected more than once */
+	COMPLAINT_ACCEPT_FULL, /* accepted while seats were unavailable */
+	COMPLAINT_ACCEPT_WAIT, /* accepted while waiting */
+	COMPLAINT_ACCEPT_CUT, /* accepted while being cut */
+	COMPLAINT_ACCEPT_DONE, /* accepted when done */
+	COMPLAINT_ACCEPT_REJECT, /* accepted after rejection */
+	COMPLAINT_PREPARE_PENDING, /* prepared without being let in first */
+	COMPLAINT_PREPARE_BUSY, /* prepared while barber's busy */
+	COMPLAINT_PREPARE_AGAIN, /* prepared more than once */
+	COMPLAINT_PREPARE_DONE, /* prepared after leaving */
+	COMPLAINT_PREPARE_REJECT, /* prepared after being rejected */
+	COMPLAINT_PREPARE_SELF, /* customer had to cut their own hair */
+	COMPLAINT_PREPARE_SHOP, /* prepared by a barber from another shop */
+	COMPLAINT_DISMISS_PENDING, /* dismissed outside */
+	COMPLAINT_DISMISS_WAIT, /* dismissed while waiting */
+	COMPLAINT_DISMISS_DONE, /* dismissed again */
+	COMPLAINT_DISMISS_REJECT, /* dismissed after rejection */
+	COMPLAINT_DISMISS_ROOM, /* told to dismiss, but wrong room */
+	COMPLAINT_DISMISS_SELF, /* told to show themselves to the door */
+	COMPLAINT_DISMISS_SHOP, /* dismissed by a barber from another shop */
+	COMPLAINT_DISMISS_EARLY, /* customer thread died before dismissal */
+	COMPLAINT_CUT_FAST, /* barber in a hurry, too fast */
+	COMPLAINT_CUT_SLOW, /* barber too slow */
+	NUM_COMPLAINTS
+};
+
+/**
+ * Complaints, as reported and as printed: `format' takes the count, then
+ * `one' or `many' to agree with it.
+ */
+struct complaint_info
+{
+	const char *name;
+	const char *format;
+	const char *one;
+	const char *many;
+};
+
+extern const struct complaint_info complaints[NUM_COMPLAINTS];
+
+/**
+ * Print what the customers made of their day, given how many of each
+ * complaint there were and how many customers were left inside, in the
+ * middle of a haircut, or at the door. Prints nothing if all went well.
+ *
+ * Returns the number of complaints, counting everyone left behind.
+ */
+size_t complaint_print
+	( const size_t counts[NUM_COMPLAINTS]
+	, size_t cutting
+	, size_t waiting
+	, size_t pending
+	);
+
+#endif
@@ -0,0 +1,473 @@
+#define _DEFAULT_SOURCE
+#include <argp.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "names.h"
+#include "trace.h"
+
+/******************************************************************************
+ * thrlab-decode: turn a binary trace back into something readable
+ *****************************************************************************/
+
+enum format
+{
+	FORMAT_TEXT,
+	FORMAT_CSV,
+	FORMAT_SUMMARY
+};
+
+struct arguments
+{
+	enum format format;
+	const char *path;
+};
+
+/* a visitor timestamp that wasn't recorded */
+#define NEVER UINT64_MAX
+
+/**
+ * What is known about a customer from their records.
+ */
+struct visitor
+{
+	const char *name;
+	uint64_t arrived;
+	uint64_t accepted;
+	uint64_t prepared;
+	uint64_t dismissed;
+};
+
+static const char *type_names[] =
+	{ [TRACE_NONE] = "none"
+	, [TRACE_ARRIVE] = "arrive"
+	, [TRACE_ACCEPT] = "accept"
+	, [TRACE_REJECT] = "reject"
+	, [TRACE_PREPARE] = "prepare"
+	, [TRACE_DISMISS] = "dismiss"
+	, [TRACE_LEAVE] = "leave"
+	};
+
+static const char *outcome_names[] =
+	{ [TRACE_OK] = "ok"
+	, [TRACE_CONFUSED] = "confused"
+	, [TRACE_SELF] = "self"
+	, [TRACE_BUSY] = "busy"
+	, [TRACE_ROOM] = "room"
+	, [TRACE_SHOP] = "shop"
+	};
+
+static const char *possessive (const char *name)
+{
+	return (name[strlen (name) - 1] == 's') ? "" : "s";
+}
+
+static void print_text (const struct trace_record *r, const char *name)
+{
+	const char *barber = barber_name (r->room);
+
+	/* thrlab doesn't log anything when a customer's thread is done */
+	if (r->type == TRACE_LEAVE)
+		return;
+
+	printf ("%9.3f: ", r->ns / 1000000000.0);
+
+	switch (r->type)
+	{
+		case TRACE_ARRIVE:
+			printf ("%s (#%u) arrives at the door.\n", name, r->customer);
+			break;
+		case TRACE_ACCEPT:
+			if (r->detail == TRACE_OK)
+				printf ("%s (#%u) waits.\n", name, r->customer);
+			else
+				printf ("%s (#%u) is confused!\n", name, r->customer);
+			break;
+		case TRACE_REJECT:
+			if (r->detail == TRACE_OK)
+				printf ("%s (#%u) was turned away!\n", name, r->customer);
+			else
+				printf ("%s (#%u) is confused!\n", name, r->customer);
+			break;
+		case TRACE_PREPARE:
+			switch (r->detail)
+			{
+				case TRACE_BUSY:
+					printf
+						( "%s'%s (#%u) confused! %s is busy cutting someone"
+						  " else!\n"
+						, name
+						, possessive (name)
+						, r->customer
+						, barber
+						);
+					break;
+				case TRACE_SHOP:
+					printf
+						( "%s'%s (#%u) confused! %s works in another shop!\n"
+						, name
+						, possessive (name)
+						, r->customer
+						, barber
+						);
+					break;
+				case TRACE_OK:
+					printf
+						( "%s begins giving %s (#%u) a haircut in room %u\n"
+						, barber
+						, name
+						, r->customer
+						, r->room
+						);
+					break;
+				case TRACE_SELF:
+					printf
+						( "%s orders %s (#%u) to cut their own hair!\n"
+						, barber
+						, name
+						, r->customer
+						);
+					break;
+				default:
+					printf
+						( "%s and %s (#%u) are confused!\n"
+						, barber
+						, name
+						, r->customer
+						);
+					break;
+			}
+			break;
+		case TRACE_DISMISS:
+			switch (r->detail)
+			{
+				case TRACE_ROOM:
+					printf
+						( "%s'%s confused! %s (#%u) wasn't found in their"
+						  " room!\n"
+						, barber
+						, possessive (barber)
+						, name
+						, r->customer
+						);
+					break;
+				case TRACE_SHOP:
+					printf
+						( "%s'%s confused! %s (#%u) waited in another shop!\n"
+						, barber
+						, possessive (barber)
+						, name
+						, r->customer
+						);
+					break;
+				case TRACE_OK:
+					printf
+						( "%s finishes cutting %s'%s (#%u) hair.\n"
+						, barber
+						, name
+						, possessive (name)
+						, r->customer
+						);
+					break;
+				case TRACE_SELF:
+					printf
+						( "%s orders %s (#%u) to show themselves to the door"
+						  " after their haircut!\n"
+						, barber
+						, name
+						, r->customer
+						);
+					break;
+				default:
+					printf
+						( "%s and %s (#%u) are confused!\n"
+						, barber
+						, name
+						, r->customer
+						);
+					break;
+			}
+			break;
+	}
+}
+
+static void print_csv (const struct trace_record *r, const char *name)
+{
+	printf ("%llu,%s,%u,%s,", (unsigned long long) r->ns, type_names[r->type], r->customer, name);
+
+	if (r->room != TRACE_NO_ROOM)
+		printf ("%u", r->room);
+
+	printf
+		( ",%s\n"
+		, (r->type == TRACE_ARRIVE || r->detail >= sizeof (outcome_names) / sizeof (*outcome_names))
+		  ? ""
+		  : outcome_names[r->detail]
+		);
+}
+
+static void print_summary_line (const char *what, uint64_t total, size_t count)
+{
+	if (count == 0)
+		return;
+
+	printf
+		( "  %-12s mean %9.3f ms over %zu customers\n"
+		, what
+		, total / 1000000.0 / count
+		, count
+		);
+}
+
+static void print_summary
+	( const struct trace_header *header
+	, const struct trace_record *records
+	, size_t count
+	, const struct visitor *visitors
+	, size_t num_visitors
+	)
+{
+	size_t by_type[TRACE_LEAVE + 1][TRACE_SHOP + 1] = { { 0 } };
+	size_t *cuts = calloc (header->barbers, sizeof (*cuts));
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const struct trace_record *r = &records[i];
+
+		if (r->type == TRACE_ARRIVE)
+			++by_type[r->type][TRACE_OK];
+		else if (r->detail <= TRACE_SHOP)
+			++by_type[r->type][r->detail];
+
+		if (r->type == TRACE_DISMISS && r->detail == TRACE_OK && r->room < header->barbers)
+			++cuts[r->room];
+	}
+
+	uint64_t duration = count ? records[count - 1].ns : 0;
+
+	printf
+		( "%u barbers, %u chairs, one customer every %llu ms on average\n"
+		, header->barbers
+		, header->chairs
+		, (unsigned long long) header->rate
+		);
+
+	printf
+		( "%zu events over %.3f s%s\n\n"
+		, count
+		, duration / 1000000000.0
+		, (header->claimed > header->capacity) ? " (trace wrapped, oldest events lost)" : ""
+		);
+
+	if (header->flags & TRACE_RECORD_ONLY)
+		printf ("Recorded only: nothing was checked, see thrlab-validate\n\n");
+
+	for (int type = TRACE_ARRIVE; type <= TRACE_DISMISS; ++type)
+	{
+		printf ("  %-8s %8zu", type_names[type], by_type[type][TRACE_OK]);
+
+		for (int outcome = TRACE_CONFUSED; outcome <= TRACE_SHOP; ++outcome)
+		{
+			if (by_type[type][outcome])
+				printf (", %zu %s", by_type[type][outcome], outcome_names[outcome]);
+		}
+
+		printf ("\n");
+	}
+
+	uint64_t wait = 0, service = 0, turnaround = 0;
+	size_t num_wait = 0, num_service = 0, num_turnaround = 0;
+
+	for (size_t i = 0; i < num_visitors; ++i)
+	{
+		const struct visitor *v = &visitors[i];
+
+		if (v->accepted != NEVER && v->prepared != NEVER)
+		{
+			wait += v->prepared - v->accepted;
+			++num_wait;
+		}
+
+		if (v->prepared != NEVER && v->dismissed != NEVER)
+		{
+			service += v->dismissed - v->prepared;
+			++num_service;
+		}
+
+		if (v->arrived != NEVER && v->dismissed != NEVER)
+		{
+			turnaround += v->dismissed - v->arrived;
+			++num_turnaround;
+		}
+	}
+
+	printf ("\n");
+	print_summary_line ("queue wait", wait, num_wait);
+	print_summary_line ("service", service, num_service);
+	print_summary_line ("turnaround", turnaround, num_turnaround);
+
+	if (duration)
+	{
+		printf
+			( "\n  throughput %.2f haircuts/s\n"
+			, by_type[TRACE_DISMISS][TRACE_OK] / (duration / 1000000000.0)
+			);
+	}
+
+	for (size_t room = 0; room < header->barbers; ++room)
+		printf ("  room %2zu %-14s %zu haircuts\n", room, barber_name (room), cuts[room]);
+
+	free (cuts);
+}
+
+static error_t argparse_opt
+	( int key
+	, char *arg
+	, struct argp_state *state
+	)
+{
+	struct arguments *arguments = state->input;
+
+	switch (key)
+	{
+		case 'f':
+			if (strcmp (arg, "text") == 0)
+				arguments->format = FORMAT_TEXT;
+			else if (strcmp (arg, "csv") == 0)
+				arguments->format = FORMAT_CSV;
+			else if (strcmp (arg, "summary") == 0)
+				arguments->format = FORMAT_SUMMARY;
+			else
+				argp_usage (state);
+			break;
+		case ARGP_KEY_ARG:
+			if (arguments->path) argp_usage (state);
+			arguments->path = arg;
+			break;
+		case ARGP_KEY_END:
+			if (arguments->path == NULL) argp_usage (state);
+			break;
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+
+	return 0;
+}
+
+int main (int argc, char **argv)
+{
+	const struct argp argp =
+		{ .options = (struct argp_option [])
+			{ { .name = "format", .key = 'f', .arg = "FORMAT"
+			  , .doc = "`text' (as thrlab would have logged it), `csv' or"
+			           " `summary' [default = text]"
+			  }
+			, { .name = NULL }
+			}
+		, .parser = argparse_opt
+		, .args_doc = "TRACE"
+		, .doc = "thrlab-decode -- read a trace recorded with thrlab --trace"
+		};
+
+	struct arguments arguments = (struct arguments)
+		{ .format = FORMAT_TEXT
+		, .path = NULL
+		};
+
+	argp_parse (&argp, argc, argv, 0, NULL, &arguments);
+
+	struct trace_header header;
+	struct trace_record *records;
+	ssize_t count = trace_read (arguments.path, &header, &records);
+
+	if (count == -1)
+	{
+		if (errno == EINVAL)
+			fprintf (stderr, "%s: not a thrlab trace\n", arguments.path);
+		else
+			perror (arguments.path);
+
+		return EXIT_FAILURE;
+	}
+
+	size_t num_visitors = 0;
+
+	for (ssize_t i = 0; i < count; ++i)
+	{
+		if (records[i].customer >= num_visitors)
+			num_visitors = records[i].customer + 1;
+	}
+
+	struct visitor *visitors = malloc ((num_visitors + 1) * sizeof (*visitors));
+	if (visitors == NULL) goto error_memory;
+
+	for (size_t i = 0; i < num_visitors; ++i)
+	{
+		visitors[i] = (struct visitor)
+			{ .name = NULL
+			, .arrived = NEVER
+			, .accepted = NEVER
+			, .prepared = NEVER
+			, .dismissed = NEVER
+			};
+	}
+
+	for (ssize_t i = 0; i < count; ++i)
+	{
+		const struct trace_record *r = &records[i];
+		struct visitor *v = &visitors[r->customer];
+
+		if (r->type == TRACE_ARRIVE && r->detail < num_customer_names)
+		{
+			v->name = customer_names[r->detail];
+			v->arrived = r->ns;
+		}
+
+		if (r->detail == TRACE_OK)
+		{
+			if (r->type == TRACE_ACCEPT)
+				v->accepted = r->ns;
+			else if (r->type == TRACE_PREPARE)
+				v->prepared = r->ns;
+			else if (r->type == TRACE_DISMISS)
+				v->dismissed = r->ns;
+		}
+	}
+
+	switch (arguments.format)
+	{
+		case FORMAT_TEXT:
+		case FORMAT_CSV:
+			if (arguments.format == FORMAT_CSV)
+				printf ("ns,event,customer,name,room,outcome\n");
+
+			for (ssize_t i = 0; i < count; ++i)
+			{
+				const char *name = visitors[records[i].customer].name;
+
+				if (name == NULL)
+					name = "?";
+
+				if (arguments.format == FORMAT_TEXT)
+					print_text (&records[i], name);
+				else
+					print_csv (&records[i], name);
+			}
+			break;
+		case FORMAT_SUMMARY:
+			print_summary (&header, records, count, visitors, num_visitors);
+			break;
+	}
+
+	free (visitors);
+	free (records);
+
+	return EXIT_SUCCESS;
+
+error_memory:
+	fprintf (stderr, "%s: out of memory\n", arguments.path);
+	return EXIT_FAILURE;
+}
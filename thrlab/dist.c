@@ -0,0 +1,220 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dist.h"
+
+static const struct
+{
+	const char *name;
+	enum dist_kind kind;
+	double shapes[DIST_PARAMS]; /* defaults past the first parameter */
+} dist_kinds[] =
+	{ { "const", DIST_CONST, { NAN, NAN, NAN } }
+	, { "uniform", DIST_UNIFORM, { NAN, NAN, NAN } }
+	, { "exp", DIST_EXP, { NAN, NAN, NAN } }
+	, { "normal", DIST_NORMAL, { NAN, NAN, NAN } }
+	, { "lognormal", DIST_LOGNORMAL, { NAN, 1, NAN } }
+	, { "pareto", DIST_PARETO, { NAN, 2, NAN } }
+	, { "mmpp", DIST_MMPP, { NAN, 10, 20 } }
+	};
+
+#define DIST_NUM_KINDS (sizeof (dist_kinds) / sizeof (*dist_kinds))
+
+/* parameters each kind takes */
+static const int dist_arity[] =
+	{ [DIST_CONST] = 1
+	, [DIST_UNIFORM] = 2
+	, [DIST_EXP] = 1
+	, [DIST_NORMAL] = 2
+	, [DIST_LOGNORMAL] = 2
+	, [DIST_PARETO] = 2
+	, [DIST_MMPP] = 3
+	};
+
+int dist_parse (struct dist *dist, const char *spec)
+{
+	assert (dist);
+	assert (spec);
+
+	size_t len = strcspn (spec, ":");
+	size_t i;
+
+	for (i = 0; i < DIST_NUM_KINDS; ++i)
+	{
+		if (strlen (dist_kinds[i].name) == len
+			&& strncmp (dist_kinds[i].name, spec, len) == 0)
+			break;
+	}
+
+	if (i == DIST_NUM_KINDS)
+		return -1;
+
+	dist->kind = dist_kinds[i].kind;
+	dist->bursting = 0;
+
+	for (int p = 0; p < DIST_PARAMS; ++p)
+		dist->params[p] = NAN;
+
+	if (spec[len] == '\0')
+		return 0;
+
+	const char *s = spec + len + 1;
+
+	for (int p = 0; ; ++p)
+	{
+		char *end;
+
+		if (p == dist_arity[dist->kind])
+			return -1;
+
+		dist->params[p] = strtod (s, &end);
+
+		if (end == s || !isfinite (dist->params[p]))
+			return -1;
+
+		if (*end == '\0')
+			return 0;
+
+		if (*end != ',')
+			return -1;
+
+		s = end + 1;
+	}
+}
+
+int dist_finish (struct dist *dist, double mean)
+{
+	assert (dist);
+
+	double *p = dist->params;
+
+	if (dist->kind == DIST_UNIFORM && isnan (p[0]) && !isnan (mean))
+	{
+		p[0] = 0;
+		p[1] = 2 * mean;
+	}
+
+	if (isnan (p[0]))
+		p[0] = mean;
+
+	for (int i = 1; i < dist_arity[dist->kind]; ++i)
+	{
+		if (isnan (p[i]))
+			p[i] = dist_kinds[dist->kind].shapes[i];
+	}
+
+	for (int i = 0; i < dist_arity[dist->kind]; ++i)
+	{
+		if (isnan (p[i]) || p[i] < 0)
+			return -1;
+	}
+
+	switch (dist->kind)
+	{
+		case DIST_CONST:
+		case DIST_EXP:
+		case DIST_NORMAL:
+			break;
+		case DIST_UNIFORM:
+			if (p[0] != floor (p[0]) || p[1] != floor (p[1])
+				|| p[1] <= p[0] || p[1] - p[0] > UINT32_MAX)
+				return -1;
+			break;
+		case DIST_LOGNORMAL:
+			if (p[0] <= 0) return -1;
+
+			dist->a = log (p[0]) - p[1] * p[1] / 2;
+			break;
+		case DIST_PARETO:
+			if (p[1] <= 1) return -1;
+
+			/* scale so the mean comes out as asked */
+			dist->a = p[0] * (p[1] - 1) / p[1];
+			break;
+		case DIST_MMPP:
+			if (p[1] < 1 || p[2] < 1) return -1;
+
+			/* half the draws in each phase, so the means average out */
+			dist->a = p[0] / p[1];
+			dist->b = p[0] * (2 - 1 / p[1]);
+			break;
+	}
+
+	return 0;
+}
+
+/**
+ * A uniform double in (0, 1).
+ */
+static double dist_unit (uint32_t (*random) (uint32_t))
+{
+	return (random (UINT32_MAX) + 0.5) / UINT32_MAX;
+}
+
+static double dist_exp (double mean, uint32_t (*random) (uint32_t))
+{
+	return -mean * log (dist_unit (random));
+}
+
+static double dist_gauss (uint32_t (*random) (uint32_t))
+{
+	/* Box-Muller, throwing away the second value */
+	double u = dist_unit (random);
+	double v = dist_unit (random);
+
+	return sqrt (-2 * log (u)) * cos (2 * M_PI * v);
+}
+
+/**
+ * Keep a draw within +/-DIST_MAX; a NaN counts as 0.
+ */
+static double dist_clamp (double value)
+{
+	if (value > DIST_MAX)
+		return DIST_MAX;
+
+	if (value < -DIST_MAX)
+		return -DIST_MAX;
+
+	return isnan (value) ? 0 : value;
+}
+
+/**
+ * The draw itself, unclamped.
+ */
+static double dist_draw (struct dist *dist, uint32_t (*random) (uint32_t))
+{
+	const double *p = dist->params;
+
+	switch (dist->kind)
+	{
+		case DIST_CONST:
+			return p[0];
+		case DIST_UNIFORM:
+			return p[0] + random (p[1] - p[0]);
+		case DIST_EXP:
+			return dist_exp (p[0], random);
+		case DIST_NORMAL:
+			return p[0] + p[1] * dist_gauss (random);
+		case DIST_LOGNORMAL:
+			return exp (dist->a + p[1] * dist_gauss (random));
+		case DIST_PARETO:
+			return dist->a / pow (dist_unit (random), 1 / p[1]);
+		case DIST_MMPP:
+			if (dist_unit (random) < 1 / p[2])
+				dist->bursting = !dist->bursting;
+
+			return dist_exp (dist->bursting ? dist->a : dist->b, random);
+	}
+
+	return p[0];
+}
+
+double dist_sample (struct dist *dist, uint32_t (*random) (uint32_t))
+{
+	assert (dist);
+	assert (random);
+
+	return dist_clamp (dist_draw (dist, random));
+}
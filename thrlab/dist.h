@@ -0,0 +1,77 @@
+#ifndef _THRLAB_DIST_H_
+#define _THRLAB_DIST_H_
+
+#include <stdint.h>
+
+/**
+ * Random distributions for arrivals and hair, described on the command line
+ * as `KIND[:P1[,P2[,P3]]]':
+ *
+ *   const:V                  always V
+ *   uniform:LO,HI            an integer in [LO, HI)
+ *   exp:MEAN                 exponential; as arrivals, a Poisson process
+ *   normal:MEAN,SD           Gaussian
+ *   lognormal:MEAN,SIGMA     log-normal with the given mean and log-space SD
+ *   pareto:MEAN,ALPHA        Pareto with shape ALPHA > 1, heavy-tailed
+ *   mmpp:MEAN,FACTOR,DWELL   exponential, alternating between bursts FACTOR
+ *                            times faster than MEAN and calm spells slow
+ *                            enough to keep the overall mean; phases last
+ *                            DWELL draws on average
+ *
+ * Trailing parameters may be left out where a default is given to
+ * `dist_finish'.
+ */
+
+enum dist_kind
+{
+	DIST_CONST,
+	DIST_UNIFORM,
+	DIST_EXP,
+	DIST_NORMAL,
+	DIST_LOGNORMAL,
+	DIST_PARETO,
+	DIST_MMPP
+};
+
+#define DIST_PARAMS 3
+
+/* no draw is further from zero; a day, in milliseconds, and then some */
+#define DIST_MAX 1e9
+
+struct dist
+{
+	enum dist_kind kind;
+	double params[DIST_PARAMS]; /* as given; NAN when left out */
+
+	/* derived by dist_finish */
+	double a;
+	double b;
+
+	/* mmpp phase */
+	int bursting;
+};
+
+/**
+ * Parse `spec` into `dist`.
+ *
+ * Returns 0 on success, or -1 if it's malformed.
+ */
+int dist_parse (struct dist *dist, const char *spec);
+
+/**
+ * Fill in left-out parameters from `mean` (which may be NAN for no default)
+ * and check the result: an absent uniform range becomes [0, 2 * mean), an
+ * absent mean becomes `mean', and absent shapes get moderate defaults.
+ *
+ * Returns 0 on success, or -1 if the distribution doesn't make sense.
+ */
+int dist_finish (struct dist *dist, double mean);
+
+/**
+ * Draw a value, using `random (n)` for uniform integers in [0, n). Heavy tails
+ * are cut off at +/-DIST_MAX, so the value always converts to an integer
+ * safely, even as nanoseconds.
+ */
+double dist_sample (struct dist *dist, uint32_t (*random) (uint32_t));
+
+#endif
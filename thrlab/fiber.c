@@ -0,0 +1,493 @@
+#define _DEFAULT_SOURCE
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "fiber.h"
+
+/**
+ * What a carrier thread is doing. Reached through `fiber_carrier' only: a
+ * fiber that parks may wake up on another carrier, and the compiler mustn't
+ * keep a thread-local address from before the switch.
+ */
+struct fiber_carrier
+{
+	ucontext_t ctx; /* the carrier's own loop */
+	struct fiber *current;
+};
+
+static __thread struct fiber_carrier carrier;
+
+static __attribute__ ((noinline)) struct fiber_carrier *fiber_carrier ()
+{
+	/* keep the compiler from assuming one thread per call */
+	struct fiber_carrier *c = &carrier;
+
+	__asm__ volatile ("" : "+r" (c));
+
+	return c;
+}
+
+bool fiber_running ()
+{
+	return fiber_carrier ()->current != NULL;
+}
+
+/**
+ * Make `fiber` runnable; `sched->mtx` must be held.
+ */
+static void fiber_enqueue (struct fiber_sched *sched, struct fiber *fiber)
+{
+	fiber->next = NULL;
+
+	if (sched->tail)
+		sched->tail->next = fiber;
+	else
+		sched->head = fiber;
+
+	sched->tail = fiber;
+}
+
+/**
+ * Switch from the running fiber back to its carrier.
+ */
+static void fiber_yield_to_carrier ()
+{
+	struct fiber_carrier *c = fiber_carrier ();
+	struct fiber *self = c->current;
+
+	int status = swapcontext (&self->ctx, &c->ctx);
+	assert (status == 0);
+}
+
+static void fiber_entry ()
+{
+	struct fiber *self = fiber_carrier ()->current;
+
+	self->fn (self->arg);
+	self->done = true;
+
+	fiber_yield_to_carrier ();
+
+	/* a finished fiber is never resumed */
+	abort ();
+}
+
+static void *fiber_carrier_main (void *arg)
+{
+	struct fiber_sched *sched = arg;
+	int status;
+
+	while (1)
+	{
+		status = pthread_mutex_lock (&sched->mtx);
+		assert (status == 0);
+
+		while (sched->head == NULL && !sched->closing)
+		{
+			status = pthread_cond_wait (&sched->runnable, &sched->mtx);
+			assert (status == 0);
+		}
+
+		struct fiber *fiber = sched->head;
+
+		if (fiber == NULL)
+		{
+			status = pthread_mutex_unlock (&sched->mtx);
+			assert (status == 0);
+
+			return NULL;
+		}
+
+		sched->head = fiber->next;
+		if (sched->head == NULL) sched->tail = NULL;
+
+		status = pthread_mutex_unlock (&sched->mtx);
+		assert (status == 0);
+
+		struct fiber_carrier *c = fiber_carrier ();
+
+		c->current = fiber;
+
+		status = swapcontext (&c->ctx, &fiber->ctx);
+		assert (status == 0);
+
+		/* the fiber has finished or parked; the loop itself never migrates,
+		 * so `c' is still this thread's */
+		c->current = NULL;
+
+		if (fiber->parking)
+		{
+			pthread_mutex_t *parking = fiber->parking;
+
+			fiber->parking = NULL;
+
+			status = pthread_mutex_unlock (parking);
+			assert (status == 0);
+		}
+		else if (fiber->done)
+		{
+			status = pthread_mutex_lock (&sched->mtx);
+			assert (status == 0);
+
+			fiber->next = sched->free;
+			sched->free = fiber;
+
+			if (--sched->live == 0)
+			{
+				status = pthread_cond_broadcast (&sched->idle);
+				assert (status == 0);
+			}
+
+			status = pthread_mutex_unlock (&sched->mtx);
+			assert (status == 0);
+		}
+	}
+}
+
+int fiber_sched_init (struct fiber_sched *sched, size_t carriers, size_t stack_size)
+{
+	assert (sched);
+	assert (carriers > 0);
+
+	int status;
+	long page = sysconf (_SC_PAGESIZE);
+
+	sched->num_carriers = 0;
+	sched->stack_size = (stack_size + page - 1) / page * page;
+	sched->head = NULL;
+	sched->tail = NULL;
+	sched->free = NULL;
+	sched->closing = false;
+	sched->live = 0;
+	sched->peak = 0;
+	sched->spawned = 0;
+	sched->stacks = 0;
+
+	sched->carriers = malloc (carriers * sizeof (*sched->carriers));
+	if (sched->carriers == NULL) goto error_carriers;
+
+	status = pthread_mutex_init (&sched->mtx, NULL);
+	if (status != 0) goto error_mtx;
+
+	status = pthread_cond_init (&sched->runnable, NULL);
+	if (status != 0) goto error_runnable;
+
+	status = pthread_cond_init (&sched->idle, NULL);
+	if (status != 0) goto error_idle;
+
+	for (; sched->num_carriers < carriers; ++sched->num_carriers)
+	{
+		status = pthread_create
+			( &sched->carriers[sched->num_carriers]
+			, NULL
+			, fiber_carrier_main
+			, sched
+			);
+		if (status != 0) goto error_thread;
+	}
+
+	return 0;
+
+error_thread:
+	fiber_sched_destroy (sched);
+	return -1;
+
+error_idle:
+	pthread_cond_destroy (&sched->runnable);
+
+error_runnable:
+	pthread_mutex_destroy (&sched->mtx);
+
+error_mtx:
+	free (sched->carriers);
+
+error_carriers:
+	return -1;
+}
+
+/**
+ * Get a fiber with a stack, reusing a finished one if there is one;
+ * `sched->mtx` must be held.
+ */
+static struct fiber *fiber_alloc (struct fiber_sched *sched)
+{
+	struct fiber *fiber = sched->free;
+
+	if (fiber)
+	{
+		sched->free = fiber->next;
+		return fiber;
+	}
+
+	fiber = malloc (sizeof (*fiber));
+	if (fiber == NULL) return NULL;
+
+	long page = sysconf (_SC_PAGESIZE);
+
+	/* one inaccessible page below the stack catches overflows */
+	fiber->stack = mmap
+		( NULL
+		, sched->stack_size + page
+		, PROT_READ | PROT_WRITE
+		, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE
+		, -1
+		, 0
+		);
+
+	if (fiber->stack == MAP_FAILED)
+	{
+		free (fiber);
+		return NULL;
+	}
+
+	mprotect (fiber->stack, page, PROT_NONE);
+	fiber->stack_size = sched->stack_size + page;
+	++sched->stacks;
+
+	return fiber;
+}
+
+int fiber_spawn (struct fiber_sched *sched, void *(*fn) (void *), void *arg)
+{
+	assert (sched);
+	assert (fn);
+
+	int status;
+
+	status = pthread_mutex_lock (&sched->mtx);
+	assert (status == 0);
+
+	struct fiber *fiber = fiber_alloc (sched);
+
+	if (fiber == NULL)
+	{
+		status = pthread_mutex_unlock (&sched->mtx);
+		assert (status == 0);
+
+		return -1;
+	}
+
+	long page = sysconf (_SC_PAGESIZE);
+
+	status = getcontext (&fiber->ctx);
+	assert (status == 0);
+
+	fiber->ctx.uc_stack.ss_sp = (char *) fiber->stack + page;
+	fiber->ctx.uc_stack.ss_size = fiber->stack_size - page;
+	fiber->ctx.uc_link = NULL;
+	makecontext (&fiber->ctx, fiber_entry, 0);
+
+	fiber->sched = sched;
+	fiber->fn = fn;
+	fiber->arg = arg;
+	fiber->done = false;
+	fiber->parking = NULL;
+
+	++sched->spawned;
+
+	if (++sched->live > sched->peak)
+		sched->peak = sched->live;
+
+	fiber_enqueue (sched, fiber);
+
+	status = pthread_cond_signal (&sched->runnable);
+	assert (status == 0);
+
+	status = pthread_mutex_unlock (&sched->mtx);
+	assert (status == 0);
+
+	return 0;
+}
+
+void fiber_sched_destroy (struct fiber_sched *sched)
+{
+	assert (sched);
+
+	int status;
+
+	status = pthread_mutex_lock (&sched->mtx);
+	assert (status == 0);
+
+	while (sched->live > 0)
+	{
+		status = pthread_cond_wait (&sched->idle, &sched->mtx);
+		assert (status == 0);
+	}
+
+	sched->closing = true;
+
+	status = pthread_cond_broadcast (&sched->runnable);
+	assert (status == 0);
+
+	status = pthread_mutex_unlock (&sched->mtx);
+	assert (status == 0);
+
+	for (size_t i = 0; i < sched->num_carriers; ++i)
+	{
+		status = pthread_join (sched->carriers[i], NULL);
+		assert (status == 0);
+	}
+
+	while (sched->free)
+	{
+		struct fiber *fiber = sched->free;
+
+		sched->free = fiber->next;
+		munmap (fiber->stack, fiber->stack_size);
+		free (fiber);
+	}
+
+	pthread_cond_destroy (&sched->idle);
+	pthread_cond_destroy (&sched->runnable);
+	pthread_mutex_destroy (&sched->mtx);
+	free (sched->carriers);
+}
+
+int fiber_sem_init (struct fiber_sem *sem, bool pshared, unsigned int value)
+{
+	assert (sem);
+
+	int status;
+	int scope = pshared ? PTHREAD_PROCESS_SHARED : PTHREAD_PROCESS_PRIVATE;
+	pthread_mutexattr_t mattr;
+	pthread_condattr_t cattr;
+
+	sem->value = value;
+	sem->thread_waiters = 0;
+	sem->head = NULL;
+	sem->tail = NULL;
+
+	pthread_mutexattr_init (&mattr);
+	pthread_mutexattr_setpshared (&mattr, scope);
+	status = pthread_mutex_init (&sem->mtx, &mattr);
+	pthread_mutexattr_destroy (&mattr);
+	if (status != 0) return -1;
+
+	pthread_condattr_init (&cattr);
+	pthread_condattr_setpshared (&cattr, scope);
+	status = pthread_cond_init (&sem->cond, &cattr);
+	pthread_condattr_destroy (&cattr);
+	if (status != 0)
+	{
+		pthread_mutex_destroy (&sem->mtx);
+		return -1;
+	}
+
+	return 0;
+}
+
+void fiber_sem_wait (struct fiber_sem *sem)
+{
+	assert (sem);
+
+	int status;
+
+	status = pthread_mutex_lock (&sem->mtx);
+	assert (status == 0);
+
+	if (sem->value > 0)
+	{
+		--sem->value;
+
+		status = pthread_mutex_unlock (&sem->mtx);
+		assert (status == 0);
+
+		return;
+	}
+
+	if (!fiber_running ())
+	{
+		++sem->thread_waiters;
+
+		while (sem->value == 0)
+		{
+			status = pthread_cond_wait (&sem->cond, &sem->mtx);
+			assert (status == 0);
+		}
+
+		--sem->thread_waiters;
+		--sem->value;
+
+		status = pthread_mutex_unlock (&sem->mtx);
+		assert (status == 0);
+
+		return;
+	}
+
+	/* park; the carrier lets go of the lock once our context is saved, so a
+	 * poster can't resume us halfway through switching out */
+	struct fiber *self = fiber_carrier ()->current;
+
+	self->next = NULL;
+
+	if (sem->tail)
+		sem->tail->next = self;
+	else
+		sem->head = self;
+
+	sem->tail = self;
+	self->parking = &sem->mtx;
+
+	fiber_yield_to_carrier ();
+
+	/* the poster handed its unit straight to us */
+}
+
+void fiber_sem_post (struct fiber_sem *sem)
+{
+	assert (sem);
+
+	int status;
+
+	status = pthread_mutex_lock (&sem->mtx);
+	assert (status == 0);
+
+	struct fiber *fiber = sem->head;
+
+	if (fiber == NULL)
+	{
+		++sem->value;
+
+		if (sem->thread_waiters)
+		{
+			status = pthread_cond_signal (&sem->cond);
+			assert (status == 0);
+		}
+
+		status = pthread_mutex_unlock (&sem->mtx);
+		assert (status == 0);
+
+		return;
+	}
+
+	sem->head = fiber->next;
+	if (sem->head == NULL) sem->tail = NULL;
+
+	status = pthread_mutex_unlock (&sem->mtx);
+	assert (status == 0);
+
+	/* from here on the fiber may finish and its semaphore go away */
+	struct fiber_sched *sched = fiber->sched;
+
+	status = pthread_mutex_lock (&sched->mtx);
+	assert (status == 0);
+
+	fiber_enqueue (sched, fiber);
+
+	status = pthread_cond_signal (&sched->runnable);
+	assert (status == 0);
+
+	status = pthread_mutex_unlock (&sched->mtx);
+	assert (status == 0);
+}
+
+void fiber_sem_destroy (struct fiber_sem *sem)
+{
+	assert (sem);
+	assert (sem->head == NULL);
+
+	pthread_cond_destroy (&sem->cond);
+	pthread_mutex_destroy (&sem->mtx);
+}
@@ -0,0 +1,126 @@
+#ifndef _THRLAB_FIBER_H_
+#define _THRLAB_FIBER_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <ucontext.h>
+
+struct fiber_sched;
+
+/**
+ * A user-space thread with its own small stack.
+ */
+struct fiber
+{
+	ucontext_t ctx;
+	void *stack; /* mapping, guard page first */
+	size_t stack_size;
+
+	struct fiber_sched *sched;
+	void *(*fn) (void *);
+	void *arg;
+	bool done;
+
+	/* released by the carrier once the fiber's context is saved */
+	pthread_mutex_t *parking;
+
+	struct fiber *next; /* in the run queue, a wait list or the free list */
+};
+
+/**
+ * Runs fibers M:N on a few carrier threads. A fiber keeps its carrier until
+ * it finishes or parks on a fiber semaphore, and may resume on any carrier.
+ */
+struct fiber_sched
+{
+	pthread_mutex_t mtx;
+	pthread_cond_t runnable;
+	pthread_cond_t idle;
+
+	pthread_t *carriers;
+	size_t num_carriers;
+	size_t stack_size;
+
+	/* FIFO of fibers ready to run */
+	struct fiber *head;
+	struct fiber *tail;
+
+	/* finished fibers, stacks kept for reuse */
+	struct fiber *free;
+
+	bool closing;
+
+	/* statistics */
+	size_t live;
+	size_t peak;
+	size_t spawned;
+	size_t stacks; /* stacks mapped, ever */
+};
+
+/**
+ * A counting semaphore that parks fibers instead of blocking their carrier.
+ * Plain threads may wait on it too.
+ */
+struct fiber_sem
+{
+	pthread_mutex_t mtx;
+	pthread_cond_t cond; /* for threads that aren't fibers */
+	unsigned int value;
+	unsigned int thread_waiters;
+
+	/* parked fibers, in arrival order */
+	struct fiber *head;
+	struct fiber *tail;
+};
+
+/**
+ * Start `carriers` carrier threads running fibers with `stack_size` bytes of
+ * stack each.
+ *
+ * Returns 0 on success.
+ */
+int fiber_sched_init (struct fiber_sched *sched, size_t carriers, size_t stack_size);
+
+/**
+ * Run `fn (arg)` in a new fiber.
+ *
+ * Returns 0 on success.
+ */
+int fiber_spawn (struct fiber_sched *sched, void *(*fn) (void *), void *arg);
+
+/**
+ * Wait for every fiber to finish, then stop the carriers and unmap stacks.
+ */
+void fiber_sched_destroy (struct fiber_sched *sched);
+
+/**
+ * Whether the caller is running in a fiber.
+ */
+bool fiber_running ();
+
+/**
+ * Start the semaphore at `value`. With `pshared`, `sem` must be in shared
+ * memory and may then be used from processes forked afterwards, as long as
+ * only plain threads wait on it.
+ *
+ * Returns 0 on success.
+ */
+int fiber_sem_init (struct fiber_sem *sem, bool pshared, unsigned int value);
+
+/**
+ * Take one from the semaphore, parking the calling fiber (or blocking the
+ * calling thread) until there is one to take.
+ */
+void fiber_sem_wait (struct fiber_sem *sem);
+
+/**
+ * Give one to the semaphore, waking the longest-parked fiber if any. After a
+ * post wakes a waiter, the semaphore isn't touched again, so the waiter may
+ * destroy it straight away.
+ */
+void fiber_sem_post (struct fiber_sem *sem);
+
+void fiber_sem_destroy (struct fiber_sem *sem);
+
+#endif
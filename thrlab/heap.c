@@ -0,0 +1,183 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "heap.h"
+#include "shared.h"
+
+static bool heap_before (const struct heap_node *a, const struct heap_node *b)
+{
+	return a->rank < b->rank || (a->rank == b->rank && a->seq < b->seq);
+}
+
+static void heap_swap (heap_t *hp, size_t i, size_t j)
+{
+	struct heap_node tmp = hp->buf[i];
+
+	hp->buf[i] = hp->buf[j];
+	hp->buf[j] = tmp;
+}
+
+static void heap_push (heap_t *hp, void *item, uint64_t rank)
+{
+	size_t i = hp->len++;
+
+	hp->buf[i] = (struct heap_node) { rank, hp->seq++, item };
+
+	while (i > 0 && heap_before (&hp->buf[i], &hp->buf[(i - 1) / 2]))
+	{
+		heap_swap (hp, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void *heap_pop (heap_t *hp)
+{
+	void *item = hp->buf[0].item;
+	size_t i = 0;
+
+	hp->buf[0] = hp->buf[--hp->len];
+
+	while (1)
+	{
+		size_t least = i;
+		size_t left = 2 * i + 1;
+		size_t right = left + 1;
+
+		if (left < hp->len && heap_before (&hp->buf[left], &hp->buf[least]))
+			least = left;
+
+		if (right < hp->len && heap_before (&hp->buf[right], &hp->buf[least]))
+			least = right;
+
+		if (least == i)
+			break;
+
+		heap_swap (hp, i, least);
+		i = least;
+	}
+
+	return item;
+}
+
+void heap_init (heap_t *hp, int n, bool pshared)
+{
+	assert (hp);
+	assert (n > 0);
+
+	int status;
+	int scope = pshared ? PTHREAD_PROCESS_SHARED : PTHREAD_PROCESS_PRIVATE;
+	pthread_mutexattr_t mattr;
+	pthread_condattr_t cattr;
+
+	hp->buf = pshared
+		? shared_alloc (n * sizeof (*hp->buf))
+		: calloc (n, sizeof (*hp->buf));
+	hp->n = n;
+	hp->len = 0;
+	hp->seq = 0;
+	hp->pshared = pshared;
+	hp->inserts = NULL;
+	hp->removes = NULL;
+
+	pthread_mutexattr_init (&mattr);
+	pthread_mutexattr_setpshared (&mattr, scope);
+
+	status = pthread_mutex_init (&hp->mtx, &mattr);
+	assert (status == 0);
+
+	pthread_mutexattr_destroy (&mattr);
+
+	pthread_condattr_init (&cattr);
+	pthread_condattr_setpshared (&cattr, scope);
+
+	status = pthread_cond_init (&hp->items, &cattr);
+	assert (status == 0);
+
+	status = pthread_cond_init (&hp->slots, &cattr);
+	assert (status == 0);
+
+	pthread_condattr_destroy (&cattr);
+}
+
+void heap_deinit (heap_t *hp)
+{
+	assert (hp);
+
+	pthread_cond_destroy (&hp->slots);
+	pthread_cond_destroy (&hp->items);
+	pthread_mutex_destroy (&hp->mtx);
+
+	if (!hp->pshared)
+		free (hp->buf);
+}
+
+void heap_profile (heap_t *hp, struct lockprof *inserts, struct lockprof *removes)
+{
+	assert (hp);
+
+	hp->inserts = inserts;
+	hp->removes = removes;
+}
+
+void heap_insert (heap_t *hp, void *item, uint64_t rank)
+{
+	assert (hp);
+
+	int status;
+
+	lockprof_mutex_lock (hp->inserts, &hp->mtx);
+
+	while (hp->len == hp->n)
+		lockprof_cond_wait (hp->inserts, &hp->slots, &hp->mtx);
+
+	heap_push (hp, item, rank);
+
+	status = pthread_cond_signal (&hp->items);
+	assert (status == 0);
+
+	lockprof_mutex_unlock (hp->inserts, &hp->mtx);
+}
+
+void *heap_remove (heap_t *hp)
+{
+	assert (hp);
+
+	int status;
+
+	lockprof_mutex_lock (hp->removes, &hp->mtx);
+
+	while (hp->len == 0)
+		lockprof_cond_wait (hp->removes, &hp->items, &hp->mtx);
+
+	void *item = heap_pop (hp);
+
+	status = pthread_cond_signal (&hp->slots);
+	assert (status == 0);
+
+	lockprof_mutex_unlock (hp->removes, &hp->mtx);
+
+	return item;
+}
+
+bool heap_try_remove (heap_t *hp, void **item)
+{
+	assert (hp);
+	assert (item);
+
+	int status;
+	bool removed = false;
+
+	lockprof_mutex_lock (hp->removes, &hp->mtx);
+
+	if (hp->len > 0)
+	{
+		*item = heap_pop (hp);
+		removed = true;
+
+		status = pthread_cond_signal (&hp->slots);
+		assert (status == 0);
+	}
+
+	lockprof_mutex_unlock (hp->removes, &hp->mtx);
+
+	return removed;
+}
@@ -0,0 +1,75 @@
+#ifndef _THRLAB_HEAP_H_
+#define _THRLAB_HEAP_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lockprof.h"
+
+/**
+ * An item in the heap. Equal ranks come out in the order they went in.
+ */
+struct heap_node
+{
+	uint64_t rank;
+	uint64_t seq;
+	void *item;
+};
+
+/**
+ * A bounded, blocking priority queue: a binary min-heap on rank under a
+ * mutex. Removing takes the lowest-ranked item.
+ */
+typedef struct
+{
+	struct heap_node *buf;
+	size_t n; /* maximum number of items */
+	size_t len;
+	uint64_t seq; /* inserts so far, for breaking ties */
+	bool pshared; /* buf is in the shared segment */
+
+	pthread_mutex_t mtx;
+	pthread_cond_t items; /* consumers park */
+	pthread_cond_t slots; /* producers park */
+
+	/* where to profile the mutex, or NULL */
+	struct lockprof *inserts;
+	struct lockprof *removes;
+} heap_t;
+
+/**
+ * Create an empty heap holding at most `n` items. With `pshared`, `hp` must
+ * be in shared memory: the items go in the shared segment and the heap may
+ * be used from processes forked afterwards.
+ */
+void heap_init (heap_t *hp, int n, bool pshared);
+
+/**
+ * Release the memory held by the heap.
+ */
+void heap_deinit (heap_t *hp);
+
+/**
+ * Profile the heap's mutex, telling inserts and removes apart. Either may be
+ * NULL.
+ */
+void heap_profile (heap_t *hp, struct lockprof *inserts, struct lockprof *removes);
+
+/**
+ * Insert `item` with rank `rank`, waiting while the heap is full.
+ */
+void heap_insert (heap_t *hp, void *item, uint64_t rank);
+
+/**
+ * Remove and return the lowest-ranked item, waiting while the heap is empty.
+ */
+void *heap_remove (heap_t *hp);
+
+/**
+ * Remove the lowest-ranked item into `*item` unless the heap is empty.
+ * Returns whether an item was removed.
+ */
+bool heap_try_remove (heap_t *hp, void **item);
+
+#endif
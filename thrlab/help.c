@@ -1,20 +1,75 @@
+#define _GNU_SOURCE
 #define _BSD_SOURCE
 #define _DEFAULT_SOURCE
 #define _POSIX_C_SOUCE 200112L
 #include <argp.h>
 #include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
 #include <pthread.h>
+#include <signal.h>
+#include <stdalign.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
+#include "complaint.h"
+#include "dist.h"
+#include "fiber.h"
 #include "help.h"
+#include "hist.h"
+#include "lockprof.h"
+#include "log.h"
+#include "names.h"
+#include "pool.h"
+#include "probe.h"
+#include "replay.h"
+#include "ring.h"
+#include "shared.h"
+#include "slab.h"
+#include "stats.h"
+#include "topo.h"
+#include "trace.h"
+#include "vclock.h"
 
 #define ARRSIZE(x) (sizeof (x) / sizeof (*(x)))
 
+/* most customers in a day, unless the shop is open all day */
+#define CUSTOMERS_MAX 1000
+
+/* most customers in the shop at once */
+#define SLOTS_MAX (1 << 24)
+
+/* longest hair anyone walks in with, in millimetres */
+#define HAIR_MAX 100000
+
+/* false sharing is avoided a line at a time */
+#define CACHE_LINE 64
+
+/* complaints are counted this many ways apart */
+#define COUNTER_SHARDS 64
+
+/* how often the --stats file is rewritten */
+#define STATS_INTERVAL_MS 100
+
+/* shared memory for the waiting room, beyond the harness's own, per chair */
+#define SHARED_PER_CHAIR 256
+
+/* and for whatever else the solution shares with its barbers */
+#define SHARED_SLACK (1 << 20)
+
+/* how long to keep waiting once barbers have died, without anyone leaving */
+#define LOST_GRACE_MS 1000
+
 enum customer_status
 {
 	CUSTOMER_PENDING,
@@ -24,12 +79,190 @@ enum customer_status
 	CUSTOMER_REJECTED
 };
 
+enum dispatch_mode
+{
+	DISPATCH_THREAD, /* one thread per customer */
+	DISPATCH_POOL, /* pre-spawned customer workers */
+	DISPATCH_FIBER /* a fiber per customer, on a few carrier threads */
+};
+
+enum policy
+{
+	POLICY_FIFO, /* first come, first served */
+	POLICY_SJF, /* shortest haircut first */
+	POLICY_AGING /* shortest first, but waiting earns a place */
+};
+
+enum sync_mode
+{
+	SYNC_MUTEX, /* every transition under the harness mutex */
+	SYNC_ATOMIC /* transitions are compare-and-swaps on the customer */
+};
+
+enum route_mode
+{
+	ROUTE_P2C, /* the less loaded of two shops picked at random */
+	ROUTE_JSQ, /* the least loaded of every shop */
+	ROUTE_RANDOM /* any shop */
+};
+
+/* keys for options without a short name */
+enum argparse_key
+{
+	KEY_DISPATCH = 0x100,
+	KEY_WORKERS,
+	KEY_QUEUE,
+	KEY_SYNC,
+	KEY_LOG,
+	KEY_TRACE,
+	KEY_TRACE_SIZE,
+	KEY_RECORD_ONLY,
+	KEY_VIRTUAL_TIME,
+	KEY_SEED,
+	KEY_REPORT,
+	KEY_ARRIVALS,
+	KEY_HAIR_LENGTH,
+	KEY_HAIR_GOAL,
+	KEY_REPLAY,
+	KEY_OPEN_DAY,
+	KEY_SLOTS,
+	KEY_FIBER_STACK,
+	KEY_BARBER_LOOP,
+	KEY_LOOPS,
+	KEY_POLICY,
+	KEY_ELASTIC,
+	KEY_PIN,
+	KEY_LOCK_PROFILE,
+	KEY_STATS,
+	KEY_SHOPS,
+	KEY_ROUTE
+};
+
 struct arguments
 {
-	size_t barbers;
-	size_t chairs;
+	size_t barbers; /* in each shop */
+	size_t chairs; /* in each shop */
+	size_t shops;
+	enum route_mode route;
 	size_t customers;
 	size_t rate;
+	enum dispatch_mode dispatch;
+	int dispatch_set; /* --dispatch given explicitly */
+	size_t workers;
+	enum thrlab_queue queue;
+	int queue_set; /* --queue given explicitly */
+	enum policy policy;
+	double aging; /* ns of haircut a ns of waiting is worth */
+	enum thrlab_barbers barber_loop;
+	size_t loops;
+	size_t min_barbers; /* 0 unless --elastic */
+	int pin;
+	enum topo_order pin_order;
+	enum sync_mode sync;
+	int lock_profile;
+	enum log_mode log;
+	int log_set; /* --log given explicitly */
+	const char *trace;
+	size_t trace_size;
+	int record_only;
+	int virtual_time;
+	unsigned int seed;
+	const char *report;
+	const char *stats;
+	struct dist arrivals; /* milliseconds between customers */
+	struct dist hair_length;
+	struct dist hair_goal;
+	const char *replay;
+	int customers_set; /* -c given explicitly */
+	int open_day;
+	size_t slots;
+	size_t fiber_stack; /* bytes */
+};
+
+enum latency
+{
+	LATENCY_WAIT, /* accepted until prepared */
+	LATENCY_SERVICE, /* prepared until dismissed */
+	LATENCY_TURNAROUND, /* arrived until dismissed */
+	NUM_LATENCIES
+};
+
+/**
+ * One shard of the complaint counters, never sharing a line with another.
+ */
+struct counter_shard
+{
+	alignas (CACHE_LINE) _Atomic size_t complaints[NUM_COMPLAINTS];
+};
+
+/**
+ * One of the shops behind the front door, counting only the customers sent
+ * its way; a line each.
+ */
+struct shop
+{
+	alignas (CACHE_LINE) _Atomic size_t load; /* sent here and not yet gone */
+	_Atomic size_t waiting;
+	_Atomic size_t peak_load;
+	_Atomic size_t arrived;
+	_Atomic size_t rejected;
+	_Atomic size_t served;
+};
+
+/**
+ * Where locks are taken, for --lock-profile.
+ */
+enum lock_site
+{
+	/* the harness mutex; all but arrival only with --sync=mutex */
+	LOCK_ARRIVAL,
+	LOCK_ACCEPT,
+	LOCK_REJECT,
+	LOCK_PREPARE,
+	LOCK_DISMISS,
+	LOCK_HANDOFF, /* dismiss and prepare at once */
+	LOCK_LEAVE, /* the customer's callback returning */
+
+	/* the waiting room's, as profiled by main.c; one pair per shop */
+	LOCK_SEAT,
+	LOCK_PICKUP,
+
+	NUM_LOCK_SITES
+};
+
+/**
+ * When a customer reached each stage of their visit, in nanoseconds since the
+ * shop opened. Stamped by whichever thread moved them along.
+ */
+struct visit
+{
+	_Atomic uint64_t arrived;
+	_Atomic uint64_t accepted;
+	_Atomic uint64_t prepared;
+};
+
+/**
+ * A customer in the shop, and what the harness knows about them. Slots are
+ * reused once a customer has left and their thread has been reaped.
+ */
+struct visitor
+{
+	alignas (SLAB_ALIGN) struct customer customer; /* first, see visitor_of */
+	_Atomic enum customer_status status;
+	struct visit times;
+	struct fiber_sem served; /* see thrlab_customer_wait; lives with the slot */
+	uint32_t generation; /* bumped each time the slot is reused */
+	pid_t pid; /* the worker process serving them, with --barber-loop=process */
+};
+
+/**
+ * What a customer's thread needs to get going.
+ */
+struct my_ud
+{
+	void (*callback) (struct customer *, void *);
+	struct customer *customer;
+	void *ud;
 };
 
 static struct {
@@ -37,269 +270,125 @@ static struct {
 	struct timespec start;
 
 	/* constants */
-	size_t visitors;
-	size_t barbers;
-	size_t chairs;
+	size_t visitors; /* SIZE_MAX for an open day */
+	size_t barbers; /* in every shop, so the number of rooms */
+	size_t chairs; /* in each shop */
+	size_t num_shops;
+	size_t shop_barbers; /* rooms [i * shop_barbers, (i + 1) * shop_barbers) are shop i's */
+	enum route_mode route;
 	size_t rate;
-
-	/* current statistics */
-	size_t num_cutting;
-	size_t num_waiting;
-	size_t num_pending;
-
-	/* complaints */
-	size_t complaint_reject_avail; /* rejected with seats available */
-	size_t complaint_reject_wait; /* a waiting customer was shown the door */
-	size_t complaint_reject_cut; /* customer rejected mid-cut */
-	size_t complaint_reject_done; /* rejected entry after a haircut */
-	size_t complaint_reject_again; /* rejected more than once */
-	size_t complaint_accept_full; /* accepted while seats were unavailable */
-	size_t complaint_accept_wait; /* accepted while waiting */
-	size_t complaint_accept_cut; /* accepted while being cut */
-	size_t complaint_accept_done; /* accepted when done */
-	size_t complaint_accept_reject; /* accepted after rejection */
-	size_t complaint_prepare_pending; /* prepared without being let in first */
-	size_t complaint_prepare_busy; /* prepared while barber's busy */
-	size_t complaint_prepare_again; /* prepared more than once */
-	size_t complaint_prepare_done; /* prepared after leaving */
-	size_t complaint_prepare_reject; /* prepared after being rejected */
-	size_t complaint_prepare_self; /* customer had to cut their own hair */
-	size_t complaint_dismiss_pending; /* dismissed outside */
-	size_t complaint_dismiss_wait; /* dismissed while waiting */
-	size_t complaint_dismiss_done; /* dismissed again */
-	size_t complaint_dismiss_reject; /* dismissed after rejection */
-	size_t complaint_dismiss_room; /* told to dismiss, but wrong room */
-	size_t complaint_dismiss_self; /* told to show themselves to the door */
-	size_t complaint_dismiss_early; /* customer thread died before dismissal */
-	size_t complaint_cut_fast; /* barber in a hurry, too fast */
-	size_t complaint_cut_slow; /* barber too slow */
-
-	size_t customer_count;
-	struct customer **customers;
-	enum customer_status *statuses;
-	struct timespec *times; /* time when prepared */
-
-	struct customer **occupancy; /* room occupancy */
+	enum dispatch_mode dispatch;
+	enum thrlab_queue queue;
+	enum policy policy;
+	double aging;
+	enum thrlab_barbers barber_loop;
+	size_t loops;
+	size_t min_barbers;
+	enum sync_mode sync;
+	int record_only; /* trace transitions, check nothing */
+	int virtual_time;
+
+	/* num_lock_profiles () of them with --lock-profile, else NULL */
+	struct lockprof *locks;
+
+	/* where threads run, with --pin */
+	int pin;
+	enum topo_order pin_order;
+	struct topo topo;
+	cpu_set_t shop_cpus; /* everyone but the barbers */
+	unsigned int seed;
+	const char *report; /* where to write the machine-readable report */
+	struct dist arrivals;
+	struct dist hair_length;
+	struct dist hair_goal;
+
+	/* arrivals read from a file instead of drawn at random */
+	int replaying;
+	struct replay replay;
+
+	/* customer workers, in pooled dispatch mode */
+	struct pool pool;
+
+	/* or with --barber-loop=process, worker processes taking customers
+	 * from the door */
+	ring_t door;
+	size_t num_workers;
+
+	/* carrier threads, in fiber dispatch mode */
+	struct fiber_sched fibers;
+
+	/* current statistics, read back on every transition; a line each */
+	alignas (CACHE_LINE) _Atomic size_t num_cutting;
+	alignas (CACHE_LINE) _Atomic size_t num_waiting;
+	alignas (CACHE_LINE) _Atomic size_t num_pending;
+
+	/* the shops behind the front door, one with no --shops */
+	struct shop *shops;
+
+	/* complaints, spread over shards so threads don't share lines */
+	alignas (CACHE_LINE) struct counter_shard *shards;
+	_Atomic unsigned int next_shard;
+
+	/* customers in the shop */
+	struct visitor *slots;
+	size_t num_slots;
+	uint32_t *free_slots; /* stack of slot indices, touched by the arrival thread only */
+	size_t num_free;
+	ring_t done; /* generation-tagged handles of customers whose thread is done */
+
+	/* slot statistics */
+	uint64_t customer_count; /* arrivals so far */
+	uint64_t reaped;
+	size_t peak_in_shop;
+	size_t stalls; /* arrivals held up waiting for a slot */
+
+	/* latency distributions, in nanoseconds */
+	struct hist latency[NUM_LATENCIES];
+
+	struct customer *_Atomic *occupancy; /* room occupancy */
+
+	/* barber shifts */
+	_Atomic uint64_t *duty_since; /* per room, UINT64_MAX while off duty */
+	_Atomic uint64_t duty_ns; /* finished shifts */
+	_Atomic size_t on_duty;
+	_Atomic size_t peak_on_duty;
+
+	/* where dispatch records live */
+	struct slab dispatch_slab;
+
+	/* per room and per customer worker, with --barber-loop=process; the
+	 * parent's alone */
+	pid_t *barber_pids;
+	pid_t *worker_pids;
 } *thrlab = NULL;
 
-static const char *barber_names[] =
-	{ "HAL9000"
-	, "Terminator"
-	, "Wall-E"
-	, "Johnny-5"
-	, "Dot-Matrix"
-	, "C-3PO"
-	, "R2D2"
-	, "Optimus-Prime"
-	, "Bishop"
-	, "Call"
-	, "Robot"
-	, "Robocop"
-	, "Andrew"
-	, "Bender"
-	, "T-1000"
-	, "GERTY-3000"
-	, "Data"
-	, "Sonny"
-	, "Astro-Boy"
-	, "Baymax"
-	, "TARS"
-	, "CASE"
-	, "Cylon"
-	, "C.H.E.E.S.E."
-	, "Funnybot"
-	, "GIR"
-	, "D.A.V.E."
-	, "Six"
-	, "Replicator"
-	, "MegaMan"
-	, "ED209"
-	, "B.E.N."
-	, "SID-6.7"
-	, "21-B"
-	, "Fembot"
-	, "Sentinel"
-	, "Gigalo-Joe"
-	, "DroidEkas"
-	, "D.A.R.Y.L."
-	, "Pris"
-	, "Omnidroid"
-	, "Teddy"
-	, "EVE"
-	, "Mechagodzilla"
-	, "Steprod-Wive"
-	, "Marvin"
-	, "Ash"
-	, "Gort"
-	, "Roy-Batty"
-	};
+/* set by SIGINT or SIGTERM during an open day */
+static volatile sig_atomic_t closing = 0;
 
-static const char *customer_names[] =
-	{ "Abigail"
-	, "Adam"
-	, "Adrian"
-	, "Alan"
-	, "Alexander"
-	, "Alexandra"
-	, "Alison"
-	, "Amanda"
-	, "Amelia"
-	, "Amy"
-	, "Andrea"
-	, "Andrew"
-	, "Angela"
-	, "Anna"
-	, "Anne"
-	, "Anthony"
-	, "Audrey"
-	, "Austin"
-	, "Ava"
-	, "Bella"
-	, "Benjamin"
-	, "Bernadette"
-	, "Blake"
-	, "Boris"
-	, "Brandon"
-	, "Brian"
-	, "Cameron"
-	, "Carl"
-	, "Carol"
-	, "Caroline"
-	, "Carolyn"
-	, "Charles"
-	, "Chloe"
-	, "Christian"
-	, "Christopher"
-	, "Claire"
-	, "Colin"
-	, "Connor"
-	, "Dan"
-	, "David"
-	, "Deirdre"
-	, "Diana"
-	, "Diane"
-	, "Dominic"
-	, "Donna"
-	, "Dorothy"
-	, "Dylan"
-	, "Edward"
-	, "Elizabeth"
-	, "Ella"
-	, "Emily"
-	, "Emma"
-	, "Eric"
-	, "Evan"
-	, "Faith"
-	, "Felicity"
-	, "Fiona"
-	, "Frank"
-	, "Gabrielle"
-	, "Gavin"
-	, "Gordon"
-	, "Grace"
-	, "Hannah"
-	, "Harry"
-	, "Heather"
-	, "Ian"
-	, "Irene"
-	, "Isaac"
-	, "Jack"
-	, "Jacob"
-	, "Jake"
-	, "James"
-	, "Jan"
-	, "Jane"
-	, "Jasmine"
-	, "Jason"
-	, "Jennifer"
-	, "Jessica"
-	, "Joan"
-	, "Joanne"
-	, "Joe"
-	, "John"
-	, "Jonathan"
-	, "Joseph"
-	, "Joshua"
-	, "Julia"
-	, "Julian"
-	, "Justin"
-	, "Karen"
-	, "Katherine"
-	, "Keith"
-	, "Kevin"
-	, "Kimberly"
-	, "Kylie"
-	, "Lauren"
-	, "Leah"
-	, "Leonard"
-	, "Liam"
-	, "Lillian"
-	, "Lily"
-	, "Lisa"
-	, "Lucas"
-	, "Luke"
-	, "Madeleine"
-	, "Maria"
-	, "Mary"
-	, "Matt"
-	, "Max"
-	, "Megan"
-	, "Melanie"
-	, "Michael"
-	, "Michelle"
-	, "Molly"
-	, "Natalie"
-	, "Nathan"
-	, "Neil"
-	, "Nicholas"
-	, "Nicola"
-	, "Oliver"
-	, "Olivia"
-	, "Owen"
-	, "Paul"
-	, "Penelope"
-	, "Peter"
-	, "Phil"
-	, "Piers"
-	, "Pippa"
-	, "Rachel"
-	, "Rebecca"
-	, "Richard"
-	, "Robert"
-	, "Rose"
-	, "Ruth"
-	, "Ryan"
-	, "Sally"
-	, "Sam"
-	, "Samantha"
-	, "Sarah"
-	, "Sean"
-	, "Sebastian"
-	, "Simon"
-	, "Sonia"
-	, "Sophie"
-	, "Stephanie"
-	, "Stephen"
-	, "Steven"
-	, "Stewart"
-	, "Sue"
-	, "Theresa"
-	, "Thomas"
-	, "Tim"
-	, "Tracey"
-	, "Trevor"
-	, "Una"
-	, "Vanessa"
-	, "Victor"
-	, "Victoria"
-	, "Virginia"
-	, "Wanda"
-	, "Warren"
-	, "Wendy"
-	, "William"
-	, "Yvonne"
-	, "Zoe"
-	};
+/* set in a barber forked with --barber-loop=process */
+static int barber_process = 0;
+
+/* what customer workers forked with --barber-loop=process run each customer
+ * through; set before they're forked */
+static void (*worker_callback) (struct customer *, void *) = NULL;
+static void *worker_ud = NULL;
+
+/* raised by a tracer attached to the probe; see probe.h */
+PROBE_SEMAPHORE (arrive);
+PROBE_SEMAPHORE (accept);
+PROBE_SEMAPHORE (reject);
+PROBE_SEMAPHORE (prepare);
+PROBE_SEMAPHORE (dismiss);
+PROBE_SEMAPHORE (sleep_begin);
+PROBE_SEMAPHORE (sleep_end);
+PROBE_SEMAPHORE (cleanup);
+
+static void close_shop (int signum)
+{
+	(void) signum;
+
+	closing = 1;
+}
 
 /**
  * This is a terrible function!
@@ -344,6 +433,39 @@ size_t my_strtonum (const char *str, size_t min, size_t max, const char **err)
 	return num;
 }
 
+/**
+ * Parse `fifo', `sjf', `srpt' or `aging[:FACTOR]'.
+ */
+static int argparse_policy (struct arguments *arguments, const char *arg)
+{
+	if (strcmp (arg, "fifo") == 0)
+		arguments->policy = POLICY_FIFO;
+	else if (strcmp (arg, "sjf") == 0)
+		arguments->policy = POLICY_SJF;
+	else if (strcmp (arg, "srpt") == 0)
+		/* nobody waiting has been started on, so all the cutting's left */
+		arguments->policy = POLICY_SJF;
+	else if (strncmp (arg, "aging", 5) == 0 && (arg[5] == '\0' || arg[5] == ':'))
+	{
+		arguments->policy = POLICY_AGING;
+
+		if (arg[5] == ':')
+		{
+			char *end;
+
+			errno = 0;
+			arguments->aging = strtod (arg + 6, &end);
+
+			if (errno || *end || end == arg + 6 || !(arguments->aging >= 0))
+				return -1;
+		}
+	}
+	else
+		return -1;
+
+	return 0;
+}
+
 static error_t argparse_opt
 	( int key
 	, char *arg
@@ -359,14 +481,15 @@ static error_t argparse_opt
 			arguments->barbers = my_strtonum
 				( arg
 				, 1
-				, ARRSIZE (barber_names)
+				, BARBERS_MAX
 				, &err
 				);
 			if (err) argp_usage (state);
 			break;
 		case 'c':
-			arguments->customers = my_strtonum (arg, 1, 1000, &err);
+			arguments->customers = my_strtonum (arg, 1, SIZE_MAX, &err);
 			if (err) argp_usage (state);
+			arguments->customers_set = 1;
 			break;
 		case 'r':
 			arguments->rate = my_strtonum (arg, 1, 10000, &err);
@@ -376,6 +499,205 @@ static error_t argparse_opt
 			arguments->chairs = my_strtonum (arg, 1, 1000, &err);
 			if (err) argp_usage (state);
 			break;
+		case KEY_DISPATCH:
+			if (strcmp (arg, "thread") == 0)
+				arguments->dispatch = DISPATCH_THREAD;
+			else if (strcmp (arg, "pool") == 0)
+				arguments->dispatch = DISPATCH_POOL;
+			else if (strcmp (arg, "fiber") == 0)
+				arguments->dispatch = DISPATCH_FIBER;
+			else
+				argp_usage (state);
+
+			arguments->dispatch_set = 1;
+			break;
+		case KEY_WORKERS:
+			arguments->workers = my_strtonum (arg, 1, 10000, &err);
+			if (err) argp_usage (state);
+			break;
+		case KEY_QUEUE:
+			if (strcmp (arg, "sbuf") == 0)
+				arguments->queue = THRLAB_QUEUE_SBUF;
+			else if (strcmp (arg, "ring") == 0)
+				arguments->queue = THRLAB_QUEUE_RING;
+			else if (strcmp (arg, "heap") == 0)
+				arguments->queue = THRLAB_QUEUE_HEAP;
+			else
+				argp_usage (state);
+			arguments->queue_set = 1;
+			break;
+		case KEY_POLICY:
+			if (argparse_policy (arguments, arg)) argp_usage (state);
+			break;
+		case KEY_LOCK_PROFILE:
+			arguments->lock_profile = 1;
+			break;
+		case KEY_PIN:
+			if (strcmp (arg, "none") == 0)
+				arguments->pin = 0;
+			else if (strcmp (arg, "compact") == 0)
+				arguments->pin = 1, arguments->pin_order = TOPO_COMPACT;
+			else if (strcmp (arg, "spread") == 0)
+				arguments->pin = 1, arguments->pin_order = TOPO_SPREAD;
+			else
+				argp_usage (state);
+			break;
+		case KEY_ELASTIC:
+			arguments->min_barbers = my_strtonum (arg, 1, BARBERS_MAX, &err);
+			if (err) argp_usage (state);
+			break;
+		case KEY_BARBER_LOOP:
+			if (strcmp (arg, "thread") == 0)
+				arguments->barber_loop = THRLAB_BARBERS_THREAD;
+			else if (strcmp (arg, "event") == 0)
+				arguments->barber_loop = THRLAB_BARBERS_EVENT;
+			else if (strcmp (arg, "process") == 0)
+				arguments->barber_loop = THRLAB_BARBERS_PROCESS;
+			else
+				argp_usage (state);
+			break;
+		case KEY_LOOPS:
+			arguments->loops = my_strtonum (arg, 1, 1000, &err);
+			if (err) argp_usage (state);
+			break;
+		case KEY_SHOPS:
+			arguments->shops = my_strtonum (arg, 1, BARBERS_MAX, &err);
+			if (err) argp_usage (state);
+			break;
+		case KEY_ROUTE:
+			if (strcmp (arg, "p2c") == 0)
+				arguments->route = ROUTE_P2C;
+			else if (strcmp (arg, "jsq") == 0)
+				arguments->route = ROUTE_JSQ;
+			else if (strcmp (arg, "random") == 0)
+				arguments->route = ROUTE_RANDOM;
+			else
+				argp_usage (state);
+			break;
+		case KEY_LOG:
+			if (strcmp (arg, "none") == 0)
+				arguments->log = LOG_NONE;
+			else if (strcmp (arg, "sync") == 0)
+				arguments->log = LOG_SYNC;
+			else if (strcmp (arg, "async") == 0)
+				arguments->log = LOG_ASYNC;
+			else
+				argp_usage (state);
+			arguments->log_set = 1;
+			break;
+		case KEY_TRACE:
+			arguments->trace = arg;
+			break;
+		case KEY_RECORD_ONLY:
+			arguments->record_only = 1;
+			break;
+		case KEY_VIRTUAL_TIME:
+			arguments->virtual_time = 1;
+			break;
+		case KEY_SEED:
+			arguments->seed = my_strtonum (arg, 0, UINT32_MAX, &err);
+			if (err) argp_usage (state);
+			break;
+		case KEY_REPORT:
+			arguments->report = arg;
+			break;
+		case KEY_STATS:
+			arguments->stats = arg;
+			break;
+		case KEY_TRACE_SIZE:
+			arguments->trace_size = my_strtonum (arg, 1, SIZE_MAX / 64, &err);
+			if (err) argp_usage (state);
+			break;
+		case KEY_SYNC:
+			if (strcmp (arg, "mutex") == 0)
+				arguments->sync = SYNC_MUTEX;
+			else if (strcmp (arg, "atomic") == 0)
+				arguments->sync = SYNC_ATOMIC;
+			else
+				argp_usage (state);
+			break;
+		case KEY_ARRIVALS:
+			if (dist_parse (&arguments->arrivals, arg)) argp_usage (state);
+			break;
+		case KEY_HAIR_LENGTH:
+			if (dist_parse (&arguments->hair_length, arg)) argp_usage (state);
+			break;
+		case KEY_HAIR_GOAL:
+			if (dist_parse (&arguments->hair_goal, arg)) argp_usage (state);
+			break;
+		case KEY_REPLAY:
+			arguments->replay = arg;
+			break;
+		case KEY_OPEN_DAY:
+			arguments->open_day = 1;
+			break;
+		case KEY_SLOTS:
+			arguments->slots = my_strtonum (arg, 1, SLOTS_MAX, &err);
+			if (err) argp_usage (state);
+			break;
+		case KEY_FIBER_STACK:
+			arguments->fiber_stack = my_strtonum (arg, 16, 65536, &err) * 1024;
+			if (err) argp_usage (state);
+			break;
+		case ARGP_KEY_END:
+			if (!arguments->open_day && arguments->customers > CUSTOMERS_MAX)
+				argp_error (state, "more than %d customers need --open-day", CUSTOMERS_MAX);
+
+			/* only the heap can serve out of order */
+			if (arguments->policy != POLICY_FIFO)
+			{
+				if (arguments->queue_set && arguments->queue != THRLAB_QUEUE_HEAP)
+					argp_error (state, "--policy needs --queue=heap");
+
+				arguments->queue = THRLAB_QUEUE_HEAP;
+			}
+
+			if (arguments->min_barbers > arguments->barbers)
+				argp_error (state, "--elastic can't go above -b barbers");
+
+			if (arguments->min_barbers && arguments->barber_loop != THRLAB_BARBERS_THREAD)
+				argp_error (state, "--elastic needs --barber-loop=thread");
+
+			/* customers are forked into a pool of worker processes, as
+			 * the barbers are; the virtual clock lives in one process */
+			if (arguments->barber_loop == THRLAB_BARBERS_PROCESS)
+			{
+				if (arguments->dispatch_set && arguments->dispatch != DISPATCH_POOL)
+					argp_error (state, "--barber-loop=process serves customers from --dispatch=pool");
+
+				arguments->dispatch = DISPATCH_POOL;
+			}
+			if (arguments->barber_loop == THRLAB_BARBERS_PROCESS && arguments->virtual_time)
+				argp_error (state, "--barber-loop=process can't run in virtual time");
+
+			if (arguments->record_only && arguments->trace == NULL)
+				argp_error (state, "--record-only needs --trace");
+
+			/* every barber's named after a room */
+			if (arguments->shops * arguments->barbers > BARBERS_MAX)
+				argp_error (state, "only %d barbers to go round the shops", BARBERS_MAX);
+
+			/* event loops and the elastic controller look after one
+			 * waiting room; the validator checks one */
+			if (arguments->shops > 1 && arguments->barber_loop == THRLAB_BARBERS_EVENT)
+				argp_error (state, "--shops can't run on --barber-loop=event");
+			if (arguments->shops > 1 && arguments->min_barbers)
+				argp_error (state, "--elastic runs a single shop");
+			if (arguments->shops > 1 && arguments->record_only)
+				argp_error (state, "--record-only checks a single shop");
+
+			/* haircuts end on kernel timers, which virtual time can't move */
+			if (arguments->barber_loop == THRLAB_BARBERS_EVENT && arguments->virtual_time)
+				argp_error (state, "--barber-loop=event can't run in virtual time");
+
+			/* the arrival mean defaults to --rate, whichever came first */
+			if (dist_finish (&arguments->arrivals, arguments->rate))
+				argp_error (state, "bad --arrivals distribution");
+			if (dist_finish (&arguments->hair_length, NAN))
+				argp_error (state, "bad --hair-length distribution");
+			if (dist_finish (&arguments->hair_goal, NAN))
+				argp_error (state, "bad --hair-goal distribution");
+			break;
 		default:
 			return ARGP_ERR_UNKNOWN;
 	}
@@ -394,7 +716,7 @@ static struct arguments argparse (int *argc, char ***argv)
 				, .key = 'b'
 				, .arg = "NUM"
 				, .flags = 0
-				, .doc = "Number of barbers employed [default = 3]"
+				, .doc = "Number of barbers employed in each shop [default = 3]"
 				, .group = 0
 				}
 			, (struct argp_option)
@@ -402,7 +724,7 @@ static struct arguments argparse (int *argc, char ***argv)
 				, .key = 'w'
 				, .arg = "NUM"
 				, .flags = 0
-				, .doc = "Number of waiting chairs [default = 2]"
+				, .doc = "Number of waiting chairs in each shop [default = 2]"
 				, .group = 0
 				}
 			, (struct argp_option)
@@ -422,6 +744,280 @@ static struct arguments argparse (int *argc, char ***argv)
 				         " [default = 1000]"
 				, .group = 0
 				}
+			, (struct argp_option)
+				{ .name = "dispatch"
+				, .key = KEY_DISPATCH
+				, .arg = "MODE"
+				, .flags = 0
+				, .doc = "How customers are run: `thread' spawns a thread per"
+				         " customer, `pool' hands them to pre-spawned workers,"
+				         " `fiber' runs each in a fiber on a few carrier threads"
+				         " [default = thread, or pool with"
+				         " --barber-loop=process, whose workers are processes]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "workers"
+				, .key = KEY_WORKERS
+				, .arg = "NUM"
+				, .flags = 0
+				, .doc = "Number of customer workers in pool mode, or carrier"
+				         " threads in fiber mode [default = barbers + chairs"
+				         " in every shop + 1, or one per CPU for fibers]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "queue"
+				, .key = KEY_QUEUE
+				, .arg = "KIND"
+				, .flags = 0
+				, .doc = "Waiting room queue: `sbuf' (semaphores), `ring'"
+				         " (lock-free) or `heap' (ordered by --policy)"
+				         " [default = sbuf, or heap with a --policy]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "policy"
+				, .key = KEY_POLICY
+				, .arg = "POLICY"
+				, .flags = 0
+				, .doc = "Who's served next from a heap waiting room: `fifo',"
+				         " `sjf' (shortest haircut), `srpt' (the same as"
+				         " `sjf', since barbers never put anyone back) or"
+				         " `aging[:FACTOR]' (shortest, less FACTOR"
+				         " times the wait) [default = fifo, FACTOR = 1]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "barber-loop"
+				, .key = KEY_BARBER_LOOP
+				, .arg = "MODE"
+				, .flags = 0
+				, .doc = "How barbers are run: `thread' gives each a thread,"
+				         " `event' multiplexes every room over a few epoll"
+				         " loops, `process' forks each, and every customer"
+				         " worker, into a process of its own over shared"
+				         " memory [default = thread]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "pin"
+				, .key = KEY_PIN
+				, .arg = "HOW"
+				, .flags = 0
+				, .doc = "Pin each barber to a CPU: `compact' fills one NUMA"
+				         " node core by core, `spread' deals them out across"
+				         " nodes and cores. Everyone else is kept to the"
+				         " barbers' nodes [default = none]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "elastic"
+				, .key = KEY_ELASTIC
+				, .arg = "MIN"
+				, .flags = 0
+				, .doc = "Keep between MIN and -b barbers on duty, sending"
+				         " them home or calling them in as the waiting room"
+				         " and arrivals call for"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "loops"
+				, .key = KEY_LOOPS
+				, .arg = "NUM"
+				, .flags = 0
+				, .doc = "Number of event loop threads in event mode, at most"
+				         " one per barber [default = 1]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "shops"
+				, .key = KEY_SHOPS
+				, .arg = "NUM"
+				, .flags = 0
+				, .doc = "Number of shops, each with its own barbers, waiting"
+				         " room and lock, behind one front door [default = 1]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "route"
+				, .key = KEY_ROUTE
+				, .arg = "MODE"
+				, .flags = 0
+				, .doc = "How the front door picks a shop: `p2c' sends each"
+				         " customer to the less loaded of two at random,"
+				         " `jsq' to the least loaded of all, `random' to any"
+				         " [default = p2c]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "sync"
+				, .key = KEY_SYNC
+				, .arg = "MODE"
+				, .flags = 0
+				, .doc = "How customer transitions are checked: `atomic'"
+				         " compare-and-swaps each customer, `mutex' serializes"
+				         " them on one lock [default = atomic]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "lock-profile"
+				, .key = KEY_LOCK_PROFILE
+				, .arg = NULL
+				, .flags = 0
+				, .doc = "Time every acquisition of the harness mutex and the"
+				         " waiting room's lock, by call site, and print how"
+				         " long each waited and held it at closing. Most"
+				         " harness sites only lock with --sync=mutex"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "log"
+				, .key = KEY_LOG
+				, .arg = "MODE"
+				, .flags = 0
+				, .doc = "`async' buffers log lines per thread and prints them"
+				         " in batches, `sync' prints each line as it happens,"
+				         " `none' prints nothing [default = async, or none"
+				         " when tracing]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "trace"
+				, .key = KEY_TRACE
+				, .arg = "FILE"
+				, .flags = 0
+				, .doc = "Record every event in FILE as a binary trace for"
+				         " thrlab-decode"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "trace-size"
+				, .key = KEY_TRACE_SIZE
+				, .arg = "NUM"
+				, .flags = 0
+				, .doc = "Records kept in the trace before it wraps around"
+				         " [default = 1048576]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "record-only"
+				, .key = KEY_RECORD_ONLY
+				, .arg = NULL
+				, .flags = 0
+				, .doc = "Only record transitions in the --trace, checking and"
+				         " counting nothing, for thrlab-validate to check"
+				         " afterwards"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "virtual-time"
+				, .key = KEY_VIRTUAL_TIME
+				, .arg = NULL
+				, .flags = 0
+				, .doc = "Run on a simulated clock that skips ahead whenever"
+				         " every thread is waiting, instead of the wall clock"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "seed"
+				, .key = KEY_SEED
+				, .arg = "NUM"
+				, .flags = 0
+				, .doc = "Seed for the random arrivals [default = the time]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "report"
+				, .key = KEY_REPORT
+				, .arg = "FILE"
+				, .flags = 0
+				, .doc = "Write the day's counters to FILE as `name value'"
+				         " lines when the shop closes"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "stats"
+				, .key = KEY_STATS
+				, .arg = "FILE"
+				, .flags = 0
+				, .doc = "Keep the live counters, throughput and room"
+				         " occupancy in FILE while the shop is open, for"
+				         " thrlab-top to watch"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "arrivals"
+				, .key = KEY_ARRIVALS
+				, .arg = "DIST"
+				, .flags = 0
+				, .doc = "Milliseconds between customers: `uniform', `exp'"
+				         " (Poisson arrivals), `mmpp[:MEAN,FACTOR,DWELL]'"
+				         " (bursts), `pareto[:MEAN,ALPHA]' or"
+				         " `lognormal[:MEAN,SIGMA]'; MEAN defaults to --rate"
+				         " [default = uniform, over 0 to twice the rate]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "hair-length"
+				, .key = KEY_HAIR_LENGTH
+				, .arg = "DIST"
+				, .flags = 0
+				, .doc = "Customers' hair length in millimetres, as `const:V',"
+				         " `uniform:LO,HI', `normal:MEAN,SD', `exp:MEAN' or"
+				         " one of the arrival shapes [default = uniform:100,200]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "hair-goal"
+				, .key = KEY_HAIR_GOAL
+				, .arg = "DIST"
+				, .flags = 0
+				, .doc = "Hair length customers want, in millimetres; always"
+				         " kept shorter than their hair [default = uniform:50,75]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "replay"
+				, .key = KEY_REPLAY
+				, .arg = "FILE"
+				, .flags = 0
+				, .doc = "Take arrivals from FILE (`-' for standard input),"
+				         " one `OFFSET HAIR_LENGTH HAIR_GOAL' line per customer"
+				         " with OFFSET in milliseconds since opening; the day"
+				         " ends with the file or after -c customers"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "open-day"
+				, .key = KEY_OPEN_DAY
+				, .arg = NULL
+				, .flags = 0
+				, .doc = "Stay open until -c customers have come, or forever"
+				         " without -c; interrupt to close. Memory stays bounded"
+				         " by the --slots customers in the shop at once"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "slots"
+				, .key = KEY_SLOTS
+				, .arg = "NUM"
+				, .flags = 0
+				, .doc = "Customers the harness keeps track of at once; arrivals"
+				         " wait while all are taken [default = the day's"
+				         " customers, or 4 * (barbers + chairs) + 16 for an"
+				         " open day]"
+				, .group = 0
+				}
+			, (struct argp_option)
+				{ .name = "fiber-stack"
+				, .key = KEY_FIBER_STACK
+				, .arg = "KB"
+				, .flags = 0
+				, .doc = "Stack size of each customer fiber in fiber mode"
+				         " [default = 64]"
+				, .group = 0
+				}
 			, (struct argp_option)
 				{ .name = NULL
 				}
@@ -435,14 +1031,78 @@ static struct arguments argparse (int *argc, char ***argv)
 	struct arguments arguments = (struct arguments)
 		{ .barbers = 3
 		, .chairs = 2
+		, .shops = 1
+		, .route = ROUTE_P2C
 		, .customers = 10
 		, .rate = 1000
+		, .dispatch = DISPATCH_THREAD
+		, .dispatch_set = 0
+		, .workers = 0
+		, .queue = THRLAB_QUEUE_SBUF
+		, .queue_set = 0
+		, .policy = POLICY_FIFO
+		, .aging = 1
+		, .barber_loop = THRLAB_BARBERS_THREAD
+		, .loops = 1
+		, .min_barbers = 0
+		, .pin = 0
+		, .pin_order = TOPO_COMPACT
+		, .sync = SYNC_ATOMIC
+		, .lock_profile = 0
+		, .log = LOG_ASYNC
+		, .log_set = 0
+		, .trace = NULL
+		, .trace_size = 1 << 20
+		, .record_only = 0
+		, .virtual_time = 0
+		, .seed = time (NULL)
+		, .report = NULL
+		, .stats = NULL
+		, .replay = NULL
+		, .customers_set = 0
+		, .open_day = 0
+		, .slots = 0
+		, .fiber_stack = 64 * 1024
 		};
 
+	dist_parse (&arguments.arrivals, "uniform");
+	dist_parse (&arguments.hair_length, "uniform:100,200");
+	dist_parse (&arguments.hair_goal, "uniform:50,75");
+
 	argp_parse (&argp, *argc, *argv, 0, NULL, &arguments);
 
-	return arguments;
-}
+	/* the trace replaces the text log, unless asked for both */
+	if (arguments.trace && !arguments.log_set)
+		arguments.log = LOG_NONE;
+
+	/* an open day, or a replay, runs to the end unless cut short */
+	if (arguments.open_day && !arguments.customers_set)
+		arguments.customers = SIZE_MAX;
+	else if (arguments.replay && !arguments.customers_set)
+		arguments.customers = CUSTOMERS_MAX;
+
+	/* everyone the shops can hold at once */
+	size_t capacity = arguments.shops * (arguments.barbers + arguments.chairs);
+
+	if (arguments.slots == 0)
+	{
+		arguments.slots = arguments.open_day
+			? 4 * capacity + 16
+			: arguments.customers;
+	}
+
+	if (arguments.loops > arguments.barbers)
+		arguments.loops = arguments.barbers;
+
+	/* enough workers that everyone who could get a seat is being served;
+	 * fibers park while they wait, so carriers only need to keep CPUs busy */
+	if (arguments.workers == 0 && arguments.dispatch == DISPATCH_FIBER)
+		arguments.workers = sysconf (_SC_NPROCESSORS_ONLN);
+	else if (arguments.workers == 0)
+		arguments.workers = capacity + 1;
+
+	return arguments;
+}
 
 static double timespec_diff (struct timespec now, struct timespec before)
 {
@@ -453,603 +1113,2035 @@ static double timespec_diff (struct timespec now, struct timespec before)
 	return dt;
 }
 
+static int64_t timespec_diff_ns (struct timespec now, struct timespec before)
+{
+	return (int64_t) (now.tv_sec - before.tv_sec) * 1000000000
+		+ (now.tv_nsec - before.tv_nsec);
+}
+
+/**
+ * Like `clock_gettime (CLOCK_MONOTONIC, ts)`, but on the virtual clock when
+ * running in virtual time.
+ */
+static int thrlab_clock (struct timespec *ts)
+{
+	assert (ts);
+
+	if (!thrlab->virtual_time)
+		return clock_gettime (CLOCK_MONOTONIC, ts);
+
+	uint64_t ns = thrlab->start.tv_nsec + vclock_now ();
+
+	ts->tv_sec = thrlab->start.tv_sec + ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+
+	return 0;
+}
+
+static struct timespec thrlab_now ()
+{
+	struct timespec ts;
+
+	int status = thrlab_clock (&ts);
+	assert (status == 0);
+
+	return ts;
+}
+
+/**
+ * Nanoseconds since the shop opened.
+ */
+static uint64_t thrlab_elapsed_ns ()
+{
+	return timespec_diff_ns (thrlab_now (), thrlab->start);
+}
+
+/**
+ * Sleep on whichever clock the shop runs on.
+ */
+static void thrlab_sleep_ns (uint64_t ns)
+{
+	if (thrlab->virtual_time)
+	{
+		vclock_sleep (ns);
+		return;
+	}
+
+	struct timespec ts = (struct timespec)
+		{ .tv_sec = ns / 1000000000
+		, .tv_nsec = ns % 1000000000
+		};
+
+	while (ts.tv_sec > 0 || ts.tv_nsec > 0)
+	{
+		int status = nanosleep (&ts, &ts);
+
+		if (status == -1)
+		{
+			assert (errno == EINTR);
+			continue;
+		}
+
+		break;
+	}
+}
+
 static void time_printf (const char *format, ...)
 {
 	assert (thrlab);
 	assert (format);
 
+	if (!log_enabled ())
+		return;
+
 	va_list ap;
 	va_start (ap, format);
 
 	struct timespec current;
 
-	int status = clock_gettime (CLOCK_MONOTONIC, &current);
+	int status = thrlab_clock (&current);
 	assert (status == 0);
 
-	printf ("%9.3f: ", timespec_diff (current, thrlab->start));
-	vprintf (format, ap);
+	log_vprintf (timespec_diff (current, thrlab->start), format, ap);
 
 	va_end (ap);
 }
 
-static unsigned int add_customer
-	( struct customer *customer
-	, enum customer_status status
-	)
+/**
+ * Take the harness mutex from `site`.
+ */
+static void shop_lock (enum lock_site site)
 {
-	assert (thrlab);
-	assert (customer);
-	assert (thrlab->customer_count < thrlab->visitors);
+	lockprof_mutex_lock (thrlab->locks ? &thrlab->locks[site] : NULL, &thrlab->mtx);
+}
 
-	thrlab->customers[thrlab->customer_count] = customer;
-	thrlab->statuses[thrlab->customer_count] = status;
+static void shop_unlock (enum lock_site site)
+{
+	lockprof_mutex_unlock (thrlab->locks ? &thrlab->locks[site] : NULL, &thrlab->mtx);
+}
 
-	return thrlab->customer_count++;
+/**
+ * Take the harness mutex, unless transitions are checked atomically.
+ */
+static void sync_lock (enum lock_site site)
+{
+	if (thrlab->sync == SYNC_MUTEX)
+		shop_lock (site);
 }
 
-static double customer_cutting_time (struct customer *customer)
+static void sync_unlock (enum lock_site site)
 {
-	assert (thrlab);
-	assert (customer);
+	if (thrlab->sync == SYNC_MUTEX)
+		shop_unlock (site);
+}
 
-	return 0.005 * (customer->hair_length - customer->hair_goal);
+/**
+ * Read a live count as signed. Without the mutex a confused barber can
+ * decrement a count before the customer's own increment lands, and the
+ * momentary underflow mustn't look like a full waiting room.
+ */
+static ptrdiff_t live_count (size_t count)
+{
+	return (ptrdiff_t) count;
 }
 
-static void sleep_until_customer ()
+static struct visitor *visitor_of (struct customer *customer)
 {
-	assert (thrlab);
+	return (struct visitor *) customer;
+}
 
-	/* Add some funky pseudo-randomness */
-	thrlab_sleep (my_arc4random_uniform (thrlab->rate * 2));
+/**
+ * A handle on a visitor's slot that also names which use of the slot it was
+ * taken for.
+ */
+static void *visitor_handle (struct visitor *visitor)
+{
+	uint64_t index = visitor - thrlab->slots;
+
+	return (void *) (uintptr_t) ((uint64_t) visitor->generation << 32 | index);
 }
 
-static const char *random_name ()
+/**
+ * Join a finished customer's thread and free up their slot.
+ */
+static void reap_visitor (void *handle)
 {
-	size_t id = my_arc4random_uniform (ARRSIZE (customer_names));
+	uint64_t h = (uintptr_t) handle;
+	struct visitor *visitor = &thrlab->slots[(uint32_t) h];
+
+	assert ((uint32_t) h < thrlab->num_slots);
+	assert (visitor->generation == h >> 32);
+
+	if (thrlab->dispatch == DISPATCH_THREAD)
+	{
+		int status = pthread_join (visitor->customer.thread, NULL);
+		assert (status == 0);
+	}
 
-	return customer_names[id];
+	++visitor->generation;
+	thrlab->free_slots[thrlab->num_free++] = (uint32_t) h;
+	++thrlab->reaped;
 }
 
-static void check_complaints ()
+/**
+ * Whether the process `*pid`, forked with --barber-loop=process, has died;
+ * say so, as `who`, the first time it's noticed.
+ */
+static bool child_lost (pid_t *child, const char *who)
 {
-	size_t complaints
-		= thrlab->num_cutting
-		+ thrlab->num_waiting
-		+ thrlab->num_pending
-		+ thrlab->complaint_reject_avail
-		+ thrlab->complaint_reject_wait
-		+ thrlab->complaint_reject_cut
-		+ thrlab->complaint_reject_done
-		+ thrlab->complaint_reject_again
-		+ thrlab->complaint_accept_full
-		+ thrlab->complaint_accept_wait
-		+ thrlab->complaint_accept_cut
-		+ thrlab->complaint_accept_done
-		+ thrlab->complaint_accept_reject
-		+ thrlab->complaint_prepare_pending
-		+ thrlab->complaint_prepare_busy
-		+ thrlab->complaint_prepare_again
-		+ thrlab->complaint_prepare_done
-		+ thrlab->complaint_prepare_reject
-		+ thrlab->complaint_prepare_self
-		+ thrlab->complaint_dismiss_pending
-		+ thrlab->complaint_dismiss_wait
-		+ thrlab->complaint_dismiss_done
-		+ thrlab->complaint_dismiss_reject
-		+ thrlab->complaint_dismiss_room
-		+ thrlab->complaint_dismiss_self
-		+ thrlab->complaint_dismiss_early
-		+ thrlab->complaint_cut_fast
-		+ thrlab->complaint_cut_slow;
-
-	if (complaints == 0)
-		return;
+	pid_t pid = *child;
+	int wstatus;
 
-	printf
-		( "\nOH NO%s! %s submitted %s!\n"
-		, (complaints > 1) ? "ES" : ""
-		, (complaints > 1) ? "Some customers" : "A customer"
-		, (complaints > 1) ? "a number of complaints" : "a complaint"
-		);
+	if (pid == -1)
+		return true;
 
-	size_t forgotten = thrlab->num_cutting + thrlab->num_waiting;
+	if (pid == 0 || waitpid (pid, &wstatus, WNOHANG) != pid)
+		return false;
 
-	if (forgotten)
+	if (WIFSIGNALED (wstatus))
 	{
-		printf
-			("  - %zu customer%s locked inside!"
-			, forgotten
-			, (forgotten > 1) ? "s were" : " was"
+		fprintf
+			( stderr
+			, "thrlab: %s's process died: %s\n"
+			, who
+			, strsignal (WTERMSIG (wstatus))
+			);
+	}
+	else
+	{
+		fprintf
+			( stderr
+			, "thrlab: %s's process exited with status %d\n"
+			, who
+			, WEXITSTATUS (wstatus)
 			);
+	}
 
-		if (thrlab->num_cutting)
-		{
-			printf
-				( ", of which %zu %s still being cut!\n"
-				, thrlab->num_cutting
-				, (thrlab->num_cutting > 1) ? "were" : "was"
-				);
-		}
-		else
+	*child = -1;
+	return true;
+}
+
+/**
+ * Whether the barber in `room` has died.
+ */
+static bool barber_lost (size_t room)
+{
+	return child_lost (&thrlab->barber_pids[room], barber_name (room));
+}
+
+/**
+ * Whether customer worker `i` has died, taking whoever it was seeing to with
+ * it.
+ */
+static bool worker_lost (size_t i)
+{
+	char who[32];
+
+	snprintf (who, sizeof (who), "customer worker %zu", i);
+
+	return child_lost (&thrlab->worker_pids[i], who);
+}
+
+/**
+ * Whether nobody still in the shop can be served by a living barber: nobody
+ * pending or waiting, and every surviving room empty.
+ */
+static bool shop_stuck ()
+{
+	/* nothing's counted with --record-only; only time will tell */
+	if (thrlab->record_only)
+		return true;
+
+	if (atomic_load (&thrlab->num_pending) > 0 || atomic_load (&thrlab->num_waiting) > 0)
+		return false;
+
+	for (size_t i = 0; i < thrlab->barbers; ++i)
+	{
+		if (!barber_lost (i) && atomic_load (&thrlab->occupancy[i]) != NULL)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Wait for everyone to leave the shop while barber and customer worker
+ * processes may be dying under them. Whoever a dead barber was holding will
+ * never be dismissed, and whoever a dead worker was seeing to will never
+ * leave, so once the rest have been seen to they're left behind.
+ *
+ * Returns the number of customers left behind.
+ */
+static size_t await_barbers ()
+{
+	uint64_t quiet_ns = 0;
+
+	while (thrlab->reaped < thrlab->customer_count)
+	{
+		void *handle;
+		size_t lost = 0;
+		size_t lost_workers = 0;
+
+		if (ring_try_remove (&thrlab->done, &handle))
 		{
-			printf ("!\n");
+			reap_visitor (handle);
+			quiet_ns = 0;
+			continue;
 		}
+
+		for (size_t i = 0; i < thrlab->barbers; ++i)
+			lost += barber_lost (i);
+
+		for (size_t i = 0; i < thrlab->num_workers; ++i)
+			lost_workers += worker_lost (i);
+
+		if (quiet_ns >= LOST_GRACE_MS * 1000000ull
+			&& (lost_workers > 0 || (lost > 0 && shop_stuck ())))
+			return thrlab->customer_count - thrlab->reaped;
+
+		thrlab_sleep_ns (1000000);
+		quiet_ns += 1000000;
 	}
 
-	if (thrlab->num_pending)
+	return 0;
+}
+
+/**
+ * Send the barber processes home for good; they'd wait for customers forever.
+ *
+ * Returns the number of barbers that ran as processes.
+ */
+static size_t stop_barbers ()
+{
+	size_t forked = 0;
+
+	for (size_t i = 0; i < thrlab->barbers; ++i)
 	{
-		printf
-			( "  - %zu %s never greeted at the door!\n"
-			, thrlab->num_pending
-			, (thrlab->num_pending > 1) ? "were" : "was"
-			);
+		pid_t pid = thrlab->barber_pids[i];
+
+		if (pid == 0)
+			continue;
+
+		++forked;
+
+		if (barber_lost (i))
+			continue;
+
+		kill (pid, SIGKILL);
+		waitpid (pid, NULL, 0);
 	}
 
-	if (thrlab->complaint_reject_avail)
+	return forked;
+}
+
+/**
+ * The same for the customer workers, who'd wait at the door forever.
+ */
+static void stop_workers ()
+{
+	for (size_t i = 0; i < thrlab->num_workers; ++i)
 	{
-		printf
-			( "  - %zu %s shown the door, but witnessed that seats were"
-			  " available! (If this is the only complaint, then this might be OK)\n"
-			, thrlab->complaint_reject_avail
-			, (thrlab->complaint_reject_avail > 1) ? "were" : "was"
-			);
+		pid_t pid = thrlab->worker_pids[i];
+
+		if (pid == 0 || worker_lost (i))
+			continue;
+
+		kill (pid, SIGKILL);
+		waitpid (pid, NULL, 0);
 	}
+}
+
+/**
+ * Take a slot for a new customer, reaping whoever has left in the meantime
+ * and waiting for someone to leave if the shop is full.
+ */
+static struct visitor *claim_visitor ()
+{
+	void *handle;
 
-	if (thrlab->complaint_reject_wait)
+	while (ring_try_remove (&thrlab->done, &handle))
+		reap_visitor (handle);
+
+	if (thrlab->num_free == 0)
 	{
-		printf
-			( "  - %zu %s shown the door whilst waiting for a barber!\n"
-			, thrlab->complaint_reject_wait
-			, (thrlab->complaint_reject_wait > 1) ? "were" : "was"
-			);
+		++thrlab->stalls;
+		reap_visitor (ring_remove (&thrlab->done));
+	}
+
+	struct visitor *visitor = &thrlab->slots[thrlab->free_slots[--thrlab->num_free]];
+	size_t in_shop = thrlab->customer_count + 1 - thrlab->reaped;
+
+	if (in_shop > thrlab->peak_in_shop)
+		thrlab->peak_in_shop = in_shop;
+
+	visitor->customer.id = thrlab->customer_count++;
+	visitor->pid = 0;
+	atomic_init (&visitor->status, CUSTOMER_PENDING);
+	atomic_init (&visitor->times.arrived, thrlab_elapsed_ns ());
+	atomic_init (&visitor->times.accepted, 0);
+	atomic_init (&visitor->times.prepared, 0);
+
+	return visitor;
+}
+
+static int64_t customer_cutting_time (struct customer *customer)
+{
+	assert (thrlab);
+	assert (customer);
+
+	/* 5 ms per millimetre, in nanoseconds */
+	return 5000000 * ((int64_t) customer->hair_length - customer->hair_goal);
+}
+
+static void sleep_until_customer ()
+{
+	assert (thrlab);
+
+	double ms = dist_sample (&thrlab->arrivals, my_arc4random_uniform);
+
+	thrlab_sleep_ns ((ms > 0) ? ms * 1000000 : 0);
+}
+
+/**
+ * Sleep until `offset` nanoseconds after opening, if that's still to come.
+ */
+static void sleep_until_offset (uint64_t offset)
+{
+	uint64_t now = thrlab_elapsed_ns ();
+
+	if (offset > now)
+		thrlab_sleep_ns (offset - now);
+}
+
+static unsigned int clamp_hair (long mm, long min, long max)
+{
+	return (mm < min) ? min : (mm > max) ? max : mm;
+}
+
+/**
+ * Draw a hair length, in whole millimetres within `[min, max]`.
+ */
+static unsigned int random_hair (struct dist *dist, long min, long max)
+{
+	return clamp_hair (lround (dist_sample (dist, my_arc4random_uniform)), min, max);
+}
+
+static size_t random_name ()
+{
+	return my_arc4random_uniform (num_customer_names);
+}
+
+/* the calling thread's complaint shard, picked on its first complaint */
+static __thread unsigned int complaint_shard = UINT_MAX;
+
+/**
+ * Count a complaint on the calling thread's shard.
+ */
+static void complain (enum complaint complaint)
+{
+	if (complaint_shard == UINT_MAX)
+		complaint_shard = atomic_fetch_add (&thrlab->next_shard, 1) % COUNTER_SHARDS;
+
+	atomic_fetch_add_explicit
+		( &thrlab->shards[complaint_shard].complaints[complaint]
+		, 1
+		, memory_order_relaxed
+		);
+}
+
+/**
+ * Add up a complaint over every shard.
+ */
+static size_t complaint_count (enum complaint complaint)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < COUNTER_SHARDS; ++i)
+		count += atomic_load_explicit (&thrlab->shards[i].complaints[complaint], memory_order_relaxed);
+
+	return count;
+}
+
+static void check_complaints ()
+{
+	if (thrlab->record_only)
+	{
+		printf ("\nNothing was checked; see what thrlab-validate makes of the trace.\n");
+		return;
 	}
 
-	if (thrlab->complaint_reject_cut)
+	size_t counts[NUM_COMPLAINTS];
+
+	for (size_t i = 0; i < NUM_COMPLAINTS; ++i)
+		counts[i] = complaint_count (i);
+
+	complaint_print
+		( counts
+		, thrlab->num_cutting
+		, thrlab->num_waiting
+		, thrlab->num_pending
+		);
+}
+
+static const double latency_percentiles[] = { 50, 90, 99, 99.9 };
+
+/**
+ * Latency names, as reported and as printed.
+ */
+static const struct
+{
+	const char *name;
+	const char *label;
+} latencies[] =
+	{ [LATENCY_WAIT] = { "wait", "queue wait" }
+	, [LATENCY_SERVICE] = { "service", "service" }
+	, [LATENCY_TURNAROUND] = { "turnaround", "turnaround" }
+	};
+
+static void print_latencies ()
+{
+	if (hist_count (&thrlab->latency[LATENCY_TURNAROUND]) == 0)
+		return;
+
+	printf ("\nLatency (ms)       count      p50      p90      p99    p99.9      max\n");
+
+	for (size_t i = 0; i < ARRSIZE (latencies); ++i)
 	{
-		printf
-			( "  - %zu %s shown the door in the middle of a haircut!\n"
-			, thrlab->complaint_reject_cut
-			, (thrlab->complaint_reject_cut > 1) ? "were" : "was"
-			);
+		const struct hist *hist = &thrlab->latency[i];
+
+		printf ("  %-12s %9llu", latencies[i].label, (unsigned long long) hist_count (hist));
+
+		for (size_t j = 0; j < ARRSIZE (latency_percentiles); ++j)
+			printf (" %8.2f", hist_percentile (hist, latency_percentiles[j]) / 1000000.0);
+
+		printf (" %8.2f\n", hist_max (hist) / 1000000.0);
 	}
+}
+
+/**
+ * Lock sites, as reported and as printed.
+ */
+static const struct
+{
+	const char *name;
+	const char *label;
+} lock_sites[] =
+	{ [LOCK_ARRIVAL] = { "arrival", "arrival" }
+	, [LOCK_ACCEPT] = { "accept", "accept" }
+	, [LOCK_REJECT] = { "reject", "reject" }
+	, [LOCK_PREPARE] = { "prepare", "prepare" }
+	, [LOCK_DISMISS] = { "dismiss", "dismiss" }
+	, [LOCK_HANDOFF] = { "handoff", "handoff" }
+	, [LOCK_LEAVE] = { "leave", "leave" }
+	, [LOCK_SEAT] = { "seat", "chairs: seat" }
+	, [LOCK_PICKUP] = { "pickup", "chairs: pickup" }
+	};
+
+/**
+ * Lock profiles kept for `shops` shops: the harness's sites, then a seat and
+ * a pickup for each waiting room, as no two rooms share a lock.
+ */
+static size_t num_lock_profiles (size_t shops)
+{
+	return LOCK_SEAT + 2 * shops;
+}
+
+/**
+ * Name and label lock profile `i`, as reported and as printed; a waiting
+ * room's carry its shop's number when there's more than one.
+ */
+static void lock_profile_names
+	( size_t i
+	, char *name
+	, char *label
+	, size_t size
+	)
+{
+	size_t site = (i < LOCK_SEAT) ? i : LOCK_SEAT + (i - LOCK_SEAT) % 2;
+
+	if (i < LOCK_SEAT || thrlab->num_shops == 1)
+	{
+		snprintf (name, size, "%s", lock_sites[site].name);
+		snprintf (label, size, "%s", lock_sites[site].label);
+	}
+	else
+	{
+		size_t shop = (i - LOCK_SEAT) / 2;
+
+		snprintf (name, size, "shop.%zu.%s", shop, lock_sites[site].name);
+		snprintf (label, size, "shop %zu: %s", shop, lock_sites[site].name);
+	}
+}
+
+/**
+ * How unevenly the front door spread the day: the busiest shop's arrivals
+ * over the mean, 1 when they're even.
+ */
+static double shop_imbalance ()
+{
+	size_t total = 0;
+	size_t most = 0;
+
+	for (size_t i = 0; i < thrlab->num_shops; ++i)
+	{
+		size_t arrived = atomic_load (&thrlab->shops[i].arrived);
+
+		total += arrived;
+		if (arrived > most) most = arrived;
+	}
+
+	return total ? (double) most * thrlab->num_shops / total : 1.0;
+}
+
+static const char *route_names[] =
+	{ [ROUTE_P2C] = "p2c"
+	, [ROUTE_JSQ] = "jsq"
+	, [ROUTE_RANDOM] = "random"
+	};
+
+static void print_shops ()
+{
+	if (thrlab->num_shops == 1)
+		return;
+
+	size_t total_arrived = 0;
+	size_t total_rejected = 0;
+
+	printf ("\nShop            arrived  rejected  reject %%    served  peak load\n");
+
+	for (size_t i = 0; i < thrlab->num_shops; ++i)
+	{
+		const struct shop *shop = &thrlab->shops[i];
+		size_t arrived = atomic_load (&shop->arrived);
+		size_t rejected = atomic_load (&shop->rejected);
+
+		total_arrived += arrived;
+		total_rejected += rejected;
+
+		printf
+			( "  %-12zu %9zu %9zu %9.1f %9zu %10zu\n"
+			, i
+			, arrived
+			, rejected
+			, arrived ? 100.0 * rejected / arrived : 0.0
+			, atomic_load (&shop->served)
+			, atomic_load (&shop->peak_load)
+			);
+	}
+
+	printf
+		( "Routed by %s, the busiest shop saw %.2fx the mean arrivals;"
+		  " %.1f%% were turned away overall.\n"
+		, route_names[thrlab->route]
+		, shop_imbalance ()
+		, total_arrived ? 100.0 * total_rejected / total_arrived : 0.0
+		);
+}
+
+static void print_locks ()
+{
+	if (thrlab->locks == NULL)
+		return;
+
+	printf
+		( "\nLock (us)        acquired contended  wait p50  wait p99  wait max"
+		  "  hold p50  hold p99  hold max\n"
+		);
+
+	for (size_t i = 0; i < num_lock_profiles (thrlab->num_shops); ++i)
+	{
+		const struct lockprof *prof = &thrlab->locks[i];
+		uint64_t acquired = atomic_load (&prof->acquired);
+		char name[32];
+		char label[32];
+
+		/* nothing locked here in this mode */
+		if (acquired == 0)
+			continue;
+
+		lock_profile_names (i, name, label, sizeof (label));
+
+		printf
+			( "  %-14s %9llu %9llu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n"
+			, label
+			, (unsigned long long) acquired
+			, (unsigned long long) atomic_load (&prof->contended)
+			, hist_percentile (&prof->wait, 50) / 1000.0
+			, hist_percentile (&prof->wait, 99) / 1000.0
+			, hist_max (&prof->wait) / 1000.0
+			, hist_percentile (&prof->hold, 50) / 1000.0
+			, hist_percentile (&prof->hold, 99) / 1000.0
+			, hist_max (&prof->hold) / 1000.0
+			);
+	}
+}
+
+/**
+ * Allocation counts and footprint of a slab.
+ */
+struct slab_stats
+{
+	const char *name;
+	size_t allocs;
+	size_t frees;
+	size_t peak;
+	size_t peak_bytes;
+	size_t reserved_bytes;
+};
+
+static struct slab_stats get_slab_stats (const char *name, struct slab *slab)
+{
+	return (struct slab_stats)
+		{ .name = name
+		, .allocs = slab->allocs
+		, .frees = atomic_load (&slab->frees)
+		, .peak = slab->peak
+		, .peak_bytes = slab->peak * slab->size
+		, .reserved_bytes = slab_reserved (slab)
+		};
+}
+
+/**
+ * The customer slots, counted like a slab.
+ */
+static struct slab_stats get_slot_stats ()
+{
+	return (struct slab_stats)
+		{ .name = "customer"
+		, .allocs = thrlab->customer_count
+		, .frees = thrlab->reaped
+		, .peak = thrlab->peak_in_shop
+		, .peak_bytes = thrlab->peak_in_shop * sizeof (struct visitor)
+		, .reserved_bytes = thrlab->num_slots * sizeof (struct visitor)
+		};
+}
+
+static void print_slabs ()
+{
+	const struct slab_stats stats[] =
+		{ get_slot_stats ()
+		, get_slab_stats ("dispatch", &thrlab->dispatch_slab)
+		};
+
+	printf ("\nSlab               allocs    frees     peak peak bytes   reserved\n");
+
+	for (size_t i = 0; i < ARRSIZE (stats); ++i)
+	{
+		printf
+			( "  %-12s %9zu %8zu %8zu %10zu %10zu\n"
+			, stats[i].name
+			, stats[i].allocs
+			, stats[i].frees
+			, stats[i].peak
+			, stats[i].peak_bytes
+			, stats[i].reserved_bytes
+			);
+	}
+
+	if (thrlab->stalls)
+	{
+		printf
+			( "  %zu arrival%s waited for one of the %zu slots to free up\n"
+			, thrlab->stalls
+			, (thrlab->stalls > 1) ? "s" : ""
+			, thrlab->num_slots
+			);
+	}
+}
+
+/**
+ * Say where the barbers were pinned.
+ */
+static void print_pinning ()
+{
+	if (!thrlab->pin)
+		return;
+
+	size_t nodes = 0;
+
+	printf
+		( "\nBarbers pinned %s to CPU%s"
+		, (thrlab->pin_order == TOPO_SPREAD) ? "spread" : "compact"
+		, (thrlab->barbers > 1) ? "s" : ""
+		);
+
+	for (size_t i = 0; i < thrlab->barbers; ++i)
+	{
+		const struct topo_cpu *cpu = topo_pick (&thrlab->topo, thrlab->pin_order, i);
+		size_t j = 0;
+
+		printf ("%s%d", i ? "," : " ", cpu->cpu);
+
+		/* count each node the first time it comes up */
+		while (j < i && topo_pick (&thrlab->topo, thrlab->pin_order, j)->node != cpu->node)
+			++j;
+
+		if (j == i)
+			++nodes;
+	}
+
+	printf
+		( "; everyone else on %d CPU%s. %zu of %zu NUMA node%s in use.\n"
+		, CPU_COUNT (&thrlab->shop_cpus)
+		, (CPU_COUNT (&thrlab->shop_cpus) > 1) ? "s" : ""
+		, nodes
+		, thrlab->topo.num_nodes
+		, (thrlab->topo.num_nodes > 1) ? "s" : ""
+		);
+}
+
+/**
+ * Weigh the barber time spent against the haircuts it bought.
+ */
+static void print_shifts ()
+{
+	double seconds = thrlab->duty_ns / 1000000000.0;
+	uint64_t haircuts = hist_count (&thrlab->latency[LATENCY_SERVICE]);
+
+	if (seconds == 0)
+		return;
+
+	printf
+		( "\n%.1f barber-seconds for %llu haircuts: %.3f haircuts per"
+		  " barber-second, at most %zu barber%s on duty.\n"
+		, seconds
+		, (unsigned long long) haircuts
+		, haircuts / seconds
+		, thrlab->peak_on_duty
+		, (thrlab->peak_on_duty > 1) ? "s" : ""
+		);
+}
+
+/**
+ * A named count, as reported.
+ */
+struct counter
+{
+	const char *name;
+	size_t value;
+};
+
+/**
+ * Read the day's counts and complaints so far into `counters`, which holds
+ * STATS_COUNTERS. Returns how many there are.
+ */
+static size_t get_counters (struct counter *counters)
+{
+	const struct counter current[] =
+		{ { "customers.arrived", thrlab->customer_count }
+		, { "customers.served", hist_count (&thrlab->latency[LATENCY_SERVICE]) }
+		, { "live.cutting", thrlab->num_cutting }
+		, { "live.waiting", thrlab->num_waiting }
+		, { "live.pending", thrlab->num_pending }
+		, { "live.on_duty", thrlab->on_duty }
+		};
+
+	_Static_assert
+		( ARRSIZE (current) + NUM_COMPLAINTS <= STATS_COUNTERS
+		, "too many counters"
+		);
+
+	memcpy (counters, current, sizeof (current));
+
+	for (size_t i = 0; i < NUM_COMPLAINTS; ++i)
+	{
+		counters[ARRSIZE (current) + i] = (struct counter)
+			{ .name = complaints[i].name
+			, .value = complaint_count (i)
+			};
+	}
+
+	return ARRSIZE (current) + NUM_COMPLAINTS;
+}
+
+/**
+ * Latest figures for the stats file. The customer count is the arrival
+ * thread's own; a stale read is fine here.
+ */
+static void fill_stats (uint64_t *ns, uint64_t *values, uint64_t *occupants)
+{
+	struct counter counters[STATS_COUNTERS];
+	size_t num_counters = get_counters (counters);
+
+	*ns = thrlab_elapsed_ns ();
+
+	for (size_t i = 0; i < num_counters; ++i)
+		values[i] = counters[i].value;
+
+	/* slots outlive the publisher, so an occupant is safe to read even if
+	 * they've just left */
+	for (size_t i = 0; i < thrlab->barbers; ++i)
+	{
+		struct customer *occupant = atomic_load (&thrlab->occupancy[i]);
+
+		occupants[i] = occupant ? occupant->id : STATS_NOBODY;
+	}
+}
+
+/**
+ * Start publishing the stats file at `path`.
+ *
+ * Returns 0 on success.
+ */
+static int open_stats (const char *path)
+{
+	struct counter counters[STATS_COUNTERS];
+	const char *names[STATS_COUNTERS];
+	size_t num_counters = get_counters (counters);
+
+	for (size_t i = 0; i < num_counters; ++i)
+		names[i] = counters[i].name;
+
+	return stats_open
+		( path
+		, thrlab->barbers
+		, names
+		, num_counters
+		, STATS_INTERVAL_MS
+		, fill_stats
+		);
+}
+
+/**
+ * Dump the configuration and every counter for tools such as thrlab-bench.
+ * Live counts are left-overs at closing time, and count as complaints.
+ */
+static void write_report (const char *path)
+{
+	assert (thrlab);
+	assert (path);
+
+	FILE *file = fopen (path, "w");
+
+	if (file == NULL)
+	{
+		perror (path);
+		return;
+	}
+
+	struct timespec now = thrlab_now ();
+	struct counter counters[STATS_COUNTERS];
+	size_t num_counters = get_counters (counters);
+
+	fprintf (file, "config.barbers %zu\n", thrlab->barbers);
+	fprintf (file, "config.chairs %zu\n", thrlab->chairs);
+
+	if (thrlab->visitors == SIZE_MAX)
+		fprintf (file, "config.customers unbounded\n");
+	else
+		fprintf (file, "config.customers %zu\n", thrlab->visitors);
+
+	fprintf (file, "config.rate %zu\n", thrlab->rate);
+	fprintf (file, "config.seed %u\n", thrlab->seed);
+	fprintf (file, "config.record_only %d\n", thrlab->record_only);
+	fprintf (file, "elapsed %.9f\n", timespec_diff (now, thrlab->start));
+
+	for (size_t i = 0; i < num_counters; ++i)
+		fprintf (file, "%s %zu\n", counters[i].name, counters[i].value);
+
+	const struct slab_stats stats[] =
+		{ get_slot_stats ()
+		, get_slab_stats ("dispatch", &thrlab->dispatch_slab)
+		};
+
+	fprintf (file, "barbers.duty_ms %llu\n", (unsigned long long) thrlab->duty_ns / 1000000);
+	fprintf (file, "barbers.peak %zu\n", thrlab->peak_on_duty);
+	fprintf (file, "slots.count %zu\n", thrlab->num_slots);
+	fprintf (file, "slots.stalls %zu\n", thrlab->stalls);
+	fprintf (file, "shared.bytes %zu\n", shared_used ());
+
+	if (thrlab->dispatch == DISPATCH_POOL && thrlab->worker_pids == NULL)
+	{
+		fprintf (file, "pool.workers %zu\n", thrlab->pool.num_workers);
+		fprintf (file, "pool.submitted %zu\n", thrlab->pool.submitted);
+		fprintf (file, "pool.peak_depth %zu\n", thrlab->pool.max_depth);
+	}
+
+	fprintf (file, "shops.count %zu\n", thrlab->num_shops);
+	fprintf (file, "shops.route %s\n", route_names[thrlab->route]);
+	fprintf (file, "shops.imbalance %.3f\n", shop_imbalance ());
+
+	for (size_t i = 0; i < thrlab->num_shops; ++i)
+	{
+		const struct shop *shop = &thrlab->shops[i];
+
+		fprintf (file, "shop.%zu.arrived %zu\n", i, atomic_load (&shop->arrived));
+		fprintf (file, "shop.%zu.rejected %zu\n", i, atomic_load (&shop->rejected));
+		fprintf (file, "shop.%zu.served %zu\n", i, atomic_load (&shop->served));
+		fprintf (file, "shop.%zu.peak_load %zu\n", i, atomic_load (&shop->peak_load));
+	}
+
+	for (size_t i = 0; i < ARRSIZE (stats); ++i)
+	{
+		fprintf (file, "slab.%s.allocs %zu\n", stats[i].name, stats[i].allocs);
+		fprintf (file, "slab.%s.frees %zu\n", stats[i].name, stats[i].frees);
+		fprintf (file, "slab.%s.peak %zu\n", stats[i].name, stats[i].peak);
+		fprintf (file, "slab.%s.peak_bytes %zu\n", stats[i].name, stats[i].peak_bytes);
+		fprintf (file, "slab.%s.reserved_bytes %zu\n", stats[i].name, stats[i].reserved_bytes);
+	}
+
+	/* in nanoseconds */
+	for (size_t i = 0; i < ARRSIZE (latencies); ++i)
+	{
+		const struct hist *hist = &thrlab->latency[i];
+
+		fprintf
+			( file
+			, "latency.%s.count %llu\n"
+			, latencies[i].name
+			, (unsigned long long) hist_count (hist)
+			);
+
+		for (size_t j = 0; j < ARRSIZE (latency_percentiles); ++j)
+		{
+			fprintf
+				( file
+				, "latency.%s.p%g %llu\n"
+				, latencies[i].name
+				, latency_percentiles[j]
+				, (unsigned long long) hist_percentile (hist, latency_percentiles[j])
+				);
+		}
+
+		fprintf
+			( file
+			, "latency.%s.max %llu\n"
+			, latencies[i].name
+			, (unsigned long long) hist_max (hist)
+			);
+	}
+
+	/* in nanoseconds */
+	for (size_t i = 0; thrlab->locks && i < num_lock_profiles (thrlab->num_shops); ++i)
+	{
+		const struct lockprof *prof = &thrlab->locks[i];
+		char name[32];
+		char label[32];
+
+		lock_profile_names (i, name, label, sizeof (name));
+
+		const struct
+		{
+			const char *name;
+			uint64_t value;
+		} fields[] =
+			{ { "acquired", atomic_load (&prof->acquired) }
+			, { "contended", atomic_load (&prof->contended) }
+			, { "wait.p50", hist_percentile (&prof->wait, 50) }
+			, { "wait.p99", hist_percentile (&prof->wait, 99) }
+			, { "wait.max", hist_max (&prof->wait) }
+			, { "hold.p50", hist_percentile (&prof->hold, 50) }
+			, { "hold.p99", hist_percentile (&prof->hold, 99) }
+			, { "hold.max", hist_max (&prof->hold) }
+			};
+
+		for (size_t j = 0; j < ARRSIZE (fields); ++j)
+		{
+			fprintf
+				( file
+				, "lock.%s.%s %llu\n"
+				, name
+				, fields[j].name
+				, (unsigned long long) fields[j].value
+				);
+		}
+	}
+
+	fclose (file);
+}
+
+/**
+ * Read the topology and keep the calling thread, and so every thread it
+ * starts, to the NUMA nodes the barbers will be pinned on. Memory is placed
+ * on first touch, so the shop's queues and slots end up local to the barbers.
+ *
+ * Returns 0 on success.
+ */
+static int pin_shop ()
+{
+	if (topo_load (&thrlab->topo) != 0)
+		return -1;
+
+	topo_nodes_of
+		( &thrlab->topo
+		, thrlab->pin_order
+		, thrlab->barbers
+		, &thrlab->shop_cpus
+		);
+
+	if (sched_setaffinity (0, sizeof (thrlab->shop_cpus), &thrlab->shop_cpus) != 0)
+	{
+		topo_free (&thrlab->topo);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Bytes of shared memory the shop needs with --barber-loop=process: the
+ * harness state barbers touch, plus room for the solution's waiting room.
+ */
+static size_t shared_size (const struct arguments *arguments)
+{
+	size_t rooms = arguments->shops * arguments->barbers;
+
+	return sizeof (*thrlab)
+		+ num_lock_profiles (arguments->shops) * sizeof (*thrlab->locks)
+		+ COUNTER_SHARDS * sizeof (*thrlab->shards)
+		+ arguments->shops * sizeof (*thrlab->shops)
+		+ arguments->slots * sizeof (*thrlab->slots)
+		+ 2 * arguments->slots * sizeof (*thrlab->done.buf)
+		+ rooms * sizeof (*thrlab->occupancy)
+		+ rooms * sizeof (*thrlab->duty_since)
+		+ arguments->shops * arguments->chairs * SHARED_PER_CHAIR
+		+ SHARED_SLACK;
+}
+
+/**
+ * Allocate `size` bytes of harness state, aligned to a cache line; out of the
+ * shared segment if there is one, so that barber processes see it too.
+ */
+static void *shop_alloc (size_t size)
+{
+	if (shared_enabled ())
+		return shared_alloc (size);
+
+	return aligned_alloc (CACHE_LINE, (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE);
+}
+
+static void shop_free (void *p)
+{
+	if (!shared_contains (p))
+		free (p);
+}
+
+/******************************************************************************
+ * Initialization & Cleanup
+ *****************************************************************************/
+
+/**
+ * Hold stdio across a fork. The child gets only the forking thread, and a
+ * stream some other thread was printing to at the time would stay locked in
+ * it for good; flushing first keeps the child from printing it all again.
+ */
+static void stdio_prefork ()
+{
+	flockfile (stdout);
+	flockfile (stderr);
+	fflush (stdout);
+}
+
+static void stdio_postfork ()
+{
+	funlockfile (stderr);
+	funlockfile (stdout);
+}
+
+void thrlab_setup (int *argc, char ***argv)
+{
+	assert (argc);
+	assert (*argc > 0);
+	assert (argv);
+	assert (*argv);
+
+	int status;
+
+	struct arguments arguments = argparse (argc, argv);
+
+	/* NOTE: this is the worst possible way to get good random numbers!
+	 * Never do this at home! Use arc4random where supported instead.
+	 */
+	srandom (arguments.seed);
+
+	/* barber processes reach the shop through memory mapped before they're
+	 * forked, at the same address in each */
+	if (arguments.barber_loop == THRLAB_BARBERS_PROCESS)
+	{
+		status = shared_open (shared_size (&arguments));
+		if (status != 0) goto error_shared;
+
+		/* every process writes to the same stdout; whole lines at a time
+		 * keep one's from landing in the middle of another's */
+		setvbuf (stdout, NULL, _IOLBF, 0);
+	}
+
+	/* the live counts are padded out to lines of their own */
+	thrlab = shop_alloc (sizeof (*thrlab));
+	if (thrlab == NULL) goto error_thrlab;
+
+	thrlab->visitors = arguments.customers;
+	thrlab->barbers = arguments.shops * arguments.barbers;
+	thrlab->chairs = arguments.chairs;
+	thrlab->num_shops = arguments.shops;
+	thrlab->shop_barbers = arguments.barbers;
+	thrlab->route = arguments.route;
+	thrlab->rate = arguments.rate;
+	thrlab->dispatch = arguments.dispatch;
+	thrlab->queue = arguments.queue;
+	thrlab->policy = arguments.policy;
+	thrlab->aging = arguments.aging;
+	thrlab->barber_loop = arguments.barber_loop;
+	thrlab->loops = arguments.loops;
+	thrlab->min_barbers = arguments.min_barbers
+		? arguments.min_barbers
+		: thrlab->barbers;
+	thrlab->sync = arguments.sync;
+	thrlab->record_only = arguments.record_only;
+	thrlab->virtual_time = arguments.virtual_time;
+	thrlab->seed = arguments.seed;
+	thrlab->report = arguments.report;
+	thrlab->arrivals = arguments.arrivals;
+	thrlab->hair_length = arguments.hair_length;
+	thrlab->hair_goal = arguments.hair_goal;
+	thrlab->replaying = arguments.replay != NULL;
+
+	if (arguments.open_day)
+	{
+		struct sigaction sa = { .sa_handler = close_shop };
+
+		sigemptyset (&sa.sa_mask);
+		sigaction (SIGINT, &sa, NULL);
+		sigaction (SIGTERM, &sa, NULL);
+	}
+
+	/* the shop's shared state is allocated, and its threads started, from
+	 * here on; pinning now keeps both on the barbers' nodes */
+	thrlab->pin = arguments.pin;
+	thrlab->pin_order = arguments.pin_order;
+
+	if (thrlab->pin && pin_shop () != 0)
+	{
+		fprintf (stderr, "thrlab: can't place threads, not pinning\n");
+		thrlab->pin = 0;
+	}
+
+	thrlab->locks = NULL;
+
+	if (arguments.lock_profile)
+	{
+		size_t count = num_lock_profiles (thrlab->num_shops);
+
+		thrlab->locks = shop_alloc (count * sizeof (*thrlab->locks));
+		if (thrlab->locks == NULL) goto error_locks;
+
+		for (size_t i = 0; i < count; ++i)
+			lockprof_init (&thrlab->locks[i]);
+	}
+
+	thrlab->num_cutting = 0;
+	thrlab->num_waiting = 0;
+	thrlab->num_pending = 0;
+
+	thrlab->shards = shop_alloc (COUNTER_SHARDS * sizeof (*thrlab->shards));
+	if (thrlab->shards == NULL) goto error_shards;
+
+	for (size_t i = 0; i < COUNTER_SHARDS; ++i)
+	{
+		for (size_t j = 0; j < NUM_COMPLAINTS; ++j)
+			atomic_init (&thrlab->shards[i].complaints[j], 0);
+	}
+
+	atomic_init (&thrlab->next_shard, 0);
+
+	thrlab->shops = shop_alloc (thrlab->num_shops * sizeof (*thrlab->shops));
+	if (thrlab->shops == NULL) goto error_shops;
+
+	for (size_t i = 0; i < thrlab->num_shops; ++i)
+	{
+		atomic_init (&thrlab->shops[i].load, 0);
+		atomic_init (&thrlab->shops[i].waiting, 0);
+		atomic_init (&thrlab->shops[i].peak_load, 0);
+		atomic_init (&thrlab->shops[i].arrived, 0);
+		atomic_init (&thrlab->shops[i].rejected, 0);
+		atomic_init (&thrlab->shops[i].served, 0);
+	}
+
+	thrlab->num_slots = arguments.slots;
+	thrlab->customer_count = 0;
+	thrlab->reaped = 0;
+	thrlab->peak_in_shop = 0;
+	thrlab->stalls = 0;
+
+	thrlab->slots = shop_alloc (thrlab->num_slots * sizeof (*thrlab->slots));
+	if (thrlab->slots == NULL) goto error_slots;
+
+	thrlab->free_slots = malloc (thrlab->num_slots * sizeof (*thrlab->free_slots));
+	if (thrlab->free_slots == NULL) goto error_free_slots;
+
+	/* lowest slots on top, so a quiet shop stays in a few cache lines */
+	for (size_t i = 0; i < thrlab->num_slots; ++i)
+	{
+		thrlab->slots[i].generation = 0;
+		thrlab->free_slots[i] = thrlab->num_slots - 1 - i;
+
+		status = fiber_sem_init (&thrlab->slots[i].served, shared_enabled (), 0);
+		assert (status == 0);
+	}
+
+	thrlab->num_free = thrlab->num_slots;
+	status = ring_init (&thrlab->done, thrlab->num_slots, shared_enabled ());
+	if (status != 0) goto error_done;
+
+	for (size_t i = 0; i < NUM_LATENCIES; ++i)
+		hist_init (&thrlab->latency[i]);
+
+	thrlab->occupancy = shop_alloc (thrlab->barbers * sizeof (*thrlab->occupancy));
+	if (thrlab->occupancy == NULL) goto error_occupancy;
+
+	for (size_t i = 0; i < thrlab->barbers; ++i)
+		atomic_init (&thrlab->occupancy[i], NULL);
+
+	thrlab->duty_since = shop_alloc (thrlab->barbers * sizeof (*thrlab->duty_since));
+	if (thrlab->duty_since == NULL) goto error_duty;
+
+	for (size_t i = 0; i < thrlab->barbers; ++i)
+		atomic_init (&thrlab->duty_since[i], UINT64_MAX);
+
+	atomic_init (&thrlab->duty_ns, 0);
+	atomic_init (&thrlab->on_duty, 0);
+	atomic_init (&thrlab->peak_on_duty, 0);
+
+	status = slab_init
+		( &thrlab->dispatch_slab
+		, sizeof (struct my_ud)
+		, thrlab->num_slots
+		);
+	if (status != 0) goto error_dispatch_slab;
+
+	pthread_mutexattr_t mattr;
+
+	pthread_mutexattr_init (&mattr);
+	pthread_mutexattr_setpshared
+		( &mattr
+		, shared_enabled () ? PTHREAD_PROCESS_SHARED : PTHREAD_PROCESS_PRIVATE
+		);
+
+	status = pthread_mutex_init (&thrlab->mtx, &mattr);
+	pthread_mutexattr_destroy (&mattr);
+	if (status != 0) goto error_mtx;
+
+	thrlab->barber_pids = NULL;
+	thrlab->worker_pids = NULL;
+	thrlab->num_workers = 0;
+
+	if (thrlab->barber_loop == THRLAB_BARBERS_PROCESS)
+	{
+		thrlab->barber_pids = calloc (thrlab->barbers, sizeof (*thrlab->barber_pids));
+		if (thrlab->barber_pids == NULL) goto error_pids;
+
+		/* the pool's workers are forked on the first arrival instead */
+		thrlab->worker_pids = calloc (arguments.workers, sizeof (*thrlab->worker_pids));
+		if (thrlab->worker_pids == NULL) goto error_worker_pids;
+
+		thrlab->num_workers = arguments.workers;
+		status = ring_init (&thrlab->door, thrlab->num_slots, true);
+		if (status != 0) goto error_door;
+
+		/* forks come after the shop's threads have started */
+		pthread_atfork (stdio_prefork, stdio_postfork, stdio_postfork);
+	}
+
+	if (thrlab->dispatch == DISPATCH_POOL && thrlab->worker_pids == NULL)
+	{
+		status = pool_init (&thrlab->pool, arguments.workers, thrlab->num_slots);
+		if (status != 0) goto error_workers;
+	}
+	else if (thrlab->dispatch == DISPATCH_FIBER)
+	{
+		status = fiber_sched_init
+			( &thrlab->fibers
+			, arguments.workers
+			, arguments.fiber_stack
+			);
+		if (status != 0) goto error_workers;
+	}
+
+	status = log_init (arguments.log);
+	if (status != 0) goto error_log;
+
+	status = clock_gettime (CLOCK_MONOTONIC, &thrlab->start);
+	assert (status == 0);
+
+	if (thrlab->virtual_time)
+	{
+		status = vclock_init ();
+		if (status != 0) goto error_vclock;
+	}
+
+	if (arguments.trace)
+	{
+		status = trace_open
+			( arguments.trace
+			, arguments.trace_size
+			, thrlab->start
+			, thrlab_now
+			, thrlab->barbers
+			, thrlab->chairs
+			, thrlab->rate
+			, thrlab->record_only ? TRACE_RECORD_ONLY : 0
+			);
+		if (status != 0) goto error_trace;
+	}
+
+	if (thrlab->replaying)
+	{
+		status = replay_open (&thrlab->replay, arguments.replay);
+		if (status != 0) goto error_replay;
+	}
+
+	if (arguments.stats)
+	{
+		status = open_stats (arguments.stats);
+		if (status != 0) goto error_stats;
+	}
+
+	printf
+		( "%s%s"
+		, "POSIX Barbershop open! All welcome!\n"
+		, "===================================\n"
+		);
+
+	return;
+
+error_stats:
+	if (thrlab->replaying)
+		replay_close (&thrlab->replay);
+
+error_replay:
+	trace_close ();
+
+error_trace:
+	if (thrlab->virtual_time)
+		vclock_shutdown ();
+
+error_vclock:
+	log_shutdown ();
+
+error_log:
+	if (thrlab->dispatch == DISPATCH_POOL && thrlab->worker_pids == NULL)
+		pool_destroy (&thrlab->pool);
+	else if (thrlab->dispatch == DISPATCH_FIBER)
+		fiber_sched_destroy (&thrlab->fibers);
+
+error_workers:
+	if (thrlab->worker_pids)
+		ring_deinit (&thrlab->door);
+
+error_door:
+	free (thrlab->worker_pids);
+
+error_worker_pids:
+	free (thrlab->barber_pids);
+
+error_pids:
+	pthread_mutex_destroy (&thrlab->mtx);
+
+error_mtx:
+	slab_destroy (&thrlab->dispatch_slab);
+
+error_dispatch_slab:
+	shop_free (thrlab->duty_since);
+
+error_duty:
+	shop_free (thrlab->occupancy);
+
+error_occupancy:
+	ring_deinit (&thrlab->done);
+
+error_done:
+	free (thrlab->free_slots);
+
+error_free_slots:
+	shop_free (thrlab->slots);
+
+error_slots:
+	shop_free (thrlab->shops);
+
+error_shops:
+	shop_free (thrlab->shards);
+
+error_shards:
+	shop_free (thrlab->locks);
+
+error_locks:
+	if (thrlab->pin)
+		topo_free (&thrlab->topo);
+
+	shop_free (thrlab);
+
+error_thrlab:
+	shared_close ();
+
+error_shared:
+	exit (EXIT_FAILURE);
+}
+
+void thrlab_cleanup ()
+{
+	assert (thrlab);
+
+	PROBE (cleanup, UINT64_MAX, TRACE_NO_ROOM, thrlab_elapsed_ns ());
+
+	size_t workers = 0;
+	size_t submitted = 0;
+	size_t max_depth = 0;
+	size_t abandoned = 0;
+	size_t processes = 0;
+
+	/* before the workers are joined, some of whom may never be let go */
+	if (thrlab->barber_pids)
+		abandoned = await_barbers ();
 
-	if (thrlab->complaint_reject_done)
+	if (thrlab->worker_pids)
 	{
-		printf
-			( "  - %zu %s told to come come back to be shown the door,"
-			  " after having gotten their haircut!\n"
-			, thrlab->complaint_reject_done
-			, (thrlab->complaint_reject_done > 1) ? "were" : "was"
-			);
+		workers = thrlab->num_workers;
 	}
-
-	if (thrlab->complaint_reject_again)
+	else if (thrlab->dispatch == DISPATCH_POOL)
 	{
-		printf
-			( "  - %zu %s shown the door, repeatedly!\n"
-			, thrlab->complaint_reject_again
-			, (thrlab->complaint_reject_again > 1) ? "were" : "was"
-			);
-	}
+		workers = thrlab->pool.num_workers;
+		submitted = thrlab->pool.submitted;
+		max_depth = thrlab->pool.max_depth;
 
-	if (thrlab->complaint_accept_full)
-	{
-		printf
-			( "  - %zu couldn't find a chair and had to wait in the hallway!\n"
-			, thrlab->complaint_accept_full
-			);
+		if (abandoned == 0)
+			pool_destroy (&thrlab->pool);
 	}
-
-	if (thrlab->complaint_accept_wait)
+	else if (thrlab->dispatch == DISPATCH_FIBER)
 	{
-		printf
-			( "  - %zu %s told to come inside and wait, whilst already"
-			  " waiting!\n"
-			, thrlab->complaint_accept_wait
-			, (thrlab->complaint_accept_wait > 1) ? "were" : "was"
-			);
-	}
+		workers = thrlab->fibers.num_carriers;
 
-	if (thrlab->complaint_accept_cut)
-	{
-		printf
-			( "  - %zu %s told to come inside and wait, whilst their"
-			  " barber was alredy cutting their hair!\n"
-			, thrlab->complaint_accept_cut
-			, (thrlab->complaint_accept_cut > 1) ? "were" : "was"
-			);
+		fiber_sched_destroy (&thrlab->fibers);
 	}
 
-	if (thrlab->complaint_accept_done)
-	{
-		printf
-			( "  - %zu %s told to come inside and wait, already having"
-			  " received their haircuts!\n"
-			, thrlab->complaint_accept_done
-			, (thrlab->complaint_accept_done > 1) ? "were" : "was"
-			);
-	}
+	/* wait for everyone still in the shop to leave */
+	while (abandoned == 0 && thrlab->reaped < thrlab->customer_count)
+		reap_visitor (ring_remove (&thrlab->done));
 
-	if (thrlab->complaint_accept_reject)
+	if (thrlab->barber_pids)
 	{
-		printf
-			( "  - %zu %s told to come inside and wait, after having been"
-			  " rejected earlier!\n"
-			, thrlab->complaint_accept_reject
-			, (thrlab->complaint_accept_reject > 1) ? "were" : "was"
-			);
+		processes = stop_barbers ();
+		stop_workers ();
 	}
 
-	if (thrlab->complaint_prepare_pending)
-	{
-		printf
-			( "  - %zu had to have their haircut outside!\n"
-			, thrlab->complaint_prepare_pending
-			);
-	}
+	/* whoever's still working is done for the day, and the last page
+	 * says so */
+	for (size_t i = 0; i < thrlab->barbers; ++i)
+		thrlab_barber_off_duty (i);
 
-	if (thrlab->complaint_prepare_busy)
-	{
-		printf
-			( "  - %zu %s told their barber was ready, but it turned out they"
-			  " were otherwise occupied!\n"
-			, thrlab->complaint_prepare_busy
-			, (thrlab->complaint_prepare_busy > 1) ? "were" : "was"
-			);
-	}
+	/* last figures in, before the slots go */
+	stats_close ();
+	log_shutdown ();
+	trace_close ();
 
-	if (thrlab->complaint_prepare_again)
-	{
-		printf
-			( "  - %zu %s told \"their\" barber was ready, but a barber was"
-			  " already cutting their hairs!\n"
-			, thrlab->complaint_prepare_again
-			, (thrlab->complaint_prepare_again > 1) ? "were" : "was"
-			);
-	}
+	if (thrlab->replaying)
+		replay_close (&thrlab->replay);
 
-	if (thrlab->complaint_prepare_done)
-	{
-		printf
-			( "  - %zu %s told their barber was ready, but had already just"
-			  " gotten their haircuts!\n"
-			, thrlab->complaint_prepare_done
-			, (thrlab->complaint_prepare_done > 1) ? "were" : "was"
-			);
-	}
+	if (thrlab->virtual_time)
+		vclock_shutdown ();
 
-	if (thrlab->complaint_prepare_reject)
-	{
-		printf
-			( "  - %zu %s told their barber was ready, after having previously"
-			  " been rejected!\n"
-			, thrlab->complaint_prepare_reject
-			, (thrlab->complaint_prepare_reject > 1) ? "were" : "was"
-			);
-	}
+	/* the abandoned are still waiting on theirs, and the process ends
+	 * with them in it */
+	for (size_t i = 0; abandoned == 0 && i < thrlab->num_slots; ++i)
+		fiber_sem_destroy (&thrlab->slots[i].served);
 
-	if (thrlab->complaint_prepare_self)
-	{
-		printf
-			( "  - %zu had to cut their own hair!\n"
-			, thrlab->complaint_prepare_self
-			);
-	}
+	ring_deinit (&thrlab->done);
+	free (thrlab->free_slots);
 
-	if (thrlab->complaint_dismiss_pending)
-	{
-		printf
-			( "  - %zu %s told they had already received their haircuts when"
-			  " they even hadn't entered the building yet!\n"
-			, thrlab->complaint_dismiss_pending
-			, (thrlab->complaint_dismiss_pending > 1) ? "were" : "was"
-			);
-	}
+	if (thrlab->worker_pids)
+		ring_deinit (&thrlab->door);
 
-	if (thrlab->complaint_dismiss_wait)
-	{
-		printf
-			( "  - %zu %s told they had already received their haircuts whilst"
-			  " waiting in the waiting room!\n"
-			, thrlab->complaint_dismiss_wait
-			, (thrlab->complaint_dismiss_wait > 1) ? "were" : "was"
-			);
-	}
+	int status = pthread_mutex_destroy (&thrlab->mtx);
+	if (status != 0) goto error_mtx;
 
-	if (thrlab->complaint_dismiss_done)
-	{
-		printf
-			( "  - %zu %s asked to leave the barber's room, repeatedly!\n"
-			, thrlab->complaint_dismiss_done
-			, (thrlab->complaint_dismiss_done > 1) ? "were" : "was"
-			);
-	}
+	printf
+		( "%s%s"
+		, "============================\n"
+		, "POSIX Barbershop closed! Good bye!\n"
+		);
 
-	if (thrlab->complaint_dismiss_reject)
+	if (thrlab->dispatch == DISPATCH_POOL && thrlab->worker_pids == NULL)
 	{
 		printf
-			( "  - %zu %s told that they had already received their haircuts,"
-			  " but were previously rejected entry!\n"
-			, thrlab->complaint_dismiss_reject
-			, (thrlab->complaint_dismiss_reject > 1) ? "were" : "was"
+			( "\n%zu customer worker%s served %zu customer%s, peak queue depth %zu.\n"
+			, workers
+			, (workers > 1) ? "s" : ""
+			, submitted
+			, (submitted != 1) ? "s" : ""
+			, max_depth
 			);
 	}
-
-	if (thrlab->complaint_dismiss_room)
+	else if (thrlab->dispatch == DISPATCH_FIBER)
 	{
 		printf
-			( "  - A barber saw a false positive customer on %zu occasion%s!\n"
-			, thrlab->complaint_dismiss_room
-			, (thrlab->complaint_dismiss_room > 1) ? "s" : ""
+			( "\n%zu carrier%s ran %zu fibers, at most %zu at once on %zu stacks.\n"
+			, workers
+			, (workers > 1) ? "s" : ""
+			, thrlab->fibers.spawned
+			, thrlab->fibers.peak
+			, thrlab->fibers.stacks
 			);
 	}
 
-	if (thrlab->complaint_dismiss_self)
+	if (processes > 0)
 	{
 		printf
-			( "  - %zu had to show themselves to the door!\n"
-			, thrlab->complaint_dismiss_self
+			( "\n%zu barber%s and %zu customer worker%s ran as processes,"
+			  " sharing %zu KiB.\n"
+			, processes
+			, (processes > 1) ? "s" : ""
+			, workers
+			, (workers > 1) ? "s" : ""
+			, shared_used () / 1024
 			);
 	}
 
-	if (thrlab->complaint_dismiss_early)
+	if (abandoned > 0)
 	{
 		printf
-			( "  - %zu lost their %s while undergoing a haircut!\n"
-			, thrlab->complaint_dismiss_early
-			, (thrlab->complaint_dismiss_early > 1) ? "lives" : "life"
+			( "%zu customer%s left behind by processes that died on the job.\n"
+			, abandoned
+			, (abandoned > 1) ? "s were" : " was"
 			);
 	}
 
-	if (thrlab->complaint_cut_fast)
-	{
-		printf
-			( "  - %zu %s cut way too fast! You better call Saul, neither you"
-			  " nor the public are ready to witness this.\n"
-			, thrlab->complaint_cut_fast
-			, (thrlab->complaint_cut_fast > 1) ? "were" : "was"
-			);
-	}
+	print_shifts ();
+	print_shops ();
+	print_pinning ();
+	print_latencies ();
+	print_locks ();
+	print_slabs ();
+	check_complaints ();
 
-	if (thrlab->complaint_cut_slow)
-	{
-		printf
-			( "  - %zu hair was cut too slowly! (This will happen with many threads and is fine)\n"
-			, thrlab->complaint_cut_slow
-			);
-	}
+	if (thrlab->report)
+		write_report (thrlab->report);
+
+	if (abandoned == 0)
+		slab_destroy (&thrlab->dispatch_slab);
+
+	if (thrlab->pin)
+		topo_free (&thrlab->topo);
+
+	free (thrlab->barber_pids);
+	free (thrlab->worker_pids);
+	shop_free (thrlab->duty_since);
+	shop_free (thrlab->occupancy);
+	shop_free (thrlab->slots);
+	shop_free (thrlab->shops);
+	shop_free (thrlab->shards);
+	shop_free (thrlab->locks);
+	shop_free (thrlab);
+	thrlab = NULL;
+
+	/* last, once nothing in it is needed */
+	shared_close ();
+
+	return;
+
+error_mtx:
+	exit (EXIT_FAILURE);
 }
 
 /******************************************************************************
- * Initialization & Cleanup
+ * Barbershop Information
  *****************************************************************************/
 
-void thrlab_setup (int *argc, char ***argv)
+unsigned int thrlab_get_num_barbers ()
 {
-	assert (argc);
-	assert (*argc > 0);
-	assert (argv);
-	assert (*argv);
+	assert (thrlab);
 
-	int status;
+	return thrlab->barbers;
+}
 
-	struct arguments arguments = argparse (argc, argv);
+unsigned int thrlab_get_num_chairs ()
+{
+	assert (thrlab);
 
-	/* NOTE: this is the worst possible way to get good random numbers!
-	 * Never do this at home! Use arc4random where supported instead.
-	 */
-	srandom (time (NULL));
+	return thrlab->chairs;
+}
 
-	thrlab = malloc (sizeof (*thrlab));
-	if (thrlab == NULL) goto error_thrlab;
+enum thrlab_queue thrlab_get_queue ()
+{
+	assert (thrlab);
 
-	thrlab->visitors = arguments.customers;
-	thrlab->barbers = arguments.barbers;
-	thrlab->chairs = arguments.chairs;
-	thrlab->rate = arguments.rate;
+	return thrlab->queue;
+}
 
-	thrlab->num_cutting = 0;
-	thrlab->num_waiting = 0;
-	thrlab->num_pending = 0;
+unsigned int thrlab_get_min_barbers ()
+{
+	assert (thrlab);
 
-	thrlab->complaint_reject_avail = 0;
-	thrlab->complaint_reject_wait = 0;
-	thrlab->complaint_reject_cut = 0;
-	thrlab->complaint_reject_done = 0;
-	thrlab->complaint_reject_again = 0;
-	thrlab->complaint_accept_full = 0;
-	thrlab->complaint_accept_wait = 0;
-	thrlab->complaint_accept_cut = 0;
-	thrlab->complaint_accept_done = 0;
-	thrlab->complaint_accept_reject = 0;
-	thrlab->complaint_prepare_pending = 0;
-	thrlab->complaint_prepare_busy = 0;
-	thrlab->complaint_prepare_again = 0;
-	thrlab->complaint_prepare_done = 0;
-	thrlab->complaint_prepare_reject = 0;
-	thrlab->complaint_prepare_self = 0;
-	thrlab->complaint_dismiss_pending = 0;
-	thrlab->complaint_dismiss_wait = 0;
-	thrlab->complaint_dismiss_done = 0;
-	thrlab->complaint_dismiss_reject = 0;
-	thrlab->complaint_dismiss_room = 0;
-	thrlab->complaint_dismiss_self = 0;
-	thrlab->complaint_dismiss_early = 0;
-	thrlab->complaint_cut_fast = 0;
-	thrlab->complaint_cut_slow = 0;
+	return thrlab->min_barbers;
+}
 
-	thrlab->customer_count = 0;
-	thrlab->customers = malloc (thrlab->visitors * sizeof (*thrlab->customers));
-	if (thrlab->customers == NULL) goto error_customers;
+void thrlab_barber_on_duty (unsigned int room)
+{
+	assert (thrlab);
+	assert (room < thrlab->barbers);
 
-	thrlab->statuses = malloc (thrlab->visitors * sizeof (*thrlab->statuses));
-	if (thrlab->statuses == NULL) goto error_statuses;
+	uint64_t off = UINT64_MAX;
 
-	thrlab->times = malloc (thrlab->visitors * sizeof (*thrlab->times));
-	if (thrlab->times == NULL) goto error_times;
+	if (!atomic_compare_exchange_strong
+		( &thrlab->duty_since[room]
+		, &off
+		, thrlab_elapsed_ns ()
+		))
+		return;
 
-	thrlab->occupancy = malloc
-		( thrlab->barbers * sizeof (*thrlab->occupancy)
-		);
-	if (thrlab->occupancy == NULL) goto error_occupancy;
+	size_t on_duty = atomic_fetch_add (&thrlab->on_duty, 1) + 1;
+	size_t peak = atomic_load (&thrlab->peak_on_duty);
 
-	for (size_t i = 0; i < thrlab->barbers; ++i)
-		thrlab->occupancy[i] = NULL;
+	while (on_duty > peak
+		&& !atomic_compare_exchange_weak (&thrlab->peak_on_duty, &peak, on_duty))
+		;
+}
 
-	status = pthread_mutex_init (&thrlab->mtx, NULL);
-	if (status != 0) goto error_mtx;
+void thrlab_barber_off_duty (unsigned int room)
+{
+	assert (thrlab);
+	assert (room < thrlab->barbers);
 
-	status = clock_gettime (CLOCK_MONOTONIC, &thrlab->start);
-	assert (status == 0);
+	uint64_t since = atomic_exchange (&thrlab->duty_since[room], UINT64_MAX);
 
-	printf
-		( "%s%s"
-		, "POSIX Barbershop open! All welcome!\n"
-		, "===================================\n"
-		);
+	if (since == UINT64_MAX)
+		return;
 
-	return;
+	atomic_fetch_add (&thrlab->duty_ns, thrlab_elapsed_ns () - since);
+	atomic_fetch_sub (&thrlab->on_duty, 1);
+}
 
-error_mtx:
-	free (thrlab->statuses);
+struct lockprof *thrlab_get_lock_profile
+	( enum thrlab_lock_site site
+	, unsigned int shop
+	)
+{
+	assert (thrlab);
+	assert (shop < thrlab->num_shops);
 
-error_occupancy:
-	free (thrlab->times);
+	if (thrlab->locks == NULL)
+		return NULL;
+
+	return &thrlab->locks[((site == THRLAB_LOCK_SEAT) ? LOCK_SEAT : LOCK_PICKUP) + 2 * shop];
+}
+
+void thrlab_pin_barber (unsigned int room)
+{
+	assert (thrlab);
+	assert (room < thrlab->barbers);
 
-error_times:
-	free (thrlab->statuses);
+	if (!thrlab->pin)
+		return;
 
-error_statuses:
-	free (thrlab->customers);
+	cpu_set_t set;
 
-error_customers:
-	free (thrlab);
+	CPU_ZERO (&set);
+	CPU_SET (topo_pick (&thrlab->topo, thrlab->pin_order, room)->cpu, &set);
 
-error_thrlab:
-	exit (EXIT_FAILURE);
+	int status = pthread_setaffinity_np (pthread_self (), sizeof (set), &set);
+
+	if (status != 0)
+		fprintf (stderr, "thrlab: can't pin barber %u: %s\n", room, strerror (status));
 }
 
-void thrlab_cleanup ()
+/**
+ * Fork a process to work in the shop with --barber-loop=process; returns as
+ * fork does. The child leaves closing time to the harness, and goes with it.
+ */
+static pid_t fork_child ()
+{
+	pid_t parent = getpid ();
+	pid_t pid = fork ();
+
+	if (pid != 0)
+		return pid;
+
+	signal (SIGINT, SIG_IGN);
+	signal (SIGTERM, SIG_IGN);
+	prctl (PR_SET_PDEATHSIG, SIGKILL);
+
+	if (getppid () != parent)
+		_exit (EXIT_FAILURE);
+
+	log_forked ();
+	trace_forked ();
+
+	/* the forking thread's shard would be shared by every child */
+	complaint_shard = UINT_MAX;
+
+	return 0;
+}
+
+void thrlab_fork_barber (unsigned int room, void *(*work) (void *), void *arg)
 {
 	assert (thrlab);
+	assert (thrlab->barber_pids);
+	assert (room < thrlab->barbers);
+	assert (work);
 
-	for (size_t i = 0; i < thrlab->customer_count; ++i)
+	pid_t pid = fork_child ();
+
+	if (pid == -1)
 	{
-		assert (thrlab->customers[i]);
+		perror ("thrlab: can't fork a barber");
+		exit (EXIT_FAILURE);
+	}
 
-		int status = pthread_join (thrlab->customers[i]->thread, NULL);
-		assert (status == 0);
+	if (pid > 0)
+	{
+		thrlab->barber_pids[room] = pid;
+		return;
+	}
+
+	barber_process = 1;
+
+	work (arg);
+	_exit (EXIT_SUCCESS);
+}
+
+void *thrlab_shared_alloc (size_t size)
+{
+	assert (thrlab);
 
-//		pthread_detach(thrlab->customers[i]->thread);
-		
-		free (thrlab->customers[i]);
+	if (!shared_enabled ())
+		return calloc (1, size);
+
+	void *p = shared_alloc (size);
+
+	if (p == NULL)
+	{
+		fprintf (stderr, "thrlab: out of shared memory\n");
+		exit (EXIT_FAILURE);
 	}
 
-	free (thrlab->customers);
-	free (thrlab->statuses);
-	free (thrlab->times);
-	free (thrlab->occupancy);
+	return p;
+}
 
-	int status = pthread_mutex_destroy (&thrlab->mtx);
-	if (status != 0) goto error_mtx;
+uint64_t thrlab_customer_rank (struct customer *customer)
+{
+	assert (thrlab);
+	assert (customer);
 
-	printf
-		( "%s%s"
-		, "============================\n"
-		, "POSIX Barbershop closed! Good bye!\n"
-		);
+	struct visitor *visitor = visitor_of (customer);
+	uint64_t work = customer_cutting_time (customer);
 
-	check_complaints ();
+	switch (thrlab->policy)
+	{
+		case POLICY_FIFO:
+			return customer->id;
+		case POLICY_SJF:
+			return work;
+		case POLICY_AGING:
+			/* everyone waiting ages at the same rate, so ranking on
+			 * work - aging * (now - arrived) is ranking on this */
+			return work + thrlab->aging * atomic_load (&visitor->times.arrived);
+	}
 
-	free (thrlab);
-	thrlab = NULL;
+	return customer->id;
+}
 
-	return;
+enum thrlab_barbers thrlab_get_barber_loop ()
+{
+	assert (thrlab);
 
-error_mtx:
-	exit (EXIT_FAILURE);
+	return thrlab->barber_loop;
 }
 
-/******************************************************************************
- * Barbershop Information
- *****************************************************************************/
+unsigned int thrlab_get_num_shops ()
+{
+	assert (thrlab);
 
-unsigned int thrlab_get_num_barbers ()
+	return thrlab->num_shops;
+}
+
+unsigned int thrlab_get_room_shop (unsigned int room)
 {
 	assert (thrlab);
+	assert (room < thrlab->barbers);
 
-	return thrlab->barbers;
+	return room / thrlab->shop_barbers;
 }
 
-unsigned int thrlab_get_num_chairs ()
+unsigned int thrlab_get_num_loops ()
 {
 	assert (thrlab);
 
-	return thrlab->chairs;
+	return thrlab->loops;
 }
 
 /******************************************************************************
  * Helper Functions
  *****************************************************************************/
 
-void thrlab_sleep (int ms)
+void thrlab_sleep (int ms)
+{
+	assert (thrlab);
+	assert (ms >= 0);
+
+	PROBE_MS (sleep_begin, UINT64_MAX, TRACE_NO_ROOM, thrlab_elapsed_ns (), ms);
+	thrlab_sleep_ns ((uint64_t) ms * 1000000);
+	PROBE_MS (sleep_end, UINT64_MAX, TRACE_NO_ROOM, thrlab_elapsed_ns (), ms);
+}
+
+/******************************************************************************
+ * Customer Management
+ *****************************************************************************/
+
+/**
+ * See `customer` through `callback`, then hand their slot back for reaping.
+ */
+static void serve_customer
+	( void (*callback) (struct customer *, void *)
+	, struct customer *customer
+	, void *ud
+	)
+{
+	callback (customer, ud);
+
+	struct visitor *visitor = visitor_of (customer);
+
+	trace_event (TRACE_LEAVE, customer->id, TRACE_NO_ROOM, TRACE_OK);
+
+	if (!thrlab->record_only)
+	{
+		sync_lock (LOCK_LEAVE);
+
+		if (atomic_load (&visitor->status) == CUSTOMER_CUTTING)
+			complain (COMPLAINT_DISMISS_EARLY);
+
+		sync_unlock (LOCK_LEAVE);
+	}
+
+	atomic_fetch_sub (&thrlab->shops[customer->shop].load, 1);
+
+	/* hand the slot to the arrival thread for reaping */
+	ring_insert (&thrlab->done, visitor_handle (visitor));
+}
+
+static void *my_callback (void *ud)
+{
+	assert (ud);
+
+	struct my_ud m = *(struct my_ud *) ud;
+
+	slab_free (&thrlab->dispatch_slab, ud);
+
+	serve_customer (m.callback, m.customer, m.ud);
+
+	return NULL;
+}
+
+/**
+ * Pick the shop the front door sends the next customer to, by --route. Load
+ * is who's been sent to a shop and hasn't left yet, waiting or not.
+ */
+static unsigned int route_customer ()
 {
-	assert (thrlab);
-	assert (ms >= 0);
+	size_t n = thrlab->num_shops;
 
-	struct timespec ts = (struct timespec)
-		{ .tv_sec = ms / 1000
-		, .tv_nsec = ms % 1000 * 1000000
-		};
+	if (n == 1)
+		return 0;
 
-	while (ts.tv_sec > 0 || ts.tv_nsec > 0)
+	switch (thrlab->route)
 	{
-		int status = nanosleep (&ts, &ts);
+		case ROUTE_P2C:;
+			unsigned int a = my_arc4random_uniform (n);
+			unsigned int b = my_arc4random_uniform (n - 1);
+
+			if (b >= a)
+				++b;
+
+			return atomic_load (&thrlab->shops[b].load) < atomic_load (&thrlab->shops[a].load)
+				? b
+				: a;
+		case ROUTE_JSQ:;
+			/* start somewhere random, so ties don't all go to shop 0 */
+			unsigned int start = my_arc4random_uniform (n);
+			unsigned int best = start;
+			size_t least = atomic_load (&thrlab->shops[start].load);
+
+			for (size_t i = 1; i < n; ++i)
+			{
+				unsigned int shop = (start + i) % n;
+				size_t load = atomic_load (&thrlab->shops[shop].load);
 
-		if (status == -1)
-		{
-			assert (errno == EINTR);
-			continue;
-		}
+				if (load < least)
+				{
+					best = shop;
+					least = load;
+				}
+			}
 
-		break;
+			return best;
+		case ROUTE_RANDOM:
+			return my_arc4random_uniform (n);
 	}
-}
-
-/******************************************************************************
- * Customer Management
- *****************************************************************************/
 
-struct my_ud
-{
-	void (*callback) (struct customer *, void *);
-	struct customer *customer;
-	void *ud;
-};
+	return 0;
+}
 
-static void *my_callback (void *ud)
+/**
+ * Pool workers and fiber carriers are reused, so the customer's thread is only
+ * known once one picks it up. A fiber may move to another carrier after it
+ * parks; the thread recorded is the one it started on.
+ */
+static void *my_pooled_callback (void *ud)
 {
 	assert (ud);
 
-	int status;
-	struct my_ud m = *(struct my_ud *) ud;
+	struct my_ud *m = ud;
 
-	free (ud);
+	m->customer->thread = pthread_self ();
 
-	m.callback (m.customer, m.ud);
+	return my_callback (ud);
+}
 
-	status = pthread_mutex_lock (&thrlab->mtx);
-	assert (status == 0);
+/**
+ * A customer worker forked with --barber-loop=process: see whoever comes in
+ * through the door, one at a time, until sent home. Every worker runs on a
+ * thread of the same name, so the customer's process is what tells them apart.
+ */
+static void customer_worker ()
+{
+	while (true)
+	{
+		struct customer *customer = ring_remove (&thrlab->door);
 
-	assert (m.customer->id < thrlab->visitors);
+		visitor_of (customer)->pid = getpid ();
+		customer->thread = pthread_self ();
 
-	if (thrlab->statuses[m.customer->id] == CUSTOMER_CUTTING)
-		++thrlab->complaint_dismiss_early;
+		serve_customer (worker_callback, customer, worker_ud);
+	}
+}
 
-	status = pthread_mutex_unlock (&thrlab->mtx);
-	assert (status == 0);
+/**
+ * Fork the customer workers that stand in for the pool with
+ * --barber-loop=process, each seeing customers through `callback`.
+ */
+static void fork_workers
+	( void (*callback) (struct customer *, void *)
+	, void *ud
+	)
+{
+	worker_callback = callback;
+	worker_ud = ud;
 
-	return NULL;
+	for (size_t i = 0; i < thrlab->num_workers; ++i)
+	{
+		pid_t pid = fork_child ();
+
+		if (pid == -1)
+		{
+			perror ("thrlab: can't fork a customer worker");
+			exit (EXIT_FAILURE);
+		}
+
+		if (pid == 0)
+		{
+			customer_worker ();
+			_exit (EXIT_SUCCESS);
+		}
+
+		thrlab->worker_pids[i] = pid;
+	}
 }
 
 void thrlab_wait_for_customers
@@ -1062,55 +3154,132 @@ void thrlab_wait_for_customers
 
 	int status;
 	struct customer *customer;
+	size_t name;
 
-	for (size_t i = 0; i < thrlab->visitors; ++i)
+	if (thrlab->worker_pids)
+		fork_workers (callback, ud);
+
+	for (size_t i = 0; i < thrlab->visitors && !closing; ++i)
 	{
-		sleep_until_customer ();
+		struct replay_arrival arrival;
 
-		customer = malloc (sizeof (struct customer));
-		if (customer == NULL) goto error_customer;
+		if (thrlab->replaying)
+		{
+			status = replay_next (&thrlab->replay, &arrival);
 
-		customer->name = random_name ();
-		customer->id = 0;
-		customer->hair_length = my_arc4random_uniform (100) + 100;
-		customer->hair_goal = my_arc4random_uniform (25) + 50;
+			/* the day ends with the file; a line we can't read ends the
+			 * run, rather than pass off a short day as a whole one */
+			if (status == 0)
+				break;
+			if (status == -1)
+				exit (EXIT_FAILURE);
 
-		status = pthread_mutex_lock (&thrlab->mtx);
-		assert (status == 0);
+			sleep_until_offset (arrival.offset * 1000000);
+		}
+		else
+		{
+			sleep_until_customer ();
+		}
+
+		/* may wait for someone to leave; they might need the mutex to */
+		customer = &claim_visitor ()->customer;
+
+		name = random_name ();
+		customer->name = customer_names[name];
+
+		if (thrlab->replaying)
+		{
+			customer->hair_length = clamp_hair (arrival.hair_length, 1, HAIR_MAX);
+			customer->hair_goal = clamp_hair
+				( arrival.hair_goal
+				, 0
+				, customer->hair_length - 1
+				);
+		}
+		else
+		{
+			customer->hair_length = random_hair (&thrlab->hair_length, 1, HAIR_MAX);
+			customer->hair_goal = random_hair
+				( &thrlab->hair_goal
+				, 0
+				, customer->hair_length - 1
+				);
+		}
+
+		customer->shop = route_customer ();
+
+		struct shop *shop = &thrlab->shops[customer->shop];
+		size_t load = atomic_fetch_add (&shop->load, 1) + 1;
+
+		atomic_fetch_add (&shop->arrived, 1);
 
-		customer->id = add_customer (customer, CUSTOMER_PENDING);
+		if (load > atomic_load (&shop->peak_load))
+			atomic_store (&shop->peak_load, load);
+
+		shop_lock (LOCK_ARRIVAL);
 
 		time_printf
-			( "%s (#%u) arrives at the door.\n"
+			( "%s (#%" PRIu64 ") arrives at the door.\n"
 			, customer->name
 			, customer->id
 			);
+		trace_arrive (customer->id, name, customer_cutting_time (customer) / 1000000);
+		PROBE (arrive, customer->id, TRACE_NO_ROOM, thrlab_elapsed_ns ());
+
+		if (thrlab->worker_pids)
+		{
+			if (!thrlab->record_only) ++thrlab->num_pending;
+
+			shop_unlock (LOCK_ARRIVAL);
 
-		struct my_ud *m = malloc (sizeof (struct my_ud));
+			ring_insert (&thrlab->door, customer);
+
+			continue;
+		}
+
+		struct my_ud *m = slab_alloc (&thrlab->dispatch_slab);
 		if (m == NULL) exit (EXIT_FAILURE);
 
 		m->callback = callback;
 		m->customer = customer;
 		m->ud = ud;
 
+		if (thrlab->dispatch == DISPATCH_POOL)
+		{
+			if (!thrlab->record_only) ++thrlab->num_pending;
+
+			shop_unlock (LOCK_ARRIVAL);
+
+			pool_submit (&thrlab->pool, my_pooled_callback, m);
+
+			continue;
+		}
+
+		if (thrlab->dispatch == DISPATCH_FIBER)
+		{
+			status = fiber_spawn (&thrlab->fibers, my_pooled_callback, m);
+			if (status != 0) goto error_thread;
+
+			if (!thrlab->record_only) ++thrlab->num_pending;
+
+			shop_unlock (LOCK_ARRIVAL);
+
+			continue;
+		}
+
 		status = pthread_create (&customer->thread, NULL, my_callback, m);
 		if (status != 0) goto error_thread;
 
-		++thrlab->num_pending;
+		if (!thrlab->record_only) ++thrlab->num_pending;
 
-		status = pthread_mutex_unlock (&thrlab->mtx);
-		assert (status == 0);
+		shop_unlock (LOCK_ARRIVAL);
 	}
 
 	return;
 
 error_thread:
-	status = pthread_mutex_unlock (&thrlab->mtx);
-	assert (status == 0);
+	shop_unlock (LOCK_ARRIVAL);
 
-	free (customer);
-
-error_customer:
 	exit (EXIT_FAILURE);
 }
 
@@ -1118,299 +3287,517 @@ void thrlab_accept_customer (struct customer *customer)
 {
 	assert (thrlab);
 	assert (customer);
-	assert (customer->id < thrlab->visitors);
+	struct visitor *visitor = visitor_of (customer);
+	_Atomic enum customer_status *cstatus = &visitor->status;
 
-	int status;
+	PROBE (accept, customer->id, TRACE_NO_ROOM, thrlab_elapsed_ns ());
 
-	status = pthread_mutex_lock (&thrlab->mtx);
-	assert (status == 0);
+	if (thrlab->record_only)
+	{
+		trace_event (TRACE_ACCEPT, customer->id, TRACE_NO_ROOM, TRACE_OK);
+		return;
+	}
+
+	sync_lock (LOCK_ACCEPT);
+
+	enum customer_status current = atomic_load (cstatus);
 
-	if (thrlab->statuses[customer->id] == CUSTOMER_PENDING)
+	while (current == CUSTOMER_PENDING
+		&& !atomic_compare_exchange_weak (cstatus, &current, CUSTOMER_WAITING))
+		;
+
+	if (current == CUSTOMER_PENDING)
 	{
-		time_printf ("%s (#%u) waits.\n", customer->name, customer->id);
+		atomic_store (&visitor->times.accepted, thrlab_elapsed_ns ());
+
+		time_printf ("%s (#%" PRIu64 ") waits.\n", customer->name, customer->id);
 	}
 	else
 	{
-		time_printf ("%s (#%u) is confused!\n", customer->name, customer->id);
+		time_printf ("%s (#%" PRIu64 ") is confused!\n", customer->name, customer->id);
 	}
 
-	switch (thrlab->statuses[customer->id])
+	trace_event
+		( TRACE_ACCEPT
+		, customer->id
+		, TRACE_NO_ROOM
+		, (current == CUSTOMER_PENDING) ? TRACE_OK : TRACE_CONFUSED
+		);
+
+	switch (current)
 	{
 		case CUSTOMER_PENDING:
-			if (thrlab->chairs <= thrlab->num_waiting)
-				++thrlab->complaint_accept_full;
+			if (live_count (atomic_fetch_add (&thrlab->shops[customer->shop].waiting, 1))
+				>= (ptrdiff_t) thrlab->chairs)
+				complain (COMPLAINT_ACCEPT_FULL);
 
-			thrlab->statuses[customer->id] = CUSTOMER_WAITING;
 			++thrlab->num_waiting;
+
 			--thrlab->num_pending;
 
 			break;
 		case CUSTOMER_WAITING:
-			++thrlab->complaint_accept_wait;
+			complain (COMPLAINT_ACCEPT_WAIT);
 			break;
 		case CUSTOMER_CUTTING:
-			++thrlab->complaint_accept_cut;
+			complain (COMPLAINT_ACCEPT_CUT);
 			break;
 		case CUSTOMER_DONE:
-			++thrlab->complaint_accept_done;
+			complain (COMPLAINT_ACCEPT_DONE);
 			break;
 		case CUSTOMER_REJECTED:
-			++thrlab->complaint_accept_reject;
+			complain (COMPLAINT_ACCEPT_REJECT);
 			break;
 	}
 
-	status = pthread_mutex_unlock (&thrlab->mtx);
-	assert (status == 0);
+	sync_unlock (LOCK_ACCEPT);
 }
 
 void thrlab_reject_customer (struct customer *customer)
 {
 	assert (thrlab);
 	assert (customer);
-	assert (customer->id < thrlab->visitors);
+	struct visitor *visitor = visitor_of (customer);
+	_Atomic enum customer_status *cstatus = &visitor->status;
 
-	int status;
+	PROBE (reject, customer->id, TRACE_NO_ROOM, thrlab_elapsed_ns ());
 
-	status = pthread_mutex_lock (&thrlab->mtx);
-	assert (status == 0);
+	if (thrlab->record_only)
+	{
+		trace_event (TRACE_REJECT, customer->id, TRACE_NO_ROOM, TRACE_OK);
+		return;
+	}
+
+	sync_lock (LOCK_REJECT);
 
-	if (thrlab->statuses[customer->id] == CUSTOMER_PENDING)
+	enum customer_status current = atomic_load (cstatus);
+
+	while (current == CUSTOMER_PENDING
+		&& !atomic_compare_exchange_weak (cstatus, &current, CUSTOMER_REJECTED))
+		;
+
+	if (current == CUSTOMER_PENDING)
 	{
 		time_printf
-			( "%s (#%u) was turned away!\n"
+			( "%s (#%" PRIu64 ") was turned away!\n"
 			, customer->name
 			, customer->id
 			);
 	}
 	else
 	{
-		time_printf ("%s (#%u) is confused!\n", customer->name, customer->id);
+		time_printf ("%s (#%" PRIu64 ") is confused!\n", customer->name, customer->id);
 	}
 
+	trace_event
+		( TRACE_REJECT
+		, customer->id
+		, TRACE_NO_ROOM
+		, (current == CUSTOMER_PENDING) ? TRACE_OK : TRACE_CONFUSED
+		);
 
-	switch (thrlab->statuses[customer->id])
+	switch (current)
 	{
 		case CUSTOMER_PENDING:
-			if (thrlab->chairs > thrlab->num_waiting)
-				++thrlab->complaint_reject_avail;
+			if ((ptrdiff_t) thrlab->chairs > live_count (thrlab->shops[customer->shop].waiting))
+				complain (COMPLAINT_REJECT_AVAIL);
+
+			++thrlab->shops[customer->shop].rejected;
 
-			thrlab->statuses[customer->id] = CUSTOMER_REJECTED;
 			--thrlab->num_pending;
 
 			break;
 		case CUSTOMER_WAITING:
-			++thrlab->complaint_reject_wait;
+			complain (COMPLAINT_REJECT_WAIT);
 			break;
 		case CUSTOMER_CUTTING:
-			++thrlab->complaint_reject_cut;
+			complain (COMPLAINT_REJECT_CUT);
 			break;
 		case CUSTOMER_DONE:
-			++thrlab->complaint_reject_done;
+			complain (COMPLAINT_REJECT_DONE);
 			break;
 		case CUSTOMER_REJECTED:
-			++thrlab->complaint_reject_again;
+			complain (COMPLAINT_REJECT_AGAIN);
 			break;
 	}
 
-	status = pthread_mutex_unlock (&thrlab->mtx);
-	assert (status == 0);
+	sync_unlock (LOCK_REJECT);
 }
 
-void thrlab_prepare_customer (struct customer *customer, unsigned int room)
+/**
+ * Whether the calling thread is the customer's own. A barber process shares
+ * no threads with the customers, whatever `pthread_self` says there.
+ */
+static bool on_customer_thread (struct customer *customer)
 {
-	assert (thrlab);
-	assert (customer);
-	assert (customer->id < thrlab->visitors);
-	assert (room < thrlab->barbers);
+	if (thrlab->worker_pids)
+		return !barber_process && visitor_of (customer)->pid == getpid ();
 
-	int status;
+	return !barber_process && pthread_equal (pthread_self (), customer->thread);
+}
 
-	status = pthread_mutex_lock (&thrlab->mtx);
-	assert (status == 0);
+/**
+ * Record a barber's transition without checking it, for --record-only.
+ * Whether the customer's own thread made it is all that can't be worked out
+ * from the trace afterwards.
+ */
+static void record_transition
+	( enum trace_type type
+	, struct customer *customer
+	, unsigned int room
+	)
+{
+	trace_event
+		( type
+		, customer->id
+		, room
+		, on_customer_thread (customer) ? TRACE_SELF : TRACE_OK
+		);
+}
+
+/**
+ * The checks and transition behind `thrlab_prepare_customer`; the caller holds
+ * the sync lock.
+ */
+/**
+ * Tell of `customer` being prepared in a `room` someone else has taken.
+ */
+static void prepare_busy (struct customer *customer, unsigned int room)
+{
+	time_printf
+		( "%s'%s (#%" PRIu64 ") confused! %s is busy cutting someone else!\n"
+		, customer->name
+		, (customer->name[strlen (customer->name) - 1] == 's') ? "" : "s"
+		, customer->id
+		, barber_name (room)
+		);
+	trace_event (TRACE_PREPARE, customer->id, room, TRACE_BUSY);
+
+	complain (COMPLAINT_PREPARE_BUSY);
+}
+
+static void prepare_locked (struct customer *customer, unsigned int room)
+{
+	struct visitor *visitor = visitor_of (customer);
+	_Atomic enum customer_status *cstatus = &visitor->status;
+
+	PROBE (prepare, customer->id, room, thrlab_elapsed_ns ());
 
-	if (thrlab->occupancy[room] && thrlab->occupancy[room] != customer)
+	if (room / thrlab->shop_barbers != customer->shop)
 	{
 		time_printf
-			( "%s'%s (#%u) confused! %s is busy cutting someone else!\n"
+			( "%s'%s (#%" PRIu64 ") confused! %s works in another shop!\n"
 			, customer->name
 			, (customer->name[strlen (customer->name) - 1] == 's') ? "" : "s"
 			, customer->id
-			, barber_names[room]
+			, barber_name (room)
 			);
+		trace_event (TRACE_PREPARE, customer->id, room, TRACE_SHOP);
 
-		++thrlab->complaint_prepare_busy;
+		complain (COMPLAINT_PREPARE_SHOP);
 
-		goto done;
+		return;
+	}
+
+	struct customer *occupant = atomic_load (&thrlab->occupancy[room]);
+
+	if (occupant && occupant != customer)
+	{
+		prepare_busy (customer, room);
+		return;
+	}
+
+	enum customer_status current = atomic_load (cstatus);
+	struct customer *vacant = NULL;
+
+	/* claim the room first, then the customer, and only then tell of it;
+	 * if someone else moves the customer along first, `current` is
+	 * whatever they left them doing */
+	if (current == CUSTOMER_WAITING)
+	{
+		if (!atomic_compare_exchange_strong (&thrlab->occupancy[room], &vacant, customer))
+		{
+			prepare_busy (customer, room);
+			return;
+		}
+
+		uint64_t prepared = thrlab_elapsed_ns ();
+
+		if (atomic_compare_exchange_strong (cstatus, &current, CUSTOMER_CUTTING))
+		{
+			atomic_store (&visitor->times.prepared, prepared);
+			++thrlab->num_cutting;
+			--thrlab->num_waiting;
+			--thrlab->shops[customer->shop].waiting;
+		}
+		else
+			atomic_store (&thrlab->occupancy[room], NULL);
 	}
-	else if (thrlab->statuses[customer->id] == CUSTOMER_WAITING)
+
+	if (current == CUSTOMER_WAITING)
 	{
-		if (pthread_equal (pthread_self (), customer->thread) == 0)
+		if (!on_customer_thread (customer))
 		{
 			time_printf
-				( "%s begins giving %s (#%u) a haircut in room %u\n"
-				, barber_names[room]
+				( "%s begins giving %s (#%" PRIu64 ") a haircut in room %u\n"
+				, barber_name (room)
 				, customer->name
 				, customer->id
 				, room
 				);
+			trace_event (TRACE_PREPARE, customer->id, room, TRACE_OK);
 		}
 		else
 		{
 			time_printf
-				( "%s orders %s (#%u) to cut their own hair!\n"
-				, barber_names[room]
+				( "%s orders %s (#%" PRIu64 ") to cut their own hair!\n"
+				, barber_name (room)
 				, customer->name
 				, customer->id
 				);
+			trace_event (TRACE_PREPARE, customer->id, room, TRACE_SELF);
 
-			++thrlab->complaint_prepare_self;
+			complain (COMPLAINT_PREPARE_SELF);
 		}
 	}
 	else
 	{
 		time_printf
-			( "%s and %s (#%u) are confused!\n"
-			, barber_names[room]
+			( "%s and %s (#%" PRIu64 ") are confused!\n"
+			, barber_name (room)
 			, customer->name
 			, customer->id
 			);
+		trace_event (TRACE_PREPARE, customer->id, room, TRACE_CONFUSED);
 	}
 
-	switch (thrlab->statuses[customer->id])
+	switch (current)
 	{
 		case CUSTOMER_PENDING:
-			++thrlab->complaint_prepare_pending;
+			complain (COMPLAINT_PREPARE_PENDING);
 			break;
 		case CUSTOMER_WAITING:
-			if (thrlab->occupancy[room])
-			{
-				++thrlab->complaint_prepare_busy;
-			}
-			else
-			{
-				thrlab->occupancy[room] = customer;
-				thrlab->statuses[customer->id] = CUSTOMER_CUTTING;
-				++thrlab->num_cutting;
-				--thrlab->num_waiting;
-
-				status = clock_gettime
-					( CLOCK_MONOTONIC
-					, &thrlab->times[customer->id]
-					);
-				assert (status == 0);
-			}
+			/* prepared above */
 			break;
 		case CUSTOMER_CUTTING:
-			++thrlab->complaint_prepare_again;
+			complain (COMPLAINT_PREPARE_AGAIN);
 			break;
 		case CUSTOMER_DONE:
-			++thrlab->complaint_prepare_done;
+			complain (COMPLAINT_PREPARE_DONE);
 			break;
 		case CUSTOMER_REJECTED:
-			++thrlab->complaint_prepare_reject;
+			complain (COMPLAINT_PREPARE_REJECT);
 			break;
 	}
-
-done:
-	status = pthread_mutex_unlock (&thrlab->mtx);
-	assert (status == 0);
 }
 
-void thrlab_dismiss_customer (struct customer *customer, unsigned int room)
+/**
+ * The checks and transition behind `thrlab_dismiss_customer`; the caller holds
+ * the sync lock.
+ */
+static void dismiss_locked (struct customer *customer, unsigned int room)
 {
-	assert (thrlab);
-	assert (customer);
-	assert (customer->id < thrlab->visitors);
-	assert (room < thrlab->barbers);
+	struct visitor *visitor = visitor_of (customer);
+	_Atomic enum customer_status *cstatus = &visitor->status;
 
-	int status;
+	PROBE (dismiss, customer->id, room, thrlab_elapsed_ns ());
 
-	status = pthread_mutex_lock (&thrlab->mtx);
-	assert (status == 0);
+	if (room / thrlab->shop_barbers != customer->shop)
+	{
+		time_printf
+			( "%s'%s confused! %s (#%" PRIu64 ") waited in another shop!\n"
+			, barber_name (room)
+			, (barber_name (room)[strlen (barber_name (room)) - 1] == 's') ? "" : "s"
+			, customer->name
+			, customer->id
+			);
+		trace_event (TRACE_DISMISS, customer->id, room, TRACE_SHOP);
+
+		complain (COMPLAINT_DISMISS_SHOP);
+
+		return;
+	}
 
-	if (thrlab->occupancy[room] != customer)
+	if (atomic_load (&thrlab->occupancy[room]) != customer)
 	{
 		time_printf
-			( "%s'%s confused! %s (#%u) wasn't found in their room!\n"
-			, barber_names[room]
-			, (barber_names[room][strlen (barber_names[room]) - 1] == 's') ? "" : "s"
+			( "%s'%s confused! %s (#%" PRIu64 ") wasn't found in their room!\n"
+			, barber_name (room)
+			, (barber_name (room)[strlen (barber_name (room)) - 1] == 's') ? "" : "s"
 			, customer->name
 			, customer->id
 			);
+		trace_event (TRACE_DISMISS, customer->id, room, TRACE_ROOM);
 
-		++thrlab->complaint_dismiss_room;
+		complain (COMPLAINT_DISMISS_ROOM);
 
-		goto done;
+		return;
 	}
-	else if (thrlab->statuses[customer->id] == CUSTOMER_CUTTING)
+
+	enum customer_status current = atomic_load (cstatus);
+	uint64_t dismissed = thrlab_elapsed_ns ();
+
+	/* let the customer go before telling of it; if someone else moves
+	 * them along first, `current` is whatever they left them doing */
+	if (current == CUSTOMER_CUTTING)
+		atomic_compare_exchange_strong (cstatus, &current, CUSTOMER_DONE);
+
+	if (current == CUSTOMER_CUTTING)
 	{
-		if (pthread_equal (pthread_self (), customer->thread) == 0)
+		if (!on_customer_thread (customer))
 		{
 			time_printf
-				( "%s finishes cutting %s'%s (#%u) hair.\n"
-				, barber_names[room]
+				( "%s finishes cutting %s'%s (#%" PRIu64 ") hair.\n"
+				, barber_name (room)
 				, customer->name
 				, (customer->name[strlen (customer->name) - 1] == 's') ? "" : "s"
 				, customer->id
 				);
+			trace_event (TRACE_DISMISS, customer->id, room, TRACE_OK);
 		}
 		else
 		{
 			time_printf
-				( "%s orders %s (#%u) to show themselves to the door after"
+				( "%s orders %s (#%" PRIu64 ") to show themselves to the door after"
 				  " their haircut!\n"
-				, barber_names[room]
+				, barber_name (room)
 				, customer->name
 				, customer->id
 				);
+			trace_event (TRACE_DISMISS, customer->id, room, TRACE_SELF);
 
-			++thrlab->complaint_dismiss_self;
+			complain (COMPLAINT_DISMISS_SELF);
 		}
 	}
 	else
 	{
 		time_printf
-			( "%s and %s (#%u) are confused!\n"
-			, barber_names[room]
+			( "%s and %s (#%" PRIu64 ") are confused!\n"
+			, barber_name (room)
 			, customer->name
 			, customer->id
 			);
+		trace_event (TRACE_DISMISS, customer->id, room, TRACE_CONFUSED);
 	}
 
-	switch (thrlab->statuses[customer->id])
+	switch (current)
 	{
 		case CUSTOMER_PENDING:
-			++thrlab->complaint_dismiss_pending;
+			complain (COMPLAINT_DISMISS_PENDING);
 			break;
 		case CUSTOMER_WAITING:
-			++thrlab->complaint_dismiss_wait;
+			complain (COMPLAINT_DISMISS_WAIT);
 			break;
 		case CUSTOMER_CUTTING:;
-			struct timespec current;
-			status = clock_gettime (CLOCK_MONOTONIC, &current);
+			struct visit *visit = &visitor->times;
+			uint64_t prepared = atomic_load (&visit->prepared);
+
+			hist_record
+				( &thrlab->latency[LATENCY_WAIT]
+				, prepared - atomic_load (&visit->accepted)
+				);
+			hist_record (&thrlab->latency[LATENCY_SERVICE], dismissed - prepared);
+			hist_record
+				( &thrlab->latency[LATENCY_TURNAROUND]
+				, dismissed - atomic_load (&visit->arrived)
+				);
 
-			double t = customer_cutting_time (customer);
-			double dt = timespec_diff (current, thrlab->times[customer->id]);
+			int64_t t = customer_cutting_time (customer);
+			int64_t dt = dismissed - prepared;
 
 			if (dt < t)
-				++thrlab->complaint_cut_fast;
+				complain (COMPLAINT_CUT_FAST);
 
 			if (dt >= 2*t)
-				++thrlab->complaint_cut_slow;
+				complain (COMPLAINT_CUT_SLOW);
 
-			thrlab->occupancy[room] = NULL;
-			thrlab->statuses[customer->id] = CUSTOMER_DONE;
+			atomic_store (&thrlab->occupancy[room], NULL);
 			--thrlab->num_cutting;
+			++thrlab->shops[customer->shop].served;
 			break;
 		case CUSTOMER_DONE:
-			++thrlab->complaint_dismiss_done;
+			complain (COMPLAINT_DISMISS_DONE);
 			break;
 		case CUSTOMER_REJECTED:
-			++thrlab->complaint_dismiss_reject;
+			complain (COMPLAINT_DISMISS_REJECT);
 			break;
 	}
+}
 
-done:
-	status = pthread_mutex_unlock (&thrlab->mtx);
-	assert (status == 0);
+void thrlab_prepare_customer (struct customer *customer, unsigned int room)
+{
+	assert (thrlab);
+	assert (customer);
+	assert (room < thrlab->barbers);
+
+	if (thrlab->record_only)
+	{
+		PROBE (prepare, customer->id, room, thrlab_elapsed_ns ());
+		record_transition (TRACE_PREPARE, customer, room);
+		return;
+	}
+
+	sync_lock (LOCK_PREPARE);
+	prepare_locked (customer, room);
+	sync_unlock (LOCK_PREPARE);
+}
+
+void thrlab_dismiss_customer (struct customer *customer, unsigned int room)
+{
+	assert (thrlab);
+	assert (customer);
+	assert (room < thrlab->barbers);
+
+	if (thrlab->record_only)
+	{
+		PROBE (dismiss, customer->id, room, thrlab_elapsed_ns ());
+		record_transition (TRACE_DISMISS, customer, room);
+		return;
+	}
+
+	sync_lock (LOCK_DISMISS);
+	dismiss_locked (customer, room);
+	sync_unlock (LOCK_DISMISS);
+}
+
+void thrlab_dismiss_and_prepare
+	( struct customer *old
+	, struct customer *new
+	, unsigned int room
+	)
+{
+	assert (thrlab);
+	assert (old);
+	assert (new);
+	assert (room < thrlab->barbers);
+
+	if (thrlab->record_only)
+	{
+		PROBE (dismiss, old->id, room, thrlab_elapsed_ns ());
+		record_transition (TRACE_DISMISS, old, room);
+		PROBE (prepare, new->id, room, thrlab_elapsed_ns ());
+		record_transition (TRACE_PREPARE, new, room);
+		return;
+	}
+
+	sync_lock (LOCK_HANDOFF);
+	dismiss_locked (old, room);
+	prepare_locked (new, room);
+	sync_unlock (LOCK_HANDOFF);
+}
+
+void thrlab_customer_wait (struct customer *customer)
+{
+	assert (thrlab);
+	assert (customer);
+
+	fiber_sem_wait (&visitor_of (customer)->served);
+}
+
+void thrlab_customer_post (struct customer *customer)
+{
+	assert (thrlab);
+	assert (customer);
+
+	fiber_sem_post (&visitor_of (customer)->served);
 }
@@ -3,6 +3,7 @@
 
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdint.h>
 
 /******************************************************************************
  * Initialization & Cleanup
@@ -27,15 +28,120 @@ void thrlab_cleanup ();
  *****************************************************************************/
 
 /**
- * Get the number of barbers on duty.
+ * Get the number of barbers on duty, in every shop together. Each has a room
+ * of their own, numbered from zero.
  */
 unsigned int thrlab_get_num_barbers ();
 
 /**
- * Get the number of waiting chairs in the building.
+ * Get the number of waiting chairs in each shop's waiting room.
  */
 unsigned int thrlab_get_num_chairs ();
 
+/**
+ * Get the number of shops behind the front door. Each has its own barbers
+ * and waiting room; customers arrive with their shop already picked.
+ */
+unsigned int thrlab_get_num_shops ();
+
+/**
+ * Get the shop that room `room`, and its barber, belongs to.
+ */
+unsigned int thrlab_get_room_shop (unsigned int room);
+
+/**
+ * Kinds of queue the waiting room can be built on.
+ */
+enum thrlab_queue
+{
+	THRLAB_QUEUE_SBUF, /* semaphore-guarded bounded buffer */
+	THRLAB_QUEUE_RING, /* lock-free multi-producer/multi-consumer ring */
+	THRLAB_QUEUE_HEAP /* priority queue, lowest `thrlab_customer_rank` first */
+};
+
+/**
+ * Get the kind of queue the waiting room should use.
+ */
+enum thrlab_queue thrlab_get_queue ();
+
+/**
+ * Ways the barbers can be run.
+ */
+enum thrlab_barbers
+{
+	THRLAB_BARBERS_THREAD, /* a thread per barber, sleeping through each cut */
+	THRLAB_BARBERS_EVENT, /* a few epoll loops, each driving several rooms */
+	THRLAB_BARBERS_PROCESS /* a process per barber, see `thrlab_fork_barber` */
+};
+
+/**
+ * Get how the barbers should be run.
+ */
+enum thrlab_barbers thrlab_get_barber_loop ();
+
+/**
+ * Get the number of event loop threads the rooms should be shared among, when
+ * the barbers are run on event loops.
+ */
+unsigned int thrlab_get_num_loops ();
+
+/**
+ * Get the fewest barbers that should be kept on duty. Barbers above this may
+ * be sent home while the shop is quiet; without --elastic it's every barber.
+ */
+unsigned int thrlab_get_min_barbers ();
+
+/**
+ * Clock the barber in room `room` on, or off, duty. Time on duty is what the
+ * shop pays for, whether or not anyone's in the chair.
+ */
+void thrlab_barber_on_duty (unsigned int room);
+void thrlab_barber_off_duty (unsigned int room);
+
+/**
+ * Ways into the waiting room's lock that --lock-profile tells apart.
+ */
+enum thrlab_lock_site
+{
+	THRLAB_LOCK_SEAT, /* a customer sitting down */
+	THRLAB_LOCK_PICKUP /* a barber calling the next one in */
+};
+
+struct lockprof;
+
+/**
+ * Get where to profile shop `shop`'s waiting room lock at `site`, for handing
+ * to its queue; NULL unless --lock-profile.
+ */
+struct lockprof *thrlab_get_lock_profile
+	( enum thrlab_lock_site site
+	, unsigned int shop
+	);
+
+/**
+ * Pin the calling thread to the CPU chosen for room `room` by --pin. Call it
+ * from the thread that serves the room; without --pin it does nothing.
+ */
+void thrlab_pin_barber (unsigned int room);
+
+/**
+ * Run `work (arg)` for the barber in room `room` in a process of their own,
+ * when the barbers are run as processes. Only memory from
+ * `thrlab_shared_alloc`, and the harness's own, is shared with the barber
+ * afterwards; everything else is the barber's copy as it was at the fork.
+ *
+ * The barber is stopped when the shop closes; one that dies before then is
+ * reported, along with any customer they were holding.
+ */
+void thrlab_fork_barber (unsigned int room, void *(*work) (void *), void *arg);
+
+/**
+ * Allocate `size` zeroed bytes that every barber can reach, whichever way
+ * they're run. Process-shared synchronization belongs in here when the
+ * barbers are run as processes. It's never freed but with the shop.
+ */
+void *thrlab_shared_alloc (size_t size);
+
 /******************************************************************************
  * Helper Functions
  *****************************************************************************/
@@ -60,8 +166,11 @@ struct customer
 	/* name of the customer */
 	const char *name;
 
-	/* a unique customer identifier */
-	unsigned int id;
+	/* a unique customer identifier, counting arrivals from zero */
+	uint64_t id;
+
+	/* the shop the front door sent the customer to */
+	unsigned int shop;
 
 	/* length of the customer's hair in millimetres */
 	unsigned int hair_length;
@@ -69,7 +178,8 @@ struct customer
 	/* desired hair length in millimetres */
 	unsigned int hair_goal;
 
-	/* A mutex that you are free to use */
+	/* A mutex that you are free to use. It blocks the carrier thread in
+	 * fiber dispatch mode; see `thrlab_customer_wait` instead. */
 	sem_t mutex;
 };
 
@@ -102,4 +212,35 @@ void thrlab_prepare_customer (struct customer *customer, unsigned int room);
  */
 void thrlab_dismiss_customer (struct customer *customer, unsigned int room);
 
+/**
+ * Dismiss `old` from room `room` and prepare `new` in it straight away, as one
+ * step. Does the same checks as `thrlab_dismiss_customer` followed by
+ * `thrlab_prepare_customer`, for a barber with someone already waiting.
+ */
+void thrlab_dismiss_and_prepare
+	( struct customer *old
+	, struct customer *new
+	, unsigned int room
+	);
+
+/**
+ * Where the customer goes in a `THRLAB_QUEUE_HEAP` waiting room under the
+ * selected policy: the lower, the sooner they should be served. Take it once
+ * the customer has been accepted.
+ */
+uint64_t thrlab_customer_rank (struct customer *customer);
+
+/**
+ * Block the customer until `thrlab_customer_post` is called for them, or
+ * return straight away if it already has been. In fiber dispatch mode this
+ * parks the customer's fiber and lets its carrier thread run someone else.
+ */
+void thrlab_customer_wait (struct customer *customer);
+
+/**
+ * Wake the customer from `thrlab_customer_wait`. The customer may leave as
+ * soon as this is called.
+ */
+void thrlab_customer_post (struct customer *customer);
+
 #endif
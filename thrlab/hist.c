@@ -0,0 +1,114 @@
+#include <assert.h>
+#include <math.h>
+#include "hist.h"
+
+#define HIST_EXACT (1 << HIST_SUB_BITS)
+#define HIST_HALF (1 << (HIST_SUB_BITS - 1))
+
+static size_t hist_index (uint64_t value)
+{
+	if (value < HIST_EXACT)
+		return value;
+
+	/* keep the top HIST_SUB_BITS bits; the leading one picks the half */
+	int shift = 63 - __builtin_clzll (value) - HIST_SUB_BITS + 1;
+	uint64_t sub = value >> shift;
+
+	return HIST_EXACT + (shift - 1) * HIST_HALF + (sub - HIST_HALF);
+}
+
+/**
+ * The largest value that falls in bucket `index`.
+ */
+static uint64_t hist_highest (size_t index)
+{
+	if (index < HIST_EXACT)
+		return index;
+
+	int shift = (index - HIST_EXACT) / HIST_HALF + 1;
+	uint64_t sub = (index - HIST_EXACT) % HIST_HALF + HIST_HALF;
+
+	return ((sub + 1) << shift) - 1;
+}
+
+void hist_init (struct hist *hist)
+{
+	assert (hist);
+
+	for (size_t i = 0; i < HIST_BUCKETS; ++i)
+		atomic_init (&hist->counts[i], 0);
+
+	atomic_init (&hist->total, 0);
+	atomic_init (&hist->max, 0);
+}
+
+void hist_record (struct hist *hist, uint64_t value)
+{
+	assert (hist);
+
+	atomic_fetch_add_explicit
+		( &hist->counts[hist_index (value)]
+		, 1
+		, memory_order_relaxed
+		);
+	atomic_fetch_add_explicit (&hist->total, 1, memory_order_relaxed);
+
+	uint64_t max = atomic_load_explicit (&hist->max, memory_order_relaxed);
+
+	while (value > max
+		&& !atomic_compare_exchange_weak_explicit
+			( &hist->max
+			, &max
+			, value
+			, memory_order_relaxed
+			, memory_order_relaxed
+			))
+		;
+}
+
+uint64_t hist_count (const struct hist *hist)
+{
+	assert (hist);
+
+	return atomic_load (&hist->total);
+}
+
+uint64_t hist_max (const struct hist *hist)
+{
+	assert (hist);
+
+	return atomic_load (&hist->max);
+}
+
+uint64_t hist_percentile (const struct hist *hist, double p)
+{
+	assert (hist);
+	assert (p >= 0 && p <= 100);
+
+	uint64_t total = hist_count (hist);
+
+	if (total == 0)
+		return 0;
+
+	/* nearest rank, counting from one */
+	uint64_t rank = ceil (p / 100.0 * total);
+	uint64_t seen = 0;
+
+	if (rank == 0)
+		rank = 1;
+
+	for (size_t i = 0; i < HIST_BUCKETS; ++i)
+	{
+		seen += atomic_load (&hist->counts[i]);
+
+		if (seen >= rank)
+		{
+			uint64_t highest = hist_highest (i);
+			uint64_t max = hist_max (hist);
+
+			return (highest < max) ? highest : max;
+		}
+	}
+
+	return hist_max (hist);
+}
@@ -0,0 +1,55 @@
+#ifndef _THRLAB_HIST_H_
+#define _THRLAB_HIST_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A log-linear (HDR-style) histogram of nanosecond latencies.
+ *
+ * Values below 2^HIST_SUB_BITS are counted exactly. Above that, every power
+ * of two is split into 2^(HIST_SUB_BITS - 1) equal buckets, so a reported
+ * value is within 1/64 of the true one however large it gets. Recording is
+ * lock-free and may happen from any thread.
+ */
+
+#define HIST_SUB_BITS 7
+#define HIST_BUCKETS \
+	((1 << HIST_SUB_BITS) + (64 - HIST_SUB_BITS) * (1 << (HIST_SUB_BITS - 1)))
+
+struct hist
+{
+	_Atomic uint64_t counts[HIST_BUCKETS];
+	_Atomic uint64_t total;
+	_Atomic uint64_t max;
+};
+
+/**
+ * Empty the histogram.
+ */
+void hist_init (struct hist *hist);
+
+/**
+ * Count one occurrence of `value`.
+ */
+void hist_record (struct hist *hist, uint64_t value);
+
+/**
+ * Number of values recorded.
+ */
+uint64_t hist_count (const struct hist *hist);
+
+/**
+ * The value at or below which `p` percent of the recorded values fall, as the
+ * top of its bucket; never more than the largest value recorded. Returns 0
+ * for an empty histogram.
+ */
+uint64_t hist_percentile (const struct hist *hist, double p);
+
+/**
+ * The largest value recorded, exactly.
+ */
+uint64_t hist_max (const struct hist *hist);
+
+#endif
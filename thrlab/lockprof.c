@@ -0,0 +1,141 @@
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include "lockprof.h"
+
+static uint64_t lockprof_now ()
+{
+	struct timespec ts;
+
+	int status = clock_gettime (CLOCK_MONOTONIC, &ts);
+	assert (status == 0);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Count a lock taken after asking at `asked`; the caller now holds it.
+ */
+static void lockprof_acquired (struct lockprof *prof, uint64_t asked, int contended)
+{
+	uint64_t now = lockprof_now ();
+
+	atomic_fetch_add_explicit (&prof->acquired, 1, memory_order_relaxed);
+
+	if (contended)
+		atomic_fetch_add_explicit (&prof->contended, 1, memory_order_relaxed);
+
+	hist_record (&prof->wait, now - asked);
+	prof->since = now;
+}
+
+static void lockprof_releasing (struct lockprof *prof)
+{
+	hist_record (&prof->hold, lockprof_now () - prof->since);
+}
+
+void lockprof_init (struct lockprof *prof)
+{
+	assert (prof);
+
+	atomic_init (&prof->acquired, 0);
+	atomic_init (&prof->contended, 0);
+	hist_init (&prof->wait);
+	hist_init (&prof->hold);
+	prof->since = 0;
+}
+
+void lockprof_mutex_lock (struct lockprof *prof, pthread_mutex_t *mtx)
+{
+	assert (mtx);
+
+	int status;
+
+	if (prof == NULL)
+	{
+		status = pthread_mutex_lock (mtx);
+		assert (status == 0);
+
+		return;
+	}
+
+	uint64_t asked = lockprof_now ();
+	int contended = 0;
+
+	status = pthread_mutex_trylock (mtx);
+
+	if (status == EBUSY)
+	{
+		contended = 1;
+
+		status = pthread_mutex_lock (mtx);
+	}
+
+	assert (status == 0);
+
+	lockprof_acquired (prof, asked, contended);
+}
+
+void lockprof_mutex_unlock (struct lockprof *prof, pthread_mutex_t *mtx)
+{
+	assert (mtx);
+
+	if (prof)
+		lockprof_releasing (prof);
+
+	int status = pthread_mutex_unlock (mtx);
+	assert (status == 0);
+}
+
+void lockprof_cond_wait (struct lockprof *prof, pthread_cond_t *cond, pthread_mutex_t *mtx)
+{
+	assert (cond);
+	assert (mtx);
+
+	if (prof)
+		lockprof_releasing (prof);
+
+	int status = pthread_cond_wait (cond, mtx);
+	assert (status == 0);
+
+	if (prof)
+		prof->since = lockprof_now ();
+}
+
+void lockprof_sem_wait (struct lockprof *prof, sem_t *sem)
+{
+	assert (sem);
+
+	if (prof == NULL)
+	{
+		while (sem_wait (sem) != 0)
+			assert (errno == EINTR);
+
+		return;
+	}
+
+	uint64_t asked = lockprof_now ();
+	int contended = 0;
+
+	if (sem_trywait (sem) != 0)
+	{
+		assert (errno == EAGAIN || errno == EINTR);
+		contended = 1;
+
+		while (sem_wait (sem) != 0)
+			assert (errno == EINTR);
+	}
+
+	lockprof_acquired (prof, asked, contended);
+}
+
+void lockprof_sem_post (struct lockprof *prof, sem_t *sem)
+{
+	assert (sem);
+
+	if (prof)
+		lockprof_releasing (prof);
+
+	int status = sem_post (sem);
+	assert (status == 0);
+}
@@ -0,0 +1,47 @@
+#ifndef _THRLAB_LOCKPROF_H_
+#define _THRLAB_LOCKPROF_H_
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include "hist.h"
+
+/**
+ * How one call site fares on a lock: how long it waits to get it, how long
+ * it keeps it, and how often someone else had it first. Times are wall clock
+ * nanoseconds, even in virtual time.
+ */
+struct lockprof
+{
+	_Atomic uint64_t acquired;
+	_Atomic uint64_t contended; /* acquisitions that had to wait */
+	struct hist wait; /* asking until holding */
+	struct hist hold; /* holding until letting go */
+
+	/* when the current holder got the lock; only touched under it */
+	uint64_t since;
+};
+
+void lockprof_init (struct lockprof *prof);
+
+/**
+ * Take or release `mtx`, counting against `prof`. With a NULL `prof` these
+ * are plain pthread_mutex_lock and pthread_mutex_unlock.
+ */
+void lockprof_mutex_lock (struct lockprof *prof, pthread_mutex_t *mtx);
+void lockprof_mutex_unlock (struct lockprof *prof, pthread_mutex_t *mtx);
+
+/**
+ * pthread_cond_wait on a mutex taken with lockprof_mutex_lock. Time parked
+ * isn't held; the hold ends at the wait and starts again on waking.
+ */
+void lockprof_cond_wait (struct lockprof *prof, pthread_cond_t *cond, pthread_mutex_t *mtx);
+
+/**
+ * The same for a semaphore used as a mutex.
+ */
+void lockprof_sem_wait (struct lockprof *prof, sem_t *sem);
+void lockprof_sem_post (struct lockprof *prof, sem_t *sem);
+
+#endif
@@ -0,0 +1,433 @@
+#define _DEFAULT_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "log.h"
+
+#define LOG_SLOTS 32
+#define LOG_LINE 256
+#define LOG_FLUSH_MS 10
+
+struct log_record
+{
+	double timestamp;
+	size_t buffer; /* tie-breakers when sorting a batch */
+	size_t seq;
+	char line[LOG_LINE];
+};
+
+/**
+ * A single-producer/single-consumer ring of formatted lines. The owning
+ * thread advances `head`, the flusher advances `tail`.
+ */
+struct log_buffer
+{
+	alignas (64) _Atomic size_t head;
+	_Atomic bool writing; /* the owner is between checking the mode and
+	                       * publishing its line */
+	alignas (64) _Atomic size_t tail;
+
+	/* set once the owning thread has exited; the buffer may be reused
+	 * after it has been drained */
+	_Atomic bool orphaned;
+
+	size_t id;
+	struct log_buffer *next;
+
+	struct log_record records[LOG_SLOTS];
+};
+
+static struct
+{
+	_Atomic enum log_mode mode;
+
+	/* every buffer ever handed out; only ever pushed to */
+	_Atomic (struct log_buffer *) buffers;
+	_Atomic size_t num_buffers;
+
+	pthread_key_t key;
+	pthread_t flusher;
+	pthread_mutex_t mtx;
+	pthread_cond_t wake; /* on the monotonic clock */
+	pthread_cond_t drained; /* the flusher has been round every buffer */
+	size_t waiters; /* writers waiting for room in a full buffer */
+	bool stopping;
+
+	/* in a forked child, which may leave without flushing stdout */
+	bool forked;
+
+	/* flusher's scratch space */
+	struct log_record *batch;
+	size_t batch_capacity;
+} logger =
+	{ .mode = LOG_SYNC
+	, .mtx = PTHREAD_MUTEX_INITIALIZER
+	};
+
+static __thread struct log_buffer *log_self = NULL;
+
+static void log_orphan (void *arg)
+{
+	struct log_buffer *buffer = arg;
+
+	atomic_store (&buffer->orphaned, true);
+}
+
+/**
+ * Find the calling thread's buffer, adopting a drained orphan or allocating
+ * a new one on first use.
+ */
+static struct log_buffer *log_buffer ()
+{
+	if (log_self)
+		return log_self;
+
+	struct log_buffer *buffer = atomic_load (&logger.buffers);
+
+	for (; buffer; buffer = buffer->next)
+	{
+		bool orphaned = true;
+
+		if (atomic_load (&buffer->head) != atomic_load (&buffer->tail))
+			continue;
+
+		if (atomic_compare_exchange_strong (&buffer->orphaned, &orphaned, false))
+			break;
+	}
+
+	if (buffer == NULL)
+	{
+		buffer = aligned_alloc (alignof (struct log_buffer), sizeof (*buffer));
+		if (buffer == NULL) exit (EXIT_FAILURE);
+
+		atomic_init (&buffer->head, 0);
+		atomic_init (&buffer->writing, false);
+		atomic_init (&buffer->tail, 0);
+		atomic_init (&buffer->orphaned, false);
+		buffer->id = atomic_fetch_add (&logger.num_buffers, 1);
+
+		buffer->next = atomic_load (&logger.buffers);
+		while (!atomic_compare_exchange_weak (&logger.buffers, &buffer->next, buffer))
+			;
+	}
+
+	pthread_setspecific (logger.key, buffer);
+	log_self = buffer;
+
+	return buffer;
+}
+
+/**
+ * Format a line stamped with `timestamp` into the LOG_LINE bytes at `line`.
+ * A line too long for it is cut short, but keeps its newline.
+ */
+static void log_format (char *line, double timestamp, const char *format, va_list ap)
+{
+	int len = snprintf (line, LOG_LINE, "%9.3f: ", timestamp);
+	int rest = vsnprintf (line + len, LOG_LINE - len, format, ap);
+
+	if (rest >= LOG_LINE - len)
+		line[LOG_LINE - 2] = '\n';
+}
+
+static int log_record_compare (const void *a, const void *b)
+{
+	const struct log_record *x = a;
+	const struct log_record *y = b;
+
+	if (x->timestamp != y->timestamp)
+		return (x->timestamp < y->timestamp) ? -1 : 1;
+
+	if (x->buffer != y->buffer)
+		return (x->buffer < y->buffer) ? -1 : 1;
+
+	return (x->seq < y->seq) ? -1 : (x->seq > y->seq);
+}
+
+/**
+ * Collect every published line, and print them in timestamp order.
+ */
+static void log_drain ()
+{
+	size_t count = 0;
+	struct log_buffer *buffer = atomic_load (&logger.buffers);
+
+	for (; buffer; buffer = buffer->next)
+	{
+		size_t tail = atomic_load_explicit (&buffer->tail, memory_order_relaxed);
+		size_t head = atomic_load_explicit (&buffer->head, memory_order_acquire);
+
+		if (count + (head - tail) > logger.batch_capacity)
+		{
+			logger.batch_capacity = 2 * (count + (head - tail));
+			logger.batch = realloc
+				( logger.batch
+				, logger.batch_capacity * sizeof (*logger.batch)
+				);
+			if (logger.batch == NULL) exit (EXIT_FAILURE);
+		}
+
+		for (; tail != head; ++tail)
+		{
+			logger.batch[count] = buffer->records[tail % LOG_SLOTS];
+			logger.batch[count].buffer = buffer->id;
+			logger.batch[count].seq = tail;
+			++count;
+		}
+
+		atomic_store_explicit (&buffer->tail, tail, memory_order_release);
+	}
+
+	if (count == 0)
+		return;
+
+	qsort (logger.batch, count, sizeof (*logger.batch), log_record_compare);
+
+	for (size_t i = 0; i < count; ++i)
+		fputs (logger.batch[i].line, stdout);
+
+	fflush (stdout);
+}
+
+static void *log_flusher (void *arg)
+{
+	(void) arg;
+
+	int status;
+
+	status = pthread_mutex_lock (&logger.mtx);
+	assert (status == 0);
+
+	while (!logger.stopping)
+	{
+		/* a writer waiting on a full buffer wants it drained now */
+		if (logger.waiters == 0)
+		{
+			struct timespec deadline;
+
+			status = clock_gettime (CLOCK_MONOTONIC, &deadline);
+			assert (status == 0);
+
+			deadline.tv_nsec += LOG_FLUSH_MS * 1000000;
+			deadline.tv_sec += deadline.tv_nsec / 1000000000;
+			deadline.tv_nsec %= 1000000000;
+
+			status = pthread_cond_timedwait (&logger.wake, &logger.mtx, &deadline);
+			assert (status == 0 || status == ETIMEDOUT);
+		}
+
+		status = pthread_mutex_unlock (&logger.mtx);
+		assert (status == 0);
+
+		log_drain ();
+
+		status = pthread_mutex_lock (&logger.mtx);
+		assert (status == 0);
+
+		status = pthread_cond_broadcast (&logger.drained);
+		assert (status == 0);
+	}
+
+	status = pthread_mutex_unlock (&logger.mtx);
+	assert (status == 0);
+
+	/* log_shutdown drains what's left once the last writer is done */
+	return NULL;
+}
+
+int log_init (enum log_mode mode)
+{
+	int status;
+
+	atomic_store (&logger.mode, mode);
+
+	if (mode != LOG_ASYNC)
+		return 0;
+
+	atomic_init (&logger.buffers, NULL);
+	atomic_init (&logger.num_buffers, 0);
+	logger.waiters = 0;
+	logger.stopping = false;
+	logger.batch = NULL;
+	logger.batch_capacity = 0;
+
+	pthread_condattr_t cattr;
+
+	pthread_condattr_init (&cattr);
+	pthread_condattr_setclock (&cattr, CLOCK_MONOTONIC);
+
+	status = pthread_cond_init (&logger.wake, &cattr);
+	pthread_condattr_destroy (&cattr);
+	if (status != 0) goto error_wake;
+
+	status = pthread_cond_init (&logger.drained, NULL);
+	if (status != 0) goto error_drained;
+
+	status = pthread_key_create (&logger.key, log_orphan);
+	if (status != 0) goto error_key;
+
+	status = pthread_create (&logger.flusher, NULL, log_flusher, NULL);
+	if (status != 0) goto error_flusher;
+
+	return 0;
+
+error_flusher:
+	pthread_key_delete (logger.key);
+
+error_key:
+	pthread_cond_destroy (&logger.drained);
+
+error_drained:
+	pthread_cond_destroy (&logger.wake);
+
+error_wake:
+	atomic_store (&logger.mode, LOG_SYNC);
+	return -1;
+}
+
+/**
+ * Wait for the flusher to make room in the calling thread's `buffer`, full
+ * at `head`. Returns false if logging stopped being asynchronous instead.
+ */
+static bool log_wait (struct log_buffer *buffer, size_t head)
+{
+	int status;
+	bool async;
+
+	status = pthread_mutex_lock (&logger.mtx);
+	assert (status == 0);
+
+	++logger.waiters;
+
+	while ((async = atomic_load (&logger.mode) == LOG_ASYNC)
+		&& head - atomic_load_explicit (&buffer->tail, memory_order_acquire)
+		   == LOG_SLOTS)
+	{
+		status = pthread_cond_signal (&logger.wake);
+		assert (status == 0);
+
+		status = pthread_cond_wait (&logger.drained, &logger.mtx);
+		assert (status == 0);
+	}
+
+	--logger.waiters;
+
+	status = pthread_mutex_unlock (&logger.mtx);
+	assert (status == 0);
+
+	return async;
+}
+
+int log_enabled ()
+{
+	return atomic_load_explicit (&logger.mode, memory_order_relaxed) != LOG_NONE;
+}
+
+void log_vprintf (double timestamp, const char *format, va_list ap)
+{
+	assert (format);
+
+	enum log_mode mode = atomic_load_explicit (&logger.mode, memory_order_relaxed);
+
+	if (mode == LOG_NONE)
+		return;
+
+	if (mode == LOG_ASYNC)
+	{
+		struct log_buffer *buffer = log_buffer ();
+		size_t head = atomic_load_explicit (&buffer->head, memory_order_relaxed);
+
+		/* either log_shutdown sees us writing and waits for the line, or
+		 * we see it has switched to synchronous mode */
+		atomic_store (&buffer->writing, true);
+
+		if (atomic_load (&logger.mode) != LOG_ASYNC
+			|| (head - atomic_load_explicit (&buffer->tail, memory_order_acquire)
+			    == LOG_SLOTS
+			    && !log_wait (buffer, head)))
+		{
+			atomic_store_explicit (&buffer->writing, false, memory_order_release);
+			goto sync;
+		}
+
+		struct log_record *record = &buffer->records[head % LOG_SLOTS];
+
+		record->timestamp = timestamp;
+		log_format (record->line, timestamp, format, ap);
+
+		atomic_store_explicit (&buffer->head, head + 1, memory_order_release);
+		atomic_store_explicit (&buffer->writing, false, memory_order_release);
+
+		return;
+	}
+
+sync:;
+	/* one call, so a line isn't split by another thread's */
+	char line[LOG_LINE];
+
+	log_format (line, timestamp, format, ap);
+	fputs (line, stdout);
+
+	if (logger.forked)
+		fflush (stdout);
+}
+
+void log_forked ()
+{
+	/* the flusher wasn't forked along; its buffers stay with the parent */
+	if (atomic_load (&logger.mode) == LOG_ASYNC)
+		atomic_store (&logger.mode, LOG_SYNC);
+
+	log_self = NULL;
+	logger.forked = true;
+}
+
+void log_shutdown ()
+{
+	int status;
+
+	if (atomic_load (&logger.mode) != LOG_ASYNC)
+		return;
+
+	/* new lines go straight out, and so do those waiting on a full buffer */
+	atomic_store (&logger.mode, LOG_SYNC);
+
+	status = pthread_mutex_lock (&logger.mtx);
+	assert (status == 0);
+
+	logger.stopping = true;
+
+	status = pthread_cond_signal (&logger.wake);
+	assert (status == 0);
+
+	status = pthread_cond_broadcast (&logger.drained);
+	assert (status == 0);
+
+	status = pthread_mutex_unlock (&logger.mtx);
+	assert (status == 0);
+
+	status = pthread_join (logger.flusher, NULL);
+	assert (status == 0);
+
+	/* a detached barber that saw asynchronous mode just before the switch
+	 * may still be writing its line; it only takes a moment */
+	struct log_buffer *buffer = atomic_load (&logger.buffers);
+
+	for (; buffer; buffer = buffer->next)
+		while (atomic_load (&buffer->writing))
+			sched_yield ();
+
+	log_drain ();
+
+	/* the buffers, and the key that orphans them, are kept: a thread that
+	 * still has one marks it before checking the mode */
+	free (logger.batch);
+}
@@ -0,0 +1,49 @@
+#ifndef _THRLAB_LOG_H_
+#define _THRLAB_LOG_H_
+
+#include <stdarg.h>
+
+enum log_mode
+{
+	LOG_NONE, /* discard everything */
+	LOG_SYNC, /* print straight to stdout from the calling thread */
+	LOG_ASYNC /* buffer per thread, printed in batches by a flusher thread */
+};
+
+/**
+ * Start logging in the given mode.
+ *
+ * Returns 0 on success.
+ */
+int log_init (enum log_mode mode);
+
+/**
+ * Whether logged lines go anywhere.
+ */
+int log_enabled ();
+
+/**
+ * Log a line stamped with `timestamp` seconds. A line is printed whole, in
+ * one go, but cut short past 256 bytes.
+ *
+ * In asynchronous mode lines from different threads may be printed out of
+ * order; sorting the output on the timestamp column restores it. A thread
+ * whose buffer is full sleeps until the flusher has drained it.
+ */
+void log_vprintf (double timestamp, const char *format, va_list ap);
+
+/**
+ * Carry on logging in a child forked since `log_init`. Lines are then printed
+ * synchronously and flushed one at a time. Call it in the child before it
+ * logs anything.
+ */
+void log_forked ();
+
+/**
+ * Stop the flusher and print everything still buffered, including lines
+ * being written as logging switched over. Logging afterwards falls back to
+ * synchronous mode.
+ */
+void log_shutdown ();
+
+#endif
@@ -1,10 +1,20 @@
 #include <assert.h>
+#include <errno.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "heap.h"
 #include "help.h"
+#include "ring.h"
+#include "sbuf.h"
 
 
 /*********************************************************
@@ -19,78 +29,385 @@
  * === End User Information ===
  ********************************************************/
 
+/* How often the elastic shop looks at the waiting room, in milliseconds */
+#define ELASTIC_TICK 50
+/* Looks in a row the shop must seem overstaffed before sending someone home */
+#define ELASTIC_CALM 10
+/* Haircut length to plan for before anyone's had one, in milliseconds */
+#define ELASTIC_GUESS 400
+
 static void *barber_work(void *arg);
+static void *loop_work(void *arg);
+static void *elastic_work(void *arg);
 
 struct chairs
 {
-    struct customer **customer; /* Array of customers */
     int max;
-    /* TODO: Add more variables related to threads */
-    /* Hint: Think of the consumer producer thread problem */
-    sem_t mutex;
-    sem_t chair;
-    sem_t barber;
+    enum thrlab_queue kind; /* Which of the queues below is in use */
+    sbuf_t sbuf; /* Waiting room, semaphore based */
+    ring_t ring; /* Waiting room, lock-free */
+    heap_t heap; /* Waiting room, ordered by rank */
+    sem_t chair; /* Counts free waiting chairs */
 };
 
 struct barber
 {
     int room;
     struct simulator *simulator;
+    struct chairs *chairs; /* The waiting room of the barber's shop */
+
+    /* Elastic mode only */
+    sem_t wake; /* Posted when the barber is called back in */
+    atomic_bool parked; /* Gone home, waiting for a call */
+    bool started; /* Thread running; only the controller looks */
+    bool onDuty; /* Clocked on; only the controller looks */
+
+    /* Event loop mode only */
+    int timer; /* timerfd, readable once the haircut is done */
+    struct customer *customer; /* In the chair, or NULL */
+};
+
+/**
+ * An event loop thread driving every barber whose room it owns.
+ */
+struct loop
+{
+    int epoll;
+    struct simulator *simulator;
+    struct barber **idle; /* Stack of barbers without a customer */
+    int numIdle;
+    bool armed; /* Whether arrivals will wake us */
+};
+
+/**
+ * Keeps between min and max barbers on duty: rooms [0, active) are open.
+ */
+struct elastic
+{
+    int min;
+    int max;
+    atomic_int active;
+    atomic_uint arrivals; /* Since the controller last looked */
+    atomic_ulong workMs; /* Haircut time so far, for the mean */
+    atomic_ulong cuts;
+    atomic_bool closing;
+    pthread_t thread;
 };
 
 struct simulator
 {
-    struct chairs chairs;
+    struct chairs *chairs; /* One per shop, shared with the barbers even as processes */
+    int numShops;
+    enum thrlab_barbers mode;
+    struct elastic elastic;
     
     pthread_t *barberThread;
     struct barber **barber;
+
+    /* Event loop mode only */
+    int arrivals; /* eventfd, counts customers seated and not yet taken */
+    int numLoops;
+    pthread_t *loopThread;
+    struct loop *loop;
 };
 
-typedef struct{
-    int *buf; /* Buffer array */
-    int n; /* Maximum number of slots */
-    int front; /* buf[(front+1)%n] is first item */
-    int rear; /* buf[rear%n] is last item */
-    sem_t mutex; /* Protects accesses to buf*/
-    sem_t slots; /* Counts available slots */
-    sem_t items; /* Counts available items */
-} sbuf_t;
-
-void sbuf_init(sbuf_t *sp, int n);
-void sbuf_deinit(sbuf_t *sp);
-void sbuf_insert(sbuf_t *sp, int item);
-int sbuf_remove(sbuf_t *sp);
+/**
+ * Seat an accepted customer in the waiting room.
+ */
+static void chairs_insert(struct chairs *chairs, struct customer *customer)
+{
+    if (chairs->kind == THRLAB_QUEUE_RING)
+        ring_insert(&chairs->ring, customer);
+    else if (chairs->kind == THRLAB_QUEUE_HEAP)
+        heap_insert(&chairs->heap, customer, thrlab_customer_rank(customer));
+    else
+        sbuf_insert(&chairs->sbuf, customer);
+}
+
+/**
+ * Wait for and take the next customer from the waiting room.
+ */
+static struct customer *chairs_remove(struct chairs *chairs)
+{
+    if (chairs->kind == THRLAB_QUEUE_RING)
+        return ring_remove(&chairs->ring);
+    else if (chairs->kind == THRLAB_QUEUE_HEAP)
+        return heap_remove(&chairs->heap);
+    else
+        return sbuf_remove(&chairs->sbuf);
+}
+
+/**
+ * Take the next customer from the waiting room if anyone's there, or NULL.
+ */
+static struct customer *chairs_try_remove(struct chairs *chairs)
+{
+    void *customer = NULL;
+
+    if (chairs->kind == THRLAB_QUEUE_RING)
+        ring_try_remove(&chairs->ring, &customer);
+    else if (chairs->kind == THRLAB_QUEUE_HEAP)
+        heap_try_remove(&chairs->heap, &customer);
+    else
+        customer = sbuf_try_remove(&chairs->sbuf);
+    return customer;
+}
+
+/**
+ * Share the rooms among event loop threads: room i belongs to loop
+ * i % numLoops. Arrivals are a single eventfd watched by every loop that has
+ * a free room; haircuts end on each room's timerfd.
+ */
+static void setup_loops(struct simulator *simulator)
+{
+    int numBarbers = thrlab_get_num_barbers();
+    struct epoll_event event;
+
+    simulator->arrivals = eventfd(0, EFD_NONBLOCK | EFD_SEMAPHORE);
+    if (simulator->arrivals < 0) {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+
+    simulator->numLoops = thrlab_get_num_loops();
+    simulator->loop = calloc(sizeof(struct loop), simulator->numLoops);
+    simulator->loopThread = malloc(sizeof(pthread_t) * simulator->numLoops);
+
+    for (int i = 0; i < simulator->numLoops; i++) {
+        struct loop *loop = &simulator->loop[i];
+        loop->simulator = simulator;
+        loop->idle = malloc(sizeof(struct barber*) * numBarbers);
+        loop->epoll = epoll_create1(0);
+        if (loop->epoll < 0) {
+            perror("epoll_create1");
+            exit(EXIT_FAILURE);
+        }
+
+        /* One-shot, so a loop with every room busy isn't woken for nothing */
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = NULL;
+        epoll_ctl(loop->epoll, EPOLL_CTL_ADD, simulator->arrivals, &event);
+        loop->armed = true;
+    }
+
+    for (int i = 0; i < numBarbers; i++) {
+        struct barber *barber = calloc(sizeof(struct barber), 1);
+        struct loop *loop = &simulator->loop[i % simulator->numLoops];
+        barber->room = i;
+        barber->simulator = simulator;
+        barber->chairs = &simulator->chairs[thrlab_get_room_shop(i)];
+        barber->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        if (barber->timer < 0) {
+            perror("timerfd_create");
+            exit(EXIT_FAILURE);
+        }
+        simulator->barber[i] = barber;
+        thrlab_barber_on_duty(i);
+
+        event.events = EPOLLIN;
+        event.data.ptr = barber;
+        epoll_ctl(loop->epoll, EPOLL_CTL_ADD, barber->timer, &event);
+
+        loop->idle[loop->numIdle++] = barber;
+    }
+
+    for (int i = 0; i < simulator->numLoops; i++) {
+        pthread_create(&simulator->loopThread[i], 0, loop_work, &simulator->loop[i]);
+        pthread_detach(simulator->loopThread[i]);
+    }
+}
+
+/**
+ * Put the barber for room `room` on duty, starting their thread the first
+ * time and waking them up after that. Only the controller (or setup) calls
+ * barbers in or sends them home.
+ */
+static void call_in(struct simulator *simulator, int room)
+{
+    struct barber *barber = simulator->barber[room];
+
+    if (!barber->onDuty) {
+        thrlab_barber_on_duty(room);
+        barber->onDuty = true;
+    }
+
+    if (atomic_load(&simulator->elastic.active) <= room)
+        atomic_store(&simulator->elastic.active, room + 1);
+
+    if (!barber->started && simulator->mode == THRLAB_BARBERS_PROCESS) {
+        /* Never sent home, so never woken up again */
+        thrlab_fork_barber(room, barber_work, barber);
+        barber->started = true;
+    } else if (!barber->started) {
+        pthread_create(&simulator->barberThread[room], 0, barber_work, barber);
+        pthread_detach(simulator->barberThread[room]);
+        barber->started = true;
+    } else {
+        sem_post(&barber->wake);
+    }
+}
+
+/**
+ * Watch the waiting room and arrival rate, calling in a barber as soon as
+ * the shop falls behind and sending one home only after it's been clearly
+ * overstaffed for a while.
+ */
+static void *elastic_work(void *arg)
+{
+    struct simulator *simulator = arg;
+    struct elastic *elastic = &simulator->elastic;
+    struct chairs *chairs = simulator->chairs; /* An elastic day has one shop */
+    double rate = 0; /* Arrivals per millisecond, smoothed */
+    int calm = 0;
+
+    while (!atomic_load(&elastic->closing)) {
+    thrlab_sleep(ELASTIC_TICK);
+
+    int active = atomic_load(&elastic->active);
+    int free;
+    sem_getvalue(&chairs->chair, &free);
+    int waiting = chairs->max - free;
+
+    unsigned long cuts = atomic_load(&elastic->cuts);
+    double service = cuts ? (double) atomic_load(&elastic->workMs) / cuts
+                          : ELASTIC_GUESS;
+    rate = 0.8 * rate + 0.2 * atomic_exchange(&elastic->arrivals, 0) / ELASTIC_TICK;
+    double load = rate * service; /* Barbers the arrivals keep busy */
+
+    /* Grow at 90% busy, shrink below 60% of one fewer: the gap is the
+       hysteresis that keeps barbers from flapping */
+    if (active < elastic->max && (2 * waiting > chairs->max || load > 0.9 * active)) {
+        call_in(simulator, active);
+        calm = 0;
+    } else if (active > elastic->min && waiting == 0 && load < 0.6 * (active - 1)) {
+        if (++calm >= ELASTIC_CALM) {
+            atomic_store(&elastic->active, active - 1);
+            calm = 0;
+        }
+    } else {
+        calm = 0;
+    }
+
+    /* Stop paying whoever's actually gone home */
+    for (int i = atomic_load(&elastic->active); i < elastic->max; i++) {
+        struct barber *barber = simulator->barber[i];
+        if (barber->onDuty && atomic_load(&barber->parked)) {
+            thrlab_barber_off_duty(i);
+            barber->onDuty = false;
+        }
+    }
+    }
+    return NULL;
+}
+
+/**
+ * Whether the barber's room is still open.
+ */
+static bool barber_wanted(struct barber *barber)
+{
+    return barber->room < atomic_load(&barber->simulator->elastic.active);
+}
+
+/**
+ * Go home while the barber's room is closed, until called back in.
+ */
+static void barber_park(struct barber *barber)
+{
+    if (barber_wanted(barber))
+        return;
+
+    atomic_store(&barber->parked, true);
+    while (!barber_wanted(barber))
+        sem_wait(&barber->wake);
+    atomic_store(&barber->parked, false);
+}
 
 /**
  * Initialize data structures and create waiting barber threads.
  */
 static void setup(struct simulator *simulator)
 {
-    struct chairs *chairs = &simulator->chairs;
+    simulator->mode = thrlab_get_barber_loop();
+    bool pshared = simulator->mode == THRLAB_BARBERS_PROCESS;
+
+    simulator->numShops = thrlab_get_num_shops();
+    simulator->chairs = thrlab_shared_alloc(sizeof(struct chairs) * simulator->numShops);
+
+    /* Every shop gets its own waiting room, so they never share a lock */
+    for (int i = 0; i < simulator->numShops; i++) {
+    struct chairs *chairs = &simulator->chairs[i];
+    /* Profile its lock with --lock-profile; the ring has none */
+    struct lockprof *seat = thrlab_get_lock_profile(THRLAB_LOCK_SEAT, i);
+    struct lockprof *pickup = thrlab_get_lock_profile(THRLAB_LOCK_PICKUP, i);
     /* Setup semaphores*/
     chairs->max = thrlab_get_num_chairs();
+    chairs->kind = thrlab_get_queue();
     
-    sem_init(&chairs->mutex, 0 , 1);
-    sem_init(&chairs->chair, 0 , 1);
-    sem_init(&chairs->barber, 0 , 0);
+    sem_init(&chairs->chair, pshared, chairs->max);
 
     /* Create chairs*/
-    chairs->customer = malloc(sizeof(struct customer *) * thrlab_get_num_chairs());
-    
+    int status = 0;
+    if (chairs->kind == THRLAB_QUEUE_RING)
+        status = ring_init(&chairs->ring, chairs->max, pshared);
+    else if (chairs->kind == THRLAB_QUEUE_HEAP)
+        heap_init(&chairs->heap, chairs->max, pshared);
+    else
+        status = sbuf_init(&chairs->sbuf, chairs->max, pshared);
+    if (status != 0) {
+        fprintf(stderr, "No room for %d chairs\n", chairs->max);
+        exit(EXIT_FAILURE);
+    }
+
+    if (chairs->kind == THRLAB_QUEUE_HEAP)
+        heap_profile(&chairs->heap, seat, pickup);
+    else if (chairs->kind == THRLAB_QUEUE_SBUF)
+        sbuf_profile(&chairs->sbuf, seat, pickup);
+    }
+
     /* Create barber thread data */
     simulator->barberThread = malloc(sizeof(pthread_t) * thrlab_get_num_barbers());
     simulator->barber = malloc(sizeof(struct barber*) * thrlab_get_num_barbers());
 
-    /* Start barber threads */
+    if (simulator->mode == THRLAB_BARBERS_EVENT) {
+        setup_loops(simulator);
+        return;
+    }
+
+    /* Without --elastic, min is everyone and nobody's ever sent home */
+    struct elastic *elastic = &simulator->elastic;
+    elastic->min = thrlab_get_min_barbers();
+    elastic->max = thrlab_get_num_barbers();
+    atomic_init(&elastic->active, elastic->min);
+
+    /* Create every barber, but only start the ones on duty from opening */
     struct barber *barber;
     for (unsigned int i = 0; i < thrlab_get_num_barbers(); i++) {
         barber = calloc(sizeof(struct barber), 1);
         barber->room = i;
         barber->simulator = simulator;
+        barber->chairs = &simulator->chairs[thrlab_get_room_shop(i)];
+        sem_init(&barber->wake, 0, 0);
         simulator->barber[i] = barber;
-        pthread_create(&simulator->barberThread[i], 0, barber_work, barber);
-        pthread_detach(simulator->barberThread[i]);
+        if ((int) i < elastic->min)
+            call_in(simulator, i);
     }
+
+    if (elastic->min < elastic->max)
+        pthread_create(&elastic->thread, 0, elastic_work, simulator);
+}
+
+/**
+ * Stop calling barbers in and sending them home, before the harness closes.
+ */
+static void close_shop(struct simulator *simulator)
+{
+    struct elastic *elastic = &simulator->elastic;
+
+    if (simulator->mode == THRLAB_BARBERS_EVENT || elastic->min == elastic->max)
+        return;
+
+    atomic_store(&elastic->closing, true);
+    pthread_join(elastic->thread, NULL);
 }
 
 /**
@@ -98,12 +415,15 @@ static void setup(struct simulator *simulator)
  */
 static void cleanup(struct simulator *simulator)
 {
-    /* Free chairs */
-    free(simulator->chairs.customer);
+    /* Barber processes have been stopped; threads still hold theirs */
+    if (simulator->mode == THRLAB_BARBERS_PROCESS)
+        for (int i = 0; i < simulator->elastic.max; i++)
+            free(simulator->barber[i]);
 
     /* Free barber thread data */
     free(simulator->barber);
     free(simulator->barberThread);
+    free(simulator->loopThread);
 }
 
 /**
@@ -112,100 +432,158 @@ static void cleanup(struct simulator *simulator)
 static void customer_arrived(struct customer *customer, void *arg)
 {
     struct simulator *simulator = arg;
-    struct chairs *chairs = &simulator->chairs;
-
-    sbuf_t waitingroom;
+    struct chairs *chairs = &simulator->chairs[customer->shop];
 
-    // is there an empty chair in the waitingroom or barber chair
-    // if 
-
-    sem_init(&customer->mutex, 0, 0);
+    /* Reject if there are no available chairs */
+    if (sem_trywait(&chairs->chair) != 0) {
+        thrlab_reject_customer(customer);
+        return;
+    }
 
-    /* TODO: Accept if there is an available chair */
-    sem_wait(&chairs->chair);   
-    sem_wait(&chairs->mutex);   //lock mutex to protect seat changes
+    /* Accept, and wait in the waitingroom until the haircut is over */
     thrlab_accept_customer(customer);
-    chairs->customer[0] = customer;
-    sem_post(&chairs->mutex);
-    sem_post(&chairs->barber);  //increase number for barber
+    chairs_insert(chairs, customer);
+    atomic_fetch_add(&simulator->elastic.arrivals, 1);
 
-    sem_wait(&customer->mutex);
+    /* Let a loop with a free room know someone's waiting */
+    if (simulator->mode == THRLAB_BARBERS_EVENT)
+        eventfd_write(simulator->arrivals, 1);
 
-    /* TODO: Reject if there are no available chairs */
-    thrlab_reject_customer(customer);
+    thrlab_customer_wait(customer);
 }
 
 static void *barber_work(void *arg)
 {
     struct barber *barber = arg;
-    struct chairs *chairs = &barber->simulator->chairs;
-    struct customer *customer = 0; /* TODO: Fetch a customer from a chair */
-
-    /* Main barber loop */
-    while (true) {
-    /* TODO: Here you must add you semaphores and locking logic */
-    sem_wait(&chairs->barber);
+    struct chairs *chairs = barber->chairs;
+    struct elastic *elastic = &barber->simulator->elastic;
+    struct customer *customer = 0;
+    struct customer *next = 0;
+    int ms;
 
-    sem_wait(&chairs->mutex);
-    customer = chairs->customer[0]; /* TODO: You must choose the customer */
-    thrlab_prepare_customer(customer, barber->room);
-    sem_post(&chairs->mutex);
-    sem_post(&chairs->chair);
+    thrlab_pin_barber(barber->room);
 
-    thrlab_sleep(5 * (customer->hair_length - customer->hair_goal));
-    thrlab_dismiss_customer(customer, barber->room);
-
-    sem_post(&customer->mutex);
+    /* Main barber loop: whoever's waiting sits down as the last one gets up */
+    while (true) {
+    /* Nobody was waiting; go home if sent, then doze off until someone is */
+    if (!next) {
+        barber_park(barber);
+        next = chairs_remove(chairs);
+        thrlab_prepare_customer(next, barber->room);
+    }
+    sem_post(&chairs->chair); /* The customer's waiting chair is free */
+    customer = next;
+
+    ms = 5 * (customer->hair_length - customer->hair_goal);
+    thrlab_sleep(ms);
+    atomic_fetch_add(&elastic->workMs, ms);
+    atomic_fetch_add(&elastic->cuts, 1);
+
+    /* A barber who's been sent home finishes up and takes nobody new */
+    next = barber_wanted(barber) ? chairs_try_remove(chairs) : NULL;
+    if (next)
+        thrlab_dismiss_and_prepare(customer, next, barber->room);
+    else
+        thrlab_dismiss_customer(customer, barber->room);
+
+    thrlab_customer_post(customer);
     }
     return NULL;
 }
 
-/* Create an empty, bounded, shared FIFO buffer with nslots */
-void sbuf_init(sbuf_t *sp, int n)
-{
-    sp->buf = calloc(n, sizeof(int));
-    sp->n= n; /* Buffer holds max of nitems */
-    sp->front = sp->rear = 0; /* Empty buffer ifffront == rear */
-    sem_init(&sp->mutex, 0, 1); /* Binary semaphore for locking */
-    sem_init(&sp->slots, 0, n); /* Initially, bufhas nempty slots */
-    sem_init(&sp->items, 0, 0); /* Initially, bufhas zero items */
-}
-/* Clean up buffer sp */
-void sbuf_deinit(sbuf_t *sp)
+/**
+ * Bring the next waiting customer into the room, handing over from `done`
+ * if someone's just had their haircut there, and set the room's timer for
+ * when the new haircut is done.
+ */
+static void start_haircut(struct barber *barber, struct customer *customer,
+                          struct customer *done)
 {
-    free(sp->buf);
+    struct chairs *chairs = barber->chairs;
+    long ms = 5 * (customer->hair_length - customer->hair_goal);
+    struct itimerspec finish = {
+        .it_interval = { 0, 0 },
+        .it_value = { ms / 1000, ms % 1000 * 1000000 }
+    };
+
+    if (done)
+        thrlab_dismiss_and_prepare(done, customer, barber->room);
+    else
+        thrlab_prepare_customer(customer, barber->room);
+    sem_post(&chairs->chair); /* The customer's waiting chair is free */
+
+    barber->customer = customer;
+    timerfd_settime(barber->timer, 0, &finish, NULL);
 }
 
-/* Insert item onto the rear of shared buffer sp */
-void sbuf_insert(sbuf_t *sp, int item)
+static void *loop_work(void *arg)
 {
-    sem_wait(&sp->slots); /* Wait for available slot */
-    sem_wait(&sp->mutex); /* Lock the buffer */
-    sp->buf[(++sp->rear)%(sp->n)] = item; /* Insert the item */
-    sem_post(&sp->mutex); /* Unlock the buffer */
-    sem_post(&sp->items); /* Announce available item */
-}
+    struct loop *loop = arg;
+    struct simulator *simulator = loop->simulator;
+    struct chairs *chairs = simulator->chairs; /* Event loops run one shop */
+    struct epoll_event events[64];
+    struct epoll_event event;
+    eventfd_t seated;
+    uint64_t expirations;
+
+    /* Each loop gets the CPU the barber of the same number would */
+    thrlab_pin_barber(loop - simulator->loop);
+
+    /* Main loop: finish haircuts, then fill the free rooms */
+    while (true) {
+    int n = epoll_wait(loop->epoll, events, 64, -1);
+    if (n < 0 && errno != EINTR) {
+        perror("epoll_wait");
+        exit(EXIT_FAILURE);
+    }
 
-/* Remove and return the first item from buffer sp */
-int sbuf_remove(sbuf_t *sp)
-{
-    int item;
-    sem_wait(&sp->items); /* Wait for available item */
-    sem_wait(&sp->mutex); /* Lock the buffer */
-    item = sp->buf[(++sp->front)%(sp->n)]; /* Remove the item */
-    sem_post(&sp->mutex); /* Unlock the buffer */
-    sem_post(&sp->slots); /* Announce available slot */
-    return item;
+    for (int i = 0; i < n; i++) {
+        struct barber *barber = events[i].data.ptr;
+
+        if (barber == NULL) { /* Arrivals; disarmed until re-armed below */
+            loop->armed = false;
+            continue;
+        }
+
+        if (read(barber->timer, &expirations, sizeof(expirations)) < 0)
+            continue;
+
+        /* Go straight on to the next customer if one's waiting */
+        struct customer *done = barber->customer;
+        if (eventfd_read(simulator->arrivals, &seated) == 0) {
+            start_haircut(barber, chairs_remove(chairs), done);
+        } else {
+            thrlab_dismiss_customer(done, barber->room);
+            barber->customer = NULL;
+            loop->idle[loop->numIdle++] = barber;
+        }
+        thrlab_customer_post(done);
+    }
+
+    /* Each count taken is a customer already in (or going into) the queue */
+    while (loop->numIdle > 0 && eventfd_read(simulator->arrivals, &seated) == 0)
+        start_haircut(loop->idle[--loop->numIdle], chairs_remove(chairs), NULL);
+
+    if (loop->numIdle > 0 && !loop->armed) {
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = NULL;
+        epoll_ctl(loop->epoll, EPOLL_CTL_MOD, simulator->arrivals, &event);
+        loop->armed = true;
+    }
+    }
+    return NULL;
 }
 
 int main (int argc, char **argv)
 {
-    struct simulator simulator;
+    /* static: the detached barbers outlive main's stack frame */
+    static struct simulator simulator;
 
     thrlab_setup(&argc, &argv);
     setup(&simulator);
 
     thrlab_wait_for_customers(customer_arrived, &simulator);
+    close_shop(&simulator);
 
     thrlab_cleanup();
     cleanup(&simulator);
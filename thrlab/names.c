@@ -0,0 +1,263 @@
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "names.h"
+
+#define ARRSIZE(x) (sizeof (x) / sizeof (*(x)))
+
+/* room enough for the longest name and its number */
+#define BARBER_NAME 32
+
+const char *barber_names[] =
+	{ "HAL9000"
+	, "Terminator"
+	, "Wall-E"
+	, "Johnny-5"
+	, "Dot-Matrix"
+	, "C-3PO"
+	, "R2D2"
+	, "Optimus-Prime"
+	, "Bishop"
+	, "Call"
+	, "Robot"
+	, "Robocop"
+	, "Andrew"
+	, "Bender"
+	, "T-1000"
+	, "GERTY-3000"
+	, "Data"
+	, "Sonny"
+	, "Astro-Boy"
+	, "Baymax"
+	, "TARS"
+	, "CASE"
+	, "Cylon"
+	, "C.H.E.E.S.E."
+	, "Funnybot"
+	, "GIR"
+	, "D.A.V.E."
+	, "Six"
+	, "Replicator"
+	, "MegaMan"
+	, "ED209"
+	, "B.E.N."
+	, "SID-6.7"
+	, "21-B"
+	, "Fembot"
+	, "Sentinel"
+	, "Gigalo-Joe"
+	, "DroidEkas"
+	, "D.A.R.Y.L."
+	, "Pris"
+	, "Omnidroid"
+	, "Teddy"
+	, "EVE"
+	, "Mechagodzilla"
+	, "Steprod-Wive"
+	, "Marvin"
+	, "Ash"
+	, "Gort"
+	, "Roy-Batty"
+	};
+
+const char *customer_names[] =
+	{ "Abigail"
+	, "Adam"
+	, "Adrian"
+	, "Alan"
+	, "Alexander"
+	, "Alexandra"
+	, "Alison"
+	, "Amanda"
+	, "Amelia"
+	, "Amy"
+	, "Andrea"
+	, "Andrew"
+	, "Angela"
+	, "Anna"
+	, "Anne"
+	, "Anthony"
+	, "Audrey"
+	, "Austin"
+	, "Ava"
+	, "Bella"
+	, "Benjamin"
+	, "Bernadette"
+	, "Blake"
+	, "Boris"
+	, "Brandon"
+	, "Brian"
+	, "Cameron"
+	, "Carl"
+	, "Carol"
+	, "Caroline"
+	, "Carolyn"
+	, "Charles"
+	, "Chloe"
+	, "Christian"
+	, "Christopher"
+	, "Claire"
+	, "Colin"
+	, "Connor"
+	, "Dan"
+	, "David"
+	, "Deirdre"
+	, "Diana"
+	, "Diane"
+	, "Dominic"
+	, "Donna"
+	, "Dorothy"
+	, "Dylan"
+	, "Edward"
+	, "Elizabeth"
+	, "Ella"
+	, "Emily"
+	, "Emma"
+	, "Eric"
+	, "Evan"
+	, "Faith"
+	, "Felicity"
+	, "Fiona"
+	, "Frank"
+	, "Gabrielle"
+	, "Gavin"
+	, "Gordon"
+	, "Grace"
+	, "Hannah"
+	, "Harry"
+	, "Heather"
+	, "Ian"
+	, "Irene"
+	, "Isaac"
+	, "Jack"
+	, "Jacob"
+	, "Jake"
+	, "James"
+	, "Jan"
+	, "Jane"
+	, "Jasmine"
+	, "Jason"
+	, "Jennifer"
+	, "Jessica"
+	, "Joan"
+	, "Joanne"
+	, "Joe"
+	, "John"
+	, "Jonathan"
+	, "Joseph"
+	, "Joshua"
+	, "Julia"
+	, "Julian"
+	, "Justin"
+	, "Karen"
+	, "Katherine"
+	, "Keith"
+	, "Kevin"
+	, "Kimberly"
+	, "Kylie"
+	, "Lauren"
+	, "Leah"
+	, "Leonard"
+	, "Liam"
+	, "Lillian"
+	, "Lily"
+	, "Lisa"
+	, "Lucas"
+	, "Luke"
+	, "Madeleine"
+	, "Maria"
+	, "Mary"
+	, "Matt"
+	, "Max"
+	, "Megan"
+	, "Melanie"
+	, "Michael"
+	, "Michelle"
+	, "Molly"
+	, "Natalie"
+	, "Nathan"
+	, "Neil"
+	, "Nicholas"
+	, "Nicola"
+	, "Oliver"
+	, "Olivia"
+	, "Owen"
+	, "Paul"
+	, "Penelope"
+	, "Peter"
+	, "Phil"
+	, "Piers"
+	, "Pippa"
+	, "Rachel"
+	, "Rebecca"
+	, "Richard"
+	, "Robert"
+	, "Rose"
+	, "Ruth"
+	, "Ryan"
+	, "Sally"
+	, "Sam"
+	, "Samantha"
+	, "Sarah"
+	, "Sean"
+	, "Sebastian"
+	, "Simon"
+	, "Sonia"
+	, "Sophie"
+	, "Stephanie"
+	, "Stephen"
+	, "Steven"
+	, "Stewart"
+	, "Sue"
+	, "Theresa"
+	, "Thomas"
+	, "Tim"
+	, "Tracey"
+	, "Trevor"
+	, "Una"
+	, "Vanessa"
+	, "Victor"
+	, "Victoria"
+	, "Virginia"
+	, "Wanda"
+	, "Warren"
+	, "Wendy"
+	, "William"
+	, "Yvonne"
+	, "Zoe"
+	};
+
+const size_t num_barber_names = ARRSIZE (barber_names);
+
+/* names past the table's end, indexed by room; made up on first use */
+static char numbered_names[BARBERS_MAX][BARBER_NAME];
+static pthread_once_t numbered_once = PTHREAD_ONCE_INIT;
+
+static void number_names ()
+{
+	for (size_t i = num_barber_names; i < BARBERS_MAX; ++i)
+	{
+		snprintf
+			( numbered_names[i]
+			, BARBER_NAME
+			, "%s #%zu"
+			, barber_names[i % num_barber_names]
+			, i / num_barber_names + 1
+			);
+	}
+}
+
+const char *barber_name (unsigned int room)
+{
+	if (room < num_barber_names)
+		return barber_names[room];
+
+	if (room >= BARBERS_MAX)
+		return "?";
+
+	pthread_once (&numbered_once, number_names);
+
+	return numbered_names[room];
+}
+
+const size_t num_customer_names = ARRSIZE (customer_names);
@@ -0,0 +1,22 @@
+#ifndef _THRLAB_NAMES_H_
+#define _THRLAB_NAMES_H_
+
+#include <stddef.h>
+
+/* most rooms a shop can name a barber for */
+#define BARBERS_MAX 1000
+
+/* barber `i` works in room `i` */
+extern const char *barber_names[];
+extern const size_t num_barber_names;
+
+/**
+ * The name of the barber in room `room`. Past the end of the table the names
+ * go round again, numbered ("HAL9000 #2"); past BARBERS_MAX it's "?".
+ */
+const char *barber_name (unsigned int room);
+
+extern const char *customer_names[];
+extern const size_t num_customer_names;
+
+#endif
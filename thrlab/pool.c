@@ -0,0 +1,176 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include "pool.h"
+
+static void *pool_worker (void *arg)
+{
+	assert (arg);
+
+	struct pool *pool = arg;
+	struct pool_job job;
+	int status;
+
+	while (1)
+	{
+		status = pthread_mutex_lock (&pool->mtx);
+		assert (status == 0);
+
+		while (pool->depth == 0 && !pool->closing)
+		{
+			status = pthread_cond_wait (&pool->nonempty, &pool->mtx);
+			assert (status == 0);
+		}
+
+		if (pool->depth == 0)
+		{
+			status = pthread_mutex_unlock (&pool->mtx);
+			assert (status == 0);
+
+			return NULL;
+		}
+
+		job = pool->jobs[pool->head];
+		pool->head = (pool->head + 1) % pool->capacity;
+		--pool->depth;
+
+		status = pthread_cond_signal (&pool->nonfull);
+		assert (status == 0);
+
+		status = pthread_mutex_unlock (&pool->mtx);
+		assert (status == 0);
+
+		job.fn (job.arg);
+	}
+}
+
+int pool_init (struct pool *pool, size_t workers, size_t capacity)
+{
+	assert (pool);
+	assert (workers > 0);
+	assert (capacity > 0);
+
+	int status;
+
+	pool->num_workers = 0;
+	pool->capacity = capacity;
+	pool->head = 0;
+	pool->depth = 0;
+	pool->closing = false;
+	pool->submitted = 0;
+	pool->max_depth = 0;
+
+	pool->jobs = malloc (capacity * sizeof (*pool->jobs));
+	if (pool->jobs == NULL) goto error_jobs;
+
+	pool->workers = malloc (workers * sizeof (*pool->workers));
+	if (pool->workers == NULL) goto error_workers;
+
+	status = pthread_mutex_init (&pool->mtx, NULL);
+	if (status != 0) goto error_mtx;
+
+	status = pthread_cond_init (&pool->nonempty, NULL);
+	if (status != 0) goto error_nonempty;
+
+	status = pthread_cond_init (&pool->nonfull, NULL);
+	if (status != 0) goto error_nonfull;
+
+	for (; pool->num_workers < workers; ++pool->num_workers)
+	{
+		status = pthread_create
+			( &pool->workers[pool->num_workers]
+			, NULL
+			, pool_worker
+			, pool
+			);
+		if (status != 0) goto error_thread;
+	}
+
+	return 0;
+
+error_thread:
+	pool_destroy (pool);
+	return -1;
+
+error_nonfull:
+	pthread_cond_destroy (&pool->nonempty);
+
+error_nonempty:
+	pthread_mutex_destroy (&pool->mtx);
+
+error_mtx:
+	free (pool->workers);
+
+error_workers:
+	free (pool->jobs);
+
+error_jobs:
+	return -1;
+}
+
+void pool_submit (struct pool *pool, void *(*fn) (void *), void *arg)
+{
+	assert (pool);
+	assert (fn);
+
+	int status;
+
+	status = pthread_mutex_lock (&pool->mtx);
+	assert (status == 0);
+
+	assert (!pool->closing);
+
+	while (pool->depth == pool->capacity)
+	{
+		status = pthread_cond_wait (&pool->nonfull, &pool->mtx);
+		assert (status == 0);
+	}
+
+	pool->jobs[(pool->head + pool->depth) % pool->capacity] = (struct pool_job)
+		{ .fn = fn
+		, .arg = arg
+		};
+
+	++pool->depth;
+	++pool->submitted;
+
+	if (pool->depth > pool->max_depth)
+		pool->max_depth = pool->depth;
+
+	status = pthread_cond_signal (&pool->nonempty);
+	assert (status == 0);
+
+	status = pthread_mutex_unlock (&pool->mtx);
+	assert (status == 0);
+}
+
+void pool_destroy (struct pool *pool)
+{
+	assert (pool);
+
+	int status;
+
+	status = pthread_mutex_lock (&pool->mtx);
+	assert (status == 0);
+
+	pool->closing = true;
+
+	status = pthread_cond_broadcast (&pool->nonempty);
+	assert (status == 0);
+
+	status = pthread_mutex_unlock (&pool->mtx);
+	assert (status == 0);
+
+	for (size_t i = 0; i < pool->num_workers; ++i)
+	{
+		status = pthread_join (pool->workers[i], NULL);
+		assert (status == 0);
+	}
+
+	pthread_cond_destroy (&pool->nonfull);
+	pthread_cond_destroy (&pool->nonempty);
+	pthread_mutex_destroy (&pool->mtx);
+
+	free (pool->workers);
+	free (pool->jobs);
+}
@@ -0,0 +1,60 @@
+#ifndef _THRLAB_POOL_H_
+#define _THRLAB_POOL_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A unit of work queued on a pool.
+ */
+struct pool_job
+{
+	void *(*fn) (void *);
+	void *arg;
+};
+
+/**
+ * A fixed set of worker threads draining a bounded FIFO of jobs.
+ */
+struct pool
+{
+	pthread_mutex_t mtx;
+	pthread_cond_t nonempty;
+	pthread_cond_t nonfull;
+
+	pthread_t *workers;
+	size_t num_workers;
+
+	/* circular job queue */
+	struct pool_job *jobs;
+	size_t capacity;
+	size_t head;
+	size_t depth;
+
+	bool closing;
+
+	/* statistics, reported at closing */
+	size_t submitted;
+	size_t max_depth;
+};
+
+/**
+ * Start `workers` threads serving a queue of at most `capacity` jobs.
+ *
+ * Returns 0 on success.
+ */
+int pool_init (struct pool *pool, size_t workers, size_t capacity);
+
+/**
+ * Queue `fn(arg)` to be run by one of the workers, blocking while the queue
+ * is full.
+ */
+void pool_submit (struct pool *pool, void *(*fn) (void *), void *arg);
+
+/**
+ * Run every queued job to completion, then join and free the workers.
+ */
+void pool_destroy (struct pool *pool);
+
+#endif
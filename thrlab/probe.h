@@ -0,0 +1,59 @@
+#ifndef _THRLAB_PROBE_H_
+#define _THRLAB_PROBE_H_
+
+/**
+ * USDT probes under the `thrlab' provider, for bpftrace and perf:
+ *
+ *   arrive, accept, reject    (id, room, ns)
+ *   prepare, dismiss          (id, room, ns)
+ *   sleep_begin, sleep_end    (id, room, ns, ms)
+ *   cleanup                   (id, room, ns)
+ *
+ * `room' is TRACE_NO_ROOM and `id' UINT64_MAX where they don't apply; `ns' is
+ * time since opening, virtual or not. Each probe has a semaphore the tracer
+ * raises while attached, and its arguments are only worked out then. Without
+ * <sys/sdt.h> the probes compile away.
+ */
+
+#if defined (__has_include)
+#if __has_include (<sys/sdt.h>)
+#define THRLAB_PROBES 1
+#endif
+#endif
+
+#ifdef THRLAB_PROBES
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define PROBE_SEMAPHORE(name) \
+	volatile unsigned short thrlab_##name##_semaphore \
+		__attribute__ ((unused, section (".probes")))
+
+#define PROBE_ENABLED(name) __builtin_expect (thrlab_##name##_semaphore != 0, 0)
+
+#define PROBE(name, id, room, ns) \
+	do \
+	{ \
+		if (PROBE_ENABLED (name)) \
+			STAP_PROBE3 (thrlab, name, (id), (room), (ns)); \
+	} while (0)
+
+#define PROBE_MS(name, id, room, ns, ms) \
+	do \
+	{ \
+		if (PROBE_ENABLED (name)) \
+			STAP_PROBE4 (thrlab, name, (id), (room), (ns), (ms)); \
+	} while (0)
+
+#else
+
+#define PROBE_SEMAPHORE(name) \
+	extern volatile unsigned short thrlab_##name##_semaphore
+#define PROBE_ENABLED(name) 0
+#define PROBE(name, id, room, ns) do {} while (0)
+#define PROBE_MS(name, id, room, ns, ms) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+#define _DEFAULT_SOURCE
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+
+#define REPLAY_SEPARATORS " \t,\r\n"
+
+int replay_open (struct replay *replay, const char *path)
+{
+	assert (replay);
+	assert (path);
+
+	replay->path = path;
+	replay->line = 0;
+	replay->buf = NULL;
+	replay->size = 0;
+
+	if (strcmp (path, "-") == 0)
+	{
+		replay->file = stdin;
+		return 0;
+	}
+
+	replay->file = fopen (path, "r");
+
+	if (replay->file == NULL)
+	{
+		perror (path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Parse the next field of the current line into `value`.
+ */
+static int replay_field (char **s, double *value)
+{
+	char *end;
+
+	*s += strspn (*s, REPLAY_SEPARATORS);
+	*value = strtod (*s, &end);
+
+	if (end == *s || !isfinite (*value) || *value < 0)
+		return -1;
+
+	/* a field must end at a separator */
+	if (*end && !strchr (REPLAY_SEPARATORS, *end))
+		return -1;
+
+	*s = end;
+
+	return 0;
+}
+
+int replay_next (struct replay *replay, struct replay_arrival *arrival)
+{
+	assert (replay);
+	assert (arrival);
+
+	while (getline (&replay->buf, &replay->size, replay->file) != -1)
+	{
+		char *s = replay->buf;
+		double length, goal;
+
+		++replay->line;
+
+		s += strspn (s, REPLAY_SEPARATORS);
+
+		if (*s == '\0' || *s == '#')
+			continue;
+
+		if (replay_field (&s, &arrival->offset)
+			|| replay_field (&s, &length)
+			|| replay_field (&s, &goal)
+			|| s[strspn (s, REPLAY_SEPARATORS)] != '\0')
+		{
+			fprintf
+				( stderr
+				, "%s:%zu: expected `OFFSET HAIR_LENGTH HAIR_GOAL'\n"
+				, replay->path
+				, replay->line
+				);
+			return -1;
+		}
+
+		arrival->hair_length = lround (length);
+		arrival->hair_goal = lround (goal);
+
+		return 1;
+	}
+
+	if (ferror (replay->file))
+	{
+		perror (replay->path);
+		return -1;
+	}
+
+	return 0;
+}
+
+void replay_close (struct replay *replay)
+{
+	assert (replay);
+
+	if (replay->file && replay->file != stdin)
+		fclose (replay->file);
+
+	free (replay->buf);
+	replay->file = NULL;
+	replay->buf = NULL;
+}
@@ -0,0 +1,56 @@
+#ifndef _THRLAB_REPLAY_H_
+#define _THRLAB_REPLAY_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * A recorded stream of arrivals, read one line at a time so that a day of
+ * any length replays in constant memory.
+ *
+ * Each line is `OFFSET HAIR_LENGTH HAIR_GOAL', separated by blanks or
+ * commas: when the customer arrives, in milliseconds since the shop opened,
+ * and their hair in millimetres. Blank lines and lines starting with `#' are
+ * skipped.
+ */
+struct replay
+{
+	FILE *file;
+	const char *path;
+	size_t line;
+
+	char *buf;
+	size_t size;
+};
+
+/**
+ * One arrival read from a replay.
+ */
+struct replay_arrival
+{
+	double offset; /* milliseconds since opening */
+	unsigned long hair_length;
+	unsigned long hair_goal;
+};
+
+/**
+ * Open the replay at `path`, or standard input for `-'.
+ *
+ * Returns 0 on success.
+ */
+int replay_open (struct replay *replay, const char *path);
+
+/**
+ * Read the next arrival.
+ *
+ * Returns 1 on success, 0 at the end of the file, or -1 after complaining
+ * about a malformed line.
+ */
+int replay_next (struct replay *replay, struct replay_arrival *arrival);
+
+/**
+ * Close the replay.
+ */
+void replay_close (struct replay *replay);
+
+#endif
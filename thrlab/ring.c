@@ -0,0 +1,225 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "ring.h"
+#include "shared.h"
+
+static void ring_event_init (struct ring_event *ev, bool pshared)
+{
+	atomic_init (&ev->seq, 0);
+	atomic_init (&ev->waiters, 0);
+	ev->futex_flags = pshared ? 0 : FUTEX_PRIVATE_FLAG;
+}
+
+/**
+ * Wake one parked thread, if there is any. Must follow the update it
+ * announces.
+ */
+static void ring_event_signal (struct ring_event *ev)
+{
+	/* pairs with the fence in ring_event_wait: either the waiter sees our
+	 * update when retrying, or we see the waiter */
+	atomic_thread_fence (memory_order_seq_cst);
+
+	if (atomic_load_explicit (&ev->waiters, memory_order_relaxed) == 0)
+		return;
+
+	atomic_fetch_add_explicit (&ev->seq, 1, memory_order_relaxed);
+	syscall (SYS_futex, &ev->seq, FUTEX_WAKE | ev->futex_flags, 1, NULL, NULL, 0);
+}
+
+/**
+ * Register as a waiter. The caller must retry its operation once more before
+ * committing to the wait, so that a concurrent signal cannot be missed.
+ */
+static uint32_t ring_event_prepare (struct ring_event *ev)
+{
+	atomic_fetch_add (&ev->waiters, 1);
+	atomic_thread_fence (memory_order_seq_cst);
+
+	return atomic_load (&ev->seq);
+}
+
+/**
+ * The retry succeeded after all.
+ */
+static void ring_event_cancel (struct ring_event *ev)
+{
+	atomic_fetch_sub (&ev->waiters, 1);
+}
+
+/**
+ * Sleep unless the event has been signalled since `key` was taken.
+ */
+static void ring_event_commit (struct ring_event *ev, uint32_t key)
+{
+	syscall (SYS_futex, &ev->seq, FUTEX_WAIT | ev->futex_flags, key, NULL, NULL, 0);
+
+	atomic_fetch_sub (&ev->waiters, 1);
+}
+
+int ring_init (ring_t *rp, int n, bool pshared)
+{
+	assert (rp);
+	assert (n > 0);
+
+	rp->buf = pshared
+		? shared_alloc (n * sizeof (*rp->buf))
+		: calloc (n, sizeof (*rp->buf));
+	if (rp->buf == NULL) return -1;
+
+	rp->n = n;
+	rp->pshared = pshared;
+
+	for (size_t i = 0; i < rp->n; ++i)
+		atomic_init (&rp->buf[i].seq, i);
+
+	atomic_init (&rp->rear, 0);
+	atomic_init (&rp->front, 0);
+
+	ring_event_init (&rp->items, pshared);
+	ring_event_init (&rp->slots, pshared);
+
+	return 0;
+}
+
+void ring_deinit (ring_t *rp)
+{
+	assert (rp);
+
+	if (!rp->pshared)
+		free (rp->buf);
+}
+
+bool ring_try_insert (ring_t *rp, void *item)
+{
+	assert (rp);
+
+	size_t pos = atomic_load_explicit (&rp->rear, memory_order_relaxed);
+	struct ring_cell *cell;
+
+	while (1)
+	{
+		cell = &rp->buf[pos % rp->n];
+
+		size_t seq = atomic_load_explicit (&cell->seq, memory_order_acquire);
+		intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit
+				( &rp->rear
+				, &pos
+				, pos + 1
+				, memory_order_relaxed
+				, memory_order_relaxed
+				))
+				break;
+		}
+		else if (diff < 0)
+		{
+			/* the consumer of the previous lap hasn't been here yet */
+			return false;
+		}
+		else
+		{
+			pos = atomic_load_explicit (&rp->rear, memory_order_relaxed);
+		}
+	}
+
+	cell->item = item;
+	atomic_store_explicit (&cell->seq, pos + 1, memory_order_release);
+
+	ring_event_signal (&rp->items);
+
+	return true;
+}
+
+bool ring_try_remove (ring_t *rp, void **item)
+{
+	assert (rp);
+	assert (item);
+
+	size_t pos = atomic_load_explicit (&rp->front, memory_order_relaxed);
+	struct ring_cell *cell;
+
+	while (1)
+	{
+		cell = &rp->buf[pos % rp->n];
+
+		size_t seq = atomic_load_explicit (&cell->seq, memory_order_acquire);
+		intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit
+				( &rp->front
+				, &pos
+				, pos + 1
+				, memory_order_relaxed
+				, memory_order_relaxed
+				))
+				break;
+		}
+		else if (diff < 0)
+		{
+			/* nothing has been inserted here yet */
+			return false;
+		}
+		else
+		{
+			pos = atomic_load_explicit (&rp->front, memory_order_relaxed);
+		}
+	}
+
+	*item = cell->item;
+	atomic_store_explicit (&cell->seq, pos + rp->n, memory_order_release);
+
+	ring_event_signal (&rp->slots);
+
+	return true;
+}
+
+void ring_insert (ring_t *rp, void *item)
+{
+	assert (rp);
+
+	while (!ring_try_insert (rp, item))
+	{
+		uint32_t key = ring_event_prepare (&rp->slots);
+
+		if (ring_try_insert (rp, item))
+		{
+			ring_event_cancel (&rp->slots);
+			return;
+		}
+
+		ring_event_commit (&rp->slots, key);
+	}
+}
+
+void *ring_remove (ring_t *rp)
+{
+	assert (rp);
+
+	void *item;
+
+	while (!ring_try_remove (rp, &item))
+	{
+		uint32_t key = ring_event_prepare (&rp->items);
+
+		if (ring_try_remove (rp, &item))
+		{
+			ring_event_cancel (&rp->items);
+			break;
+		}
+
+		ring_event_commit (&rp->items, key);
+	}
+
+	return item;
+}
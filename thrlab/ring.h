@@ -0,0 +1,87 @@
+#ifndef _THRLAB_RING_H_
+#define _THRLAB_RING_H_
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RING_CACHE_LINE 64
+
+/**
+ * A slot in the ring. `seq` tells whose turn it is: the producer of position
+ * `pos` may fill the slot when `seq == pos`, the consumer when
+ * `seq == pos + 1`.
+ */
+struct ring_cell
+{
+	_Atomic size_t seq;
+	void *item;
+};
+
+/**
+ * Parking spot for threads that found the ring full (or empty). Only touched
+ * on the slow path.
+ */
+struct ring_event
+{
+	_Atomic uint32_t seq; /* futex word, bumped on every wake-up */
+	_Atomic uint32_t waiters;
+	int futex_flags; /* FUTEX_PRIVATE_FLAG, unless shared between processes */
+};
+
+/**
+ * A bounded multi-producer/multi-consumer FIFO, after Dmitry Vyukov's
+ * sequence-numbered queue. Inserting and removing are lock-free; the blocking
+ * variants only sleep while the ring is actually full or empty.
+ */
+typedef struct
+{
+	struct ring_cell *buf;
+	size_t n; /* maximum number of items */
+	bool pshared; /* buf is in the shared segment */
+
+	alignas (RING_CACHE_LINE) _Atomic size_t rear; /* next insert position */
+	alignas (RING_CACHE_LINE) _Atomic size_t front; /* next remove position */
+
+	alignas (RING_CACHE_LINE) struct ring_event items; /* consumers park */
+	alignas (RING_CACHE_LINE) struct ring_event slots; /* producers park */
+} ring_t;
+
+/**
+ * Create an empty ring holding at most `n` items. With `pshared`, `rp` must
+ * be in shared memory: the cells go in the shared segment and the ring may
+ * be used from processes forked afterwards.
+ *
+ * Returns 0 on success.
+ */
+int ring_init (ring_t *rp, int n, bool pshared);
+
+/**
+ * Release the memory held by the ring.
+ */
+void ring_deinit (ring_t *rp);
+
+/**
+ * Insert `item` at the rear, waiting while the ring is full.
+ */
+void ring_insert (ring_t *rp, void *item);
+
+/**
+ * Remove and return the front item, waiting while the ring is empty.
+ */
+void *ring_remove (ring_t *rp);
+
+/**
+ * Insert `item` unless the ring is full. Returns whether it was inserted.
+ */
+bool ring_try_insert (ring_t *rp, void *item);
+
+/**
+ * Remove the front item into `*item` unless the ring is empty. Returns
+ * whether an item was removed.
+ */
+bool ring_try_remove (ring_t *rp, void **item);
+
+#endif
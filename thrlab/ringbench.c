@@ -0,0 +1,256 @@
+#define _DEFAULT_SOURCE
+#include <argp.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ring.h"
+#include "sbuf.h"
+
+/******************************************************************************
+ * Contention microbenchmark: sbuf_t vs ring_t
+ *****************************************************************************/
+
+struct arguments
+{
+	size_t ops;
+	size_t capacity;
+	size_t max_threads;
+};
+
+struct queue
+{
+	const char *name;
+	void (*insert) (void *q, void *item);
+	void *(*remove) (void *q);
+	void *q;
+};
+
+struct worker
+{
+	pthread_t thread;
+	struct queue *queue;
+	pthread_barrier_t *barrier;
+	size_t ops;
+	int produce; /* 1 inserts, 0 removes, -1 alternates */
+};
+
+static void queue_sbuf_insert (void *q, void *item)
+{
+	sbuf_insert (q, item);
+}
+
+static void *queue_sbuf_remove (void *q)
+{
+	return sbuf_remove (q);
+}
+
+static void queue_ring_insert (void *q, void *item)
+{
+	ring_insert (q, item);
+}
+
+static void *queue_ring_remove (void *q)
+{
+	return ring_remove (q);
+}
+
+static void *worker_run (void *arg)
+{
+	struct worker *w = arg;
+	struct queue *queue = w->queue;
+
+	pthread_barrier_wait (w->barrier);
+
+	for (size_t i = 0; i < w->ops; ++i)
+	{
+		if (w->produce != 0)
+			queue->insert (queue->q, (void *) (uintptr_t) (i + 1));
+
+		if (w->produce != 1)
+			queue->remove (queue->q);
+	}
+
+	return NULL;
+}
+
+static double now ()
+{
+	struct timespec ts;
+
+	int status = clock_gettime (CLOCK_MONOTONIC, &ts);
+	assert (status == 0);
+
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Run `threads` threads against the queue and return the number of
+ * insert/remove pairs per second.
+ */
+static double run (struct queue *queue, size_t threads, size_t ops)
+{
+	pthread_barrier_t barrier;
+	struct worker *workers = calloc (threads, sizeof (*workers));
+	assert (workers);
+
+	pthread_barrier_init (&barrier, NULL, threads + 1);
+
+	/* half produce, half consume; a lone thread does both */
+	size_t producers = (threads + 1) / 2;
+	size_t consumers = threads - producers;
+
+	for (size_t i = 0; i < threads; ++i)
+	{
+		struct worker *w = &workers[i];
+		size_t share, index;
+
+		if (threads == 1)
+		{
+			w->produce = -1;
+			share = 1;
+			index = 0;
+		}
+		else if (i < producers)
+		{
+			w->produce = 1;
+			share = producers;
+			index = i;
+		}
+		else
+		{
+			w->produce = 0;
+			share = consumers;
+			index = i - producers;
+		}
+
+		/* spread the remainder so producers and consumers agree */
+		w->ops = ops / share + (index < ops % share);
+		w->queue = queue;
+		w->barrier = &barrier;
+
+		int status = pthread_create (&w->thread, NULL, worker_run, w);
+		assert (status == 0);
+	}
+
+	pthread_barrier_wait (&barrier);
+	double start = now ();
+
+	for (size_t i = 0; i < threads; ++i)
+		pthread_join (workers[i].thread, NULL);
+
+	double elapsed = now () - start;
+
+	pthread_barrier_destroy (&barrier);
+	free (workers);
+
+	return ops / elapsed;
+}
+
+static error_t argparse_opt
+	( int key
+	, char *arg
+	, struct argp_state *state
+	)
+{
+	struct arguments *arguments = state->input;
+	char *end;
+
+	switch (key)
+	{
+		case 'n':
+			arguments->ops = strtoul (arg, &end, 10);
+			if (*end || arguments->ops == 0) argp_usage (state);
+			break;
+		case 'q':
+			arguments->capacity = strtoul (arg, &end, 10);
+			if (*end || arguments->capacity == 0) argp_usage (state);
+			break;
+		case 't':
+			arguments->max_threads = strtoul (arg, &end, 10);
+			if (*end || arguments->max_threads == 0) argp_usage (state);
+			break;
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+
+	return 0;
+}
+
+static struct arguments argparse (int argc, char **argv)
+{
+	const struct argp argp =
+		{ .options = (struct argp_option [])
+			{ { .name = "ops", .key = 'n', .arg = "NUM"
+			  , .doc = "Items passed through the queue per run"
+			           " [default = 1000000]"
+			  }
+			, { .name = "capacity", .key = 'q', .arg = "NUM"
+			  , .doc = "Queue capacity [default = 64]"
+			  }
+			, { .name = "threads", .key = 't', .arg = "NUM"
+			  , .doc = "Largest thread count, doubling from 1 [default = 64]"
+			  }
+			, { .name = NULL }
+			}
+		, .parser = argparse_opt
+		, .doc = "thrlab-ringbench -- sbuf_t against the lock-free ring"
+		};
+
+	struct arguments arguments = (struct arguments)
+		{ .ops = 1000000
+		, .capacity = 64
+		, .max_threads = 64
+		};
+
+	argp_parse (&argp, argc, argv, 0, NULL, &arguments);
+
+	return arguments;
+}
+
+int main (int argc, char **argv)
+{
+	struct arguments arguments = argparse (argc, argv);
+
+	sbuf_t sbuf;
+	ring_t ring;
+
+	struct queue queues[] =
+		{ { "sbuf", queue_sbuf_insert, queue_sbuf_remove, &sbuf }
+		, { "ring", queue_ring_insert, queue_ring_remove, &ring }
+		};
+
+	printf ("%7s %14s %14s %8s\n", "threads", "sbuf ops/s", "ring ops/s", "speedup");
+
+	for (size_t threads = 1; threads <= arguments.max_threads; threads *= 2)
+	{
+		double rate[2];
+
+		for (size_t i = 0; i < 2; ++i)
+		{
+			if (sbuf_init (&sbuf, arguments.capacity, 0) != 0
+				|| ring_init (&ring, arguments.capacity, false) != 0)
+			{
+				perror ("thrlab-ringbench");
+				return EXIT_FAILURE;
+			}
+
+			rate[i] = run (&queues[i], threads, arguments.ops);
+
+			ring_deinit (&ring);
+			sbuf_deinit (&sbuf);
+		}
+
+		printf
+			( "%7zu %14.0f %14.0f %7.2fx\n"
+			, threads
+			, rate[0]
+			, rate[1]
+			, rate[1] / rate[0]
+			);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+#include <semaphore.h>
+#include <stdlib.h>
+#include "sbuf.h"
+#include "shared.h"
+
+/* Create an empty, bounded, shared FIFO buffer with nslots; with pshared,
+   sp must be in shared memory and the buffer goes there too; returns 0, or
+   -1 when there's no memory for the buffer */
+int sbuf_init(sbuf_t *sp, int n, int pshared)
+{
+    if (pshared)
+        sp->buf = shared_alloc(n * sizeof(void *));
+    else
+        sp->buf = calloc(n, sizeof(void *));
+    if (sp->buf == NULL)
+        return -1;
+    sp->n= n; /* Buffer holds max of nitems */
+    sp->front = sp->rear = 0; /* Empty buffer ifffront == rear */
+    sp->pshared = pshared;
+    sem_init(&sp->mutex, pshared, 1); /* Binary semaphore for locking */
+    sem_init(&sp->slots, pshared, n); /* Initially, bufhas nempty slots */
+    sem_init(&sp->items, pshared, 0); /* Initially, bufhas zero items */
+    sp->inserts = sp->removes = NULL; /* Not profiled */
+    return 0;
+}
+/* Clean up buffer sp */
+void sbuf_deinit(sbuf_t *sp)
+{
+    if (!sp->pshared) /* Goes with the shared segment */
+        free(sp->buf);
+}
+
+/* Profile the mutex, telling inserts and removes apart */
+void sbuf_profile(sbuf_t *sp, struct lockprof *inserts, struct lockprof *removes)
+{
+    sp->inserts = inserts;
+    sp->removes = removes;
+}
+
+/* Insert item onto the rear of shared buffer sp */
+void sbuf_insert(sbuf_t *sp, void *item)
+{
+    sem_wait(&sp->slots); /* Wait for available slot */
+    lockprof_sem_wait(sp->inserts, &sp->mutex); /* Lock the buffer */
+    sp->buf[(++sp->rear)%(sp->n)] = item; /* Insert the item */
+    lockprof_sem_post(sp->inserts, &sp->mutex); /* Unlock the buffer */
+    sem_post(&sp->items); /* Announce available item */
+}
+
+/* Remove and return the first item from buffer sp */
+void *sbuf_remove(sbuf_t *sp)
+{
+    void *item;
+    sem_wait(&sp->items); /* Wait for available item */
+    lockprof_sem_wait(sp->removes, &sp->mutex); /* Lock the buffer */
+    item = sp->buf[(++sp->front)%(sp->n)]; /* Remove the item */
+    lockprof_sem_post(sp->removes, &sp->mutex); /* Unlock the buffer */
+    sem_post(&sp->slots); /* Announce available slot */
+    return item;
+}
+
+/* Remove and return the first item from buffer sp, or NULL if it's empty */
+void *sbuf_try_remove(sbuf_t *sp)
+{
+    void *item;
+    if (sem_trywait(&sp->items) != 0) /* Nothing there */
+        return NULL;
+    lockprof_sem_wait(sp->removes, &sp->mutex); /* Lock the buffer */
+    item = sp->buf[(++sp->front)%(sp->n)]; /* Remove the item */
+    lockprof_sem_post(sp->removes, &sp->mutex); /* Unlock the buffer */
+    sem_post(&sp->slots); /* Announce available slot */
+    return item;
+}
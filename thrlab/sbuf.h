@@ -0,0 +1,28 @@
+#ifndef _THRLAB_SBUF_H_
+#define _THRLAB_SBUF_H_
+
+#include <semaphore.h>
+#include <stddef.h>
+#include "lockprof.h"
+
+typedef struct{
+    void **buf; /* Buffer array */
+    int n; /* Maximum number of slots */
+    size_t front; /* buf[(front+1)%n] is first item */
+    size_t rear; /* buf[rear%n] is last item */
+    sem_t mutex; /* Protects accesses to buf*/
+    sem_t slots; /* Counts available slots */
+    sem_t items; /* Counts available items */
+    int pshared; /* Shared with forked processes, buf included */
+    struct lockprof *inserts; /* Where to profile the mutex, or NULL */
+    struct lockprof *removes;
+} sbuf_t;
+
+int sbuf_init(sbuf_t *sp, int n, int pshared);
+void sbuf_deinit(sbuf_t *sp);
+void sbuf_profile(sbuf_t *sp, struct lockprof *inserts, struct lockprof *removes);
+void sbuf_insert(sbuf_t *sp, void *item);
+void *sbuf_remove(sbuf_t *sp);
+void *sbuf_try_remove(sbuf_t *sp);
+
+#endif
@@ -0,0 +1,117 @@
+#define _DEFAULT_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "shared.h"
+
+static struct
+{
+	bool enabled;
+	char *base;
+	size_t size;
+
+	/* bytes handed out; the segment's own processes may all allocate */
+	_Atomic size_t *used;
+} segment =
+	{ .enabled = false
+	};
+
+int shared_open (size_t size)
+{
+	assert (!segment.enabled);
+	assert (size > 0);
+
+	int status;
+	char name[64];
+
+	/* room for the allocation counter, on its own line */
+	size = (size + SHARED_ALIGN - 1) / SHARED_ALIGN * SHARED_ALIGN + SHARED_ALIGN;
+
+	snprintf (name, sizeof (name), "/thrlab-%ld", (long) getpid ());
+
+	int fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd == -1) goto error_open;
+
+	/* nobody else needs to find it by name */
+	shm_unlink (name);
+
+	status = ftruncate (fd, size);
+	if (status != 0) goto error_truncate;
+
+	segment.base = mmap
+		( NULL
+		, size
+		, PROT_READ | PROT_WRITE
+		, MAP_SHARED
+		, fd
+		, 0
+		);
+	if (segment.base == MAP_FAILED) goto error_truncate;
+
+	close (fd);
+
+	segment.size = size;
+	segment.used = (_Atomic size_t *) segment.base;
+	atomic_init (segment.used, SHARED_ALIGN);
+	segment.enabled = true;
+
+	return 0;
+
+error_truncate:
+	close (fd);
+
+error_open:
+	perror ("shared memory");
+	return -1;
+}
+
+bool shared_enabled ()
+{
+	return segment.enabled;
+}
+
+void *shared_alloc (size_t size)
+{
+	assert (segment.enabled);
+
+	size = (size + SHARED_ALIGN - 1) / SHARED_ALIGN * SHARED_ALIGN;
+
+	size_t offset = atomic_fetch_add (segment.used, size);
+
+	if (offset + size > segment.size)
+		return NULL;
+
+	/* fresh pages of the segment read as zero */
+	return segment.base + offset;
+}
+
+bool shared_contains (const void *p)
+{
+	return segment.enabled
+		&& (const char *) p >= segment.base
+		&& (const char *) p < segment.base + segment.size;
+}
+
+size_t shared_used ()
+{
+	if (!segment.enabled)
+		return 0;
+
+	size_t used = atomic_load (segment.used);
+
+	/* the counter's own line doesn't count */
+	return ((used < segment.size) ? used : segment.size) - SHARED_ALIGN;
+}
+
+void shared_close ()
+{
+	if (!segment.enabled)
+		return;
+
+	segment.enabled = false;
+	munmap (segment.base, segment.size);
+}
@@ -0,0 +1,53 @@
+#ifndef _THRLAB_SHARED_H_
+#define _THRLAB_SHARED_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SHARED_ALIGN 64
+
+/**
+ * One POSIX shared memory segment for the process and everything it forks
+ * afterwards. Children inherit the mapping at the same address, so pointers
+ * into the segment can be handed between processes as they are.
+ *
+ * The segment is unlinked as soon as it's mapped, so it goes away with the
+ * last process using it, however that process ends.
+ */
+
+/**
+ * Create and map a segment of `size` bytes. There's only ever one.
+ *
+ * Returns 0 on success.
+ */
+int shared_open (size_t size);
+
+/**
+ * Whether a segment is mapped.
+ */
+bool shared_enabled ();
+
+/**
+ * Carve `size` zeroed bytes, aligned to SHARED_ALIGN, out of the segment.
+ * Memory is never given back but with the whole segment.
+ *
+ * Returns NULL once the segment is full.
+ */
+void *shared_alloc (size_t size);
+
+/**
+ * Whether `p` points into the segment.
+ */
+bool shared_contains (const void *p);
+
+/**
+ * Bytes handed out so far.
+ */
+size_t shared_used ();
+
+/**
+ * Unmap the segment; nothing in it may be used afterwards.
+ */
+void shared_close ();
+
+#endif
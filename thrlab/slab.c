@@ -0,0 +1,110 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "slab.h"
+
+int slab_init (struct slab *slab, size_t size, size_t capacity)
+{
+	assert (slab);
+	assert (size > 0);
+	assert (capacity > 0);
+
+	if (size < sizeof (struct slab_free))
+		size = sizeof (struct slab_free);
+
+	slab->size = (size + SLAB_ALIGN - 1) / SLAB_ALIGN * SLAB_ALIGN;
+	slab->capacity = capacity;
+	slab->fresh = 0;
+	slab->local = NULL;
+	atomic_init (&slab->remote, NULL);
+
+	slab->allocs = 0;
+	atomic_init (&slab->frees, 0);
+	slab->peak = 0;
+
+	/* pages are only touched as objects are first handed out */
+	slab->mem = aligned_alloc (SLAB_ALIGN, slab->size * capacity);
+	if (slab->mem == NULL) return -1;
+
+	return 0;
+}
+
+void *slab_alloc (struct slab *slab)
+{
+	assert (slab);
+
+	void *obj;
+
+	if (slab->local == NULL)
+	{
+		slab->local = atomic_exchange_explicit
+			( &slab->remote
+			, NULL
+			, memory_order_acquire
+			);
+	}
+
+	if (slab->local)
+	{
+		obj = slab->local;
+		slab->local = slab->local->next;
+	}
+	else if (slab->fresh < slab->capacity)
+	{
+		obj = slab->mem + slab->fresh++ * slab->size;
+	}
+	else
+	{
+		return NULL;
+	}
+
+	size_t live = ++slab->allocs - atomic_load_explicit
+		( &slab->frees
+		, memory_order_relaxed
+		);
+
+	if (live > slab->peak)
+		slab->peak = live;
+
+	return obj;
+}
+
+void slab_free (struct slab *slab, void *obj)
+{
+	assert (slab);
+
+	if (obj == NULL)
+		return;
+
+	assert ((char *) obj >= slab->mem);
+	assert ((char *) obj < slab->mem + slab->capacity * slab->size);
+
+	struct slab_free *node = obj;
+
+	node->next = atomic_load_explicit (&slab->remote, memory_order_relaxed);
+
+	while (!atomic_compare_exchange_weak_explicit
+		( &slab->remote
+		, &node->next
+		, node
+		, memory_order_release
+		, memory_order_relaxed
+		))
+		;
+
+	atomic_fetch_add_explicit (&slab->frees, 1, memory_order_relaxed);
+}
+
+size_t slab_reserved (const struct slab *slab)
+{
+	assert (slab);
+
+	return slab->size * slab->capacity;
+}
+
+void slab_destroy (struct slab *slab)
+{
+	assert (slab);
+
+	free (slab->mem);
+	slab->mem = NULL;
+}
@@ -0,0 +1,72 @@
+#ifndef _THRLAB_SLAB_H_
+#define _THRLAB_SLAB_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define SLAB_ALIGN 64
+
+/**
+ * An object freed back to a slab, threaded through the object itself.
+ */
+struct slab_free
+{
+	struct slab_free *next;
+};
+
+/**
+ * A preallocated arena of equal, cache-line-aligned objects.
+ *
+ * Objects are handed out by a single allocating thread but may be freed from
+ * any thread. Frees are pushed onto a shared lock-free list, which the
+ * allocator takes over wholesale whenever its private list runs dry, so no
+ * two threads ever contend on the same object.
+ */
+struct slab
+{
+	char *mem;
+	size_t size; /* bytes per object, rounded up to whole cache lines */
+	size_t capacity;
+	size_t fresh; /* objects never handed out start here */
+
+	/* the allocator's own free objects */
+	struct slab_free *local;
+
+	/* objects freed by anyone, not yet taken over by the allocator */
+	_Atomic (struct slab_free *) remote;
+
+	/* statistics */
+	size_t allocs;
+	_Atomic size_t frees;
+	size_t peak; /* most objects live at once */
+};
+
+/**
+ * Reserve room for `capacity` objects of `size` bytes.
+ *
+ * Returns 0 on success.
+ */
+int slab_init (struct slab *slab, size_t size, size_t capacity);
+
+/**
+ * Hand out an object, or NULL when all `capacity` are live. Only one thread
+ * may allocate from a slab.
+ */
+void *slab_alloc (struct slab *slab);
+
+/**
+ * Give `obj` back. Safe from any thread.
+ */
+void slab_free (struct slab *slab, void *obj);
+
+/**
+ * Bytes reserved for the slab.
+ */
+size_t slab_reserved (const struct slab *slab);
+
+/**
+ * Release the arena; every object goes with it.
+ */
+void slab_destroy (struct slab *slab);
+
+#endif
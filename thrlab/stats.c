@@ -0,0 +1,278 @@
+#define _DEFAULT_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "stats.h"
+
+static struct
+{
+	bool enabled;
+	int fd;
+	size_t size; /* bytes mapped */
+	struct stats_page *page;
+
+	unsigned int interval_ms;
+	stats_fill_fn *fill;
+
+	pthread_t publisher;
+	pthread_mutex_t mtx;
+	pthread_cond_t wake;
+	bool stopping;
+} publisher =
+	{ .enabled = false
+	, .mtx = PTHREAD_MUTEX_INITIALIZER
+	};
+
+size_t stats_size (unsigned int rooms)
+{
+	return sizeof (struct stats_page) + rooms * sizeof (uint64_t);
+}
+
+/**
+ * Rewrite the page under the seqlock.
+ */
+static void stats_publish (bool open)
+{
+	struct stats_page *page = publisher.page;
+	uint64_t seq = atomic_load_explicit (&page->seq, memory_order_relaxed);
+
+	atomic_store_explicit (&page->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence (memory_order_release);
+
+	publisher.fill (&page->ns, page->counters, page->occupants);
+	page->open = open;
+
+	atomic_store_explicit (&page->seq, seq + 2, memory_order_release);
+}
+
+static void *stats_publisher (void *arg)
+{
+	(void) arg;
+
+	int status;
+
+	status = pthread_mutex_lock (&publisher.mtx);
+	assert (status == 0);
+
+	while (!publisher.stopping)
+	{
+		struct timespec deadline;
+
+		status = clock_gettime (CLOCK_MONOTONIC, &deadline);
+		assert (status == 0);
+
+		deadline.tv_nsec += (long) publisher.interval_ms * 1000000;
+		deadline.tv_sec += deadline.tv_nsec / 1000000000;
+		deadline.tv_nsec %= 1000000000;
+
+		status = pthread_cond_timedwait (&publisher.wake, &publisher.mtx, &deadline);
+		assert (status == 0 || status == ETIMEDOUT);
+
+		if (!publisher.stopping)
+			stats_publish (true);
+	}
+
+	status = pthread_mutex_unlock (&publisher.mtx);
+	assert (status == 0);
+
+	return NULL;
+}
+
+int stats_open
+	( const char *path
+	, unsigned int rooms
+	, const char *const *names
+	, size_t num_counters
+	, unsigned int interval_ms
+	, stats_fill_fn *fill
+	)
+{
+	assert (path);
+	assert (names);
+	assert (num_counters <= STATS_COUNTERS);
+	assert (interval_ms > 0);
+	assert (fill);
+
+	int status;
+
+	publisher.fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (publisher.fd == -1) goto error_open;
+
+	publisher.size = stats_size (rooms);
+
+	status = ftruncate (publisher.fd, publisher.size);
+	if (status != 0) goto error_truncate;
+
+	publisher.page = mmap
+		( NULL
+		, publisher.size
+		, PROT_READ | PROT_WRITE
+		, MAP_SHARED
+		, publisher.fd
+		, 0
+		);
+	if (publisher.page == MAP_FAILED) goto error_truncate;
+
+	struct stats_page *page = publisher.page;
+
+	page->version = STATS_VERSION;
+	page->pid = getpid ();
+	page->rooms = rooms;
+	page->num_counters = num_counters;
+	atomic_init (&page->seq, 0);
+
+	for (size_t i = 0; i < num_counters; ++i)
+		snprintf (page->names[i], STATS_NAME, "%s", names[i]);
+
+	publisher.interval_ms = interval_ms;
+	publisher.fill = fill;
+	publisher.stopping = false;
+
+	/* so a wall clock step doesn't stall or rush the page */
+	pthread_condattr_t cattr;
+
+	pthread_condattr_init (&cattr);
+	pthread_condattr_setclock (&cattr, CLOCK_MONOTONIC);
+
+	status = pthread_cond_init (&publisher.wake, &cattr);
+	pthread_condattr_destroy (&cattr);
+	if (status != 0) goto error_cond;
+
+	stats_publish (true);
+
+	/* readers check the magic last */
+	atomic_thread_fence (memory_order_release);
+	memcpy (page->magic, STATS_MAGIC, sizeof (page->magic));
+
+	status = pthread_create (&publisher.publisher, NULL, stats_publisher, NULL);
+	if (status != 0) goto error_thread;
+
+	publisher.enabled = true;
+
+	return 0;
+
+error_thread:
+	pthread_cond_destroy (&publisher.wake);
+
+error_cond:
+	munmap (publisher.page, publisher.size);
+
+error_truncate:
+	close (publisher.fd);
+
+error_open:
+	perror (path);
+	return -1;
+}
+
+void stats_close ()
+{
+	if (!publisher.enabled)
+		return;
+
+	int status;
+
+	status = pthread_mutex_lock (&publisher.mtx);
+	assert (status == 0);
+
+	publisher.stopping = true;
+
+	status = pthread_cond_signal (&publisher.wake);
+	assert (status == 0);
+
+	status = pthread_mutex_unlock (&publisher.mtx);
+	assert (status == 0);
+
+	status = pthread_join (publisher.publisher, NULL);
+	assert (status == 0);
+
+	stats_publish (false);
+
+	pthread_cond_destroy (&publisher.wake);
+	munmap (publisher.page, publisher.size);
+	close (publisher.fd);
+	publisher.enabled = false;
+}
+
+int stats_map (const char *path, const struct stats_page **page, size_t *size)
+{
+	assert (path);
+	assert (page);
+	assert (size);
+
+	struct stat st;
+	int error = EINVAL;
+
+	int fd = open (path, O_RDONLY);
+	if (fd == -1) return -1;
+
+	if (fstat (fd, &st) != 0) goto error_stat;
+
+	if ((size_t) st.st_size < sizeof (struct stats_page)) goto error_format;
+
+	const struct stats_page *map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) goto error_stat;
+
+	if (memcmp (map->magic, STATS_MAGIC, sizeof (map->magic)) != 0
+		|| map->version != STATS_VERSION
+		|| map->num_counters > STATS_COUNTERS
+		|| stats_size (map->rooms) != (size_t) st.st_size)
+	{
+		munmap ((void *) map, st.st_size);
+		goto error_format;
+	}
+
+	close (fd);
+
+	*page = map;
+	*size = st.st_size;
+
+	return 0;
+
+error_stat:
+	error = errno;
+
+error_format:
+	close (fd);
+	errno = error;
+	return -1;
+}
+
+void stats_snapshot (const struct stats_page *page, size_t size, struct stats_page *copy)
+{
+	assert (page);
+	assert (copy);
+
+	size_t body = offsetof (struct stats_page, ns);
+
+	while (1)
+	{
+		uint64_t before = atomic_load_explicit (&page->seq, memory_order_acquire);
+
+		if (before & 1)
+		{
+			sched_yield ();
+			continue;
+		}
+
+		memcpy ((char *) copy + body, (const char *) page + body, size - body);
+		atomic_thread_fence (memory_order_acquire);
+
+		if (atomic_load_explicit (&page->seq, memory_order_relaxed) == before)
+			break;
+	}
+
+	/* the header never changes */
+	memcpy (copy, page, offsetof (struct stats_page, seq));
+	atomic_init (&copy->seq, 0);
+}
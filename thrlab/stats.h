@@ -0,0 +1,85 @@
+#ifndef _THRLAB_STATS_H_
+#define _THRLAB_STATS_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATS_MAGIC "THRSTATS"
+#define STATS_VERSION 1
+
+#define STATS_COUNTERS 64
+#define STATS_NAME 32
+
+/* an empty room */
+#define STATS_NOBODY UINT64_MAX
+
+/**
+ * A live stats file, mapped by the shop and by anyone watching it. The
+ * header is written once at opening; everything from `ns` on is rewritten
+ * under the seqlock `seq`, which is odd while a rewrite is under way.
+ */
+struct stats_page
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t pid;
+	uint32_t rooms;
+	uint32_t num_counters;
+	char names[STATS_COUNTERS][STATS_NAME];
+
+	_Atomic uint64_t seq;
+
+	uint64_t ns; /* nanoseconds since the shop opened */
+	uint64_t open; /* cleared by the last rewrite, at closing */
+	uint64_t counters[STATS_COUNTERS];
+	uint64_t occupants[]; /* customer id per room, or STATS_NOBODY */
+};
+
+/**
+ * Fill in the latest figures: the time since opening, `num_counters` values
+ * in the order they were named, and the occupant of each room.
+ */
+typedef void stats_fill_fn (uint64_t *ns, uint64_t *counters, uint64_t *occupants);
+
+/**
+ * Map a stats file at `path` with `rooms` rooms and the given counter names,
+ * and rewrite it from `fill` every `interval_ms` milliseconds on a thread of
+ * its own.
+ *
+ * Returns 0 on success.
+ */
+int stats_open
+	( const char *path
+	, unsigned int rooms
+	, const char *const *names
+	, size_t num_counters
+	, unsigned int interval_ms
+	, stats_fill_fn *fill
+	);
+
+/**
+ * Stop rewriting, publish the figures one last time marked closed, and unmap
+ * the file. It stays on disk for a last look.
+ */
+void stats_close ();
+
+/**
+ * Size in bytes of a stats page with `rooms` rooms.
+ */
+size_t stats_size (unsigned int rooms);
+
+/**
+ * Map the stats file at `path` read-only into `*page`, `*size` bytes.
+ *
+ * Returns 0 on success, or -1 with errno set; EINVAL means the file isn't a
+ * stats file.
+ */
+int stats_map (const char *path, const struct stats_page **page, size_t *size);
+
+/**
+ * Copy a consistent view of `page` into `copy`, which must be as large.
+ */
+void stats_snapshot (const struct stats_page *page, size_t size, struct stats_page *copy);
+
+#endif
@@ -0,0 +1,233 @@
+#define _DEFAULT_SOURCE
+#include <argp.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "names.h"
+#include "stats.h"
+
+/******************************************************************************
+ * thrlab-top: watch a shop through the file it keeps with thrlab --stats
+ *****************************************************************************/
+
+struct arguments
+{
+	unsigned int interval_ms;
+	int once;
+	const char *path;
+};
+
+enum key
+{
+	KEY_ONCE = 0x100
+};
+
+/**
+ * The value of the counter called `name`, or 0 if there's none.
+ */
+static uint64_t counter (const struct stats_page *page, const char *name)
+{
+	for (size_t i = 0; i < page->num_counters; ++i)
+	{
+		if (strncmp (page->names[i], name, STATS_NAME) == 0)
+			return page->counters[i];
+	}
+
+	return 0;
+}
+
+/**
+ * Print one screenful; `last` is the previous view, for recent throughput.
+ */
+static void print_view (const struct stats_page *page, const struct stats_page *last)
+{
+	double seconds = page->ns / 1000000000.0;
+	uint64_t served = counter (page, "customers.served");
+
+	printf
+		( "thrlab %u, %s %.1f s\n\n"
+		, page->pid
+		, page->open ? "open for" : "closed after"
+		, seconds
+		);
+
+	printf
+		( "Customers   %llu arrived, %llu served, %.2f haircuts/s"
+		, (unsigned long long) counter (page, "customers.arrived")
+		, (unsigned long long) served
+		, seconds > 0 ? served / seconds : 0.0
+		);
+
+	if (last && page->ns > last->ns)
+	{
+		uint64_t recent = served - counter (last, "customers.served");
+
+		printf (" (%.2f/s lately)", recent / ((page->ns - last->ns) / 1000000000.0));
+	}
+
+	printf
+		( "\nIn the shop %llu cutting, %llu waiting, %llu pending\n"
+		, (unsigned long long) counter (page, "live.cutting")
+		, (unsigned long long) counter (page, "live.waiting")
+		, (unsigned long long) counter (page, "live.pending")
+		);
+
+	printf
+		( "Barbers     %u, %llu on duty\n\n"
+		, page->rooms
+		, (unsigned long long) counter (page, "live.on_duty")
+		);
+
+	for (unsigned int room = 0; room < page->rooms; ++room)
+	{
+		printf ("  room %2u %-14s ", room, barber_name (room));
+
+		if (page->occupants[room] == STATS_NOBODY)
+			printf ("-\n");
+		else
+			printf ("#%llu\n", (unsigned long long) page->occupants[room]);
+	}
+
+	int complaints = 0;
+
+	for (size_t i = 0; i < page->num_counters; ++i)
+	{
+		if (strncmp (page->names[i], "complaint.", 10) != 0 || page->counters[i] == 0)
+			continue;
+
+		if (complaints++ == 0)
+			printf ("\nComplaints\n");
+
+		printf
+			( "  %-24s %llu\n"
+			, page->names[i] + 10
+			, (unsigned long long) page->counters[i]
+			);
+	}
+
+	if (complaints == 0)
+		printf ("\nNo complaints\n");
+}
+
+static error_t argparse_opt
+	( int key
+	, char *arg
+	, struct argp_state *state
+	)
+{
+	struct arguments *arguments = state->input;
+	char *end;
+
+	switch (key)
+	{
+		case 'i':
+			arguments->interval_ms = strtoul (arg, &end, 10);
+			if (*end || arguments->interval_ms < 1) argp_usage (state);
+			break;
+		case KEY_ONCE:
+			arguments->once = 1;
+			break;
+		case ARGP_KEY_ARG:
+			if (arguments->path) argp_usage (state);
+			arguments->path = arg;
+			break;
+		case ARGP_KEY_END:
+			if (arguments->path == NULL) argp_usage (state);
+			break;
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+
+	return 0;
+}
+
+int main (int argc, char **argv)
+{
+	const struct argp argp =
+		{ .options = (struct argp_option [])
+			{ { .name = "interval", .key = 'i', .arg = "MS"
+			  , .doc = "Milliseconds between refreshes [default = 500]"
+			  }
+			, { .name = "once", .key = KEY_ONCE
+			  , .doc = "Print the current view once and exit"
+			  }
+			, { .name = NULL }
+			}
+		, .parser = argparse_opt
+		, .args_doc = "FILE"
+		, .doc = "thrlab-top -- watch a shop run with thrlab --stats=FILE,"
+		         " until it closes"
+		};
+
+	struct arguments arguments = (struct arguments)
+		{ .interval_ms = 500
+		, .once = 0
+		, .path = NULL
+		};
+
+	argp_parse (&argp, argc, argv, 0, NULL, &arguments);
+
+	const struct stats_page *page;
+	size_t size;
+
+	if (stats_map (arguments.path, &page, &size) != 0)
+	{
+		if (errno == EINVAL)
+			fprintf (stderr, "%s: not a thrlab stats file\n", arguments.path);
+		else
+			perror (arguments.path);
+
+		return EXIT_FAILURE;
+	}
+
+	struct stats_page *view = malloc (size);
+	struct stats_page *last = malloc (size);
+	if (view == NULL || last == NULL) goto error_memory;
+
+	int tty = isatty (STDOUT_FILENO);
+	int first = 1;
+
+	while (1)
+	{
+		stats_snapshot (page, size, view);
+
+		/* home and clear */
+		if (tty)
+			printf ("\033[H\033[2J");
+		else if (!first)
+			printf ("\n");
+
+		print_view (view, first ? NULL : last);
+		fflush (stdout);
+
+		if (arguments.once || !view->open)
+			break;
+
+		struct stats_page *swap = last;
+
+		last = view;
+		view = swap;
+		first = 0;
+
+		usleep (arguments.interval_ms * 1000);
+	}
+
+	free (last);
+	free (view);
+	munmap ((void *) page, size);
+
+	return EXIT_SUCCESS;
+
+error_memory:
+	free (last);
+	free (view);
+	munmap ((void *) page, size);
+
+	perror ("thrlab-top");
+	return EXIT_FAILURE;
+}
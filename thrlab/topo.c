@@ -0,0 +1,242 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "topo.h"
+
+/**
+ * Parse a sysfs CPU list like "0-3,8,10-11" into `set`.
+ */
+static int topo_parse_list (const char *list, cpu_set_t *set)
+{
+	const char *p = list;
+
+	CPU_ZERO (set);
+
+	while (*p && *p != '\n')
+	{
+		char *end;
+		long from = strtol (p, &end, 10);
+		long to = from;
+
+		if (end == p) return -1;
+
+		if (*end == '-')
+		{
+			p = end + 1;
+			to = strtol (p, &end, 10);
+			if (end == p) return -1;
+		}
+
+		for (long cpu = from; cpu <= to && cpu < CPU_SETSIZE; ++cpu)
+			CPU_SET (cpu, set);
+
+		p = (*end == ',') ? end + 1 : end;
+	}
+
+	return 0;
+}
+
+static int topo_read_list (const char *path, cpu_set_t *set)
+{
+	char buf[4096];
+	FILE *file = fopen (path, "r");
+
+	if (file == NULL) return -1;
+
+	char *line = fgets (buf, sizeof (buf), file);
+
+	fclose (file);
+
+	return line ? topo_parse_list (line, set) : -1;
+}
+
+static int topo_compact_compare (const void *a, const void *b)
+{
+	const struct topo_cpu *x = a;
+	const struct topo_cpu *y = b;
+
+	if (x->node != y->node) return x->node - y->node;
+	if (x->core != y->core) return x->core - y->core;
+	return x->sibling - y->sibling;
+}
+
+static int topo_spread_compare (const void *a, const void *b)
+{
+	const struct topo_cpu *x = a;
+	const struct topo_cpu *y = b;
+
+	if (x->sibling != y->sibling) return x->sibling - y->sibling;
+	if (x->slot != y->slot) return x->slot - y->slot;
+	return x->node - y->node;
+}
+
+/**
+ * Which node each CPU's on, from /sys/devices/system/node/node*\/cpulist.
+ */
+static void topo_read_nodes (struct topo *topo)
+{
+	DIR *dir = opendir ("/sys/devices/system/node");
+
+	if (dir == NULL) return;
+
+	struct dirent *entry;
+
+	while ((entry = readdir (dir)) != NULL)
+	{
+		char path[512];
+		char *end;
+		cpu_set_t set;
+
+		if (strncmp (entry->d_name, "node", 4) != 0)
+			continue;
+
+		long node = strtol (entry->d_name + 4, &end, 10);
+
+		if (end == entry->d_name + 4 || *end)
+			continue;
+
+		snprintf (path, sizeof (path), "/sys/devices/system/node/%s/cpulist", entry->d_name);
+
+		if (topo_read_list (path, &set) != 0)
+			continue;
+
+		for (size_t i = 0; i < topo->num_cpus; ++i)
+		{
+			if (CPU_ISSET (topo->compact[i].cpu, &set))
+				topo->compact[i].node = node;
+		}
+	}
+
+	closedir (dir);
+}
+
+/**
+ * Which core each CPU's on, and which of its hyperthreads it is.
+ */
+static void topo_read_cores (struct topo *topo)
+{
+	for (size_t i = 0; i < topo->num_cpus; ++i)
+	{
+		struct topo_cpu *cpu = &topo->compact[i];
+		char path[512];
+		cpu_set_t set;
+
+		snprintf
+			( path
+			, sizeof (path)
+			, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list"
+			, cpu->cpu
+			);
+
+		if (topo_read_list (path, &set) != 0)
+			continue;
+
+		cpu->sibling = 0;
+		cpu->core = cpu->cpu;
+
+		for (int j = 0; j < cpu->cpu; ++j)
+		{
+			if (!CPU_ISSET (j, &set)) continue;
+
+			if (j < cpu->core) cpu->core = j;
+			++cpu->sibling;
+		}
+	}
+}
+
+int topo_load (struct topo *topo)
+{
+	assert (topo);
+
+	cpu_set_t allowed;
+
+	if (sched_getaffinity (0, sizeof (allowed), &allowed) != 0)
+		return -1;
+
+	topo->num_cpus = CPU_COUNT (&allowed);
+	topo->compact = calloc (topo->num_cpus, sizeof (*topo->compact));
+	topo->spread = calloc (topo->num_cpus, sizeof (*topo->spread));
+
+	if (topo->compact == NULL || topo->spread == NULL)
+	{
+		topo_free (topo);
+		return -1;
+	}
+
+	for (int cpu = 0, i = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if (!CPU_ISSET (cpu, &allowed)) continue;
+
+		topo->compact[i++] = (struct topo_cpu)
+			{ .cpu = cpu, .node = 0, .core = cpu, .sibling = 0, .slot = 0 };
+	}
+
+	topo_read_nodes (topo);
+	topo_read_cores (topo);
+
+	qsort (topo->compact, topo->num_cpus, sizeof (*topo->compact), topo_compact_compare);
+
+	/* count nodes, and number each node's CPUs of a kind in compact order */
+	topo->num_nodes = 0;
+
+	for (size_t i = 0; i < topo->num_cpus; ++i)
+	{
+		struct topo_cpu *cpu = &topo->compact[i];
+
+		if (i == 0 || cpu->node != topo->compact[i - 1].node)
+			++topo->num_nodes;
+
+		cpu->slot = 0;
+
+		for (size_t j = i; j-- > 0 && topo->compact[j].node == cpu->node; )
+		{
+			if (topo->compact[j].sibling == cpu->sibling)
+				++cpu->slot;
+		}
+	}
+
+	memcpy (topo->spread, topo->compact, topo->num_cpus * sizeof (*topo->spread));
+	qsort (topo->spread, topo->num_cpus, sizeof (*topo->spread), topo_spread_compare);
+
+	return 0;
+}
+
+void topo_free (struct topo *topo)
+{
+	assert (topo);
+
+	free (topo->compact);
+	free (topo->spread);
+}
+
+const struct topo_cpu *topo_pick (const struct topo *topo, enum topo_order order, size_t i)
+{
+	assert (topo);
+	assert (topo->num_cpus > 0);
+
+	const struct topo_cpu *cpus = (order == TOPO_SPREAD) ? topo->spread : topo->compact;
+
+	return &cpus[i % topo->num_cpus];
+}
+
+void topo_nodes_of (const struct topo *topo, enum topo_order order, size_t n, cpu_set_t *set)
+{
+	assert (topo);
+	assert (set);
+
+	CPU_ZERO (set);
+
+	for (size_t i = 0; i < n && i < topo->num_cpus; ++i)
+	{
+		int node = topo_pick (topo, order, i)->node;
+
+		for (size_t j = 0; j < topo->num_cpus; ++j)
+		{
+			if (topo->compact[j].node == node)
+				CPU_SET (topo->compact[j].cpu, set);
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#ifndef _THRLAB_TOPO_H_
+#define _THRLAB_TOPO_H_
+
+#include <sched.h> /* cpu_set_t, with _GNU_SOURCE */
+#include <stddef.h>
+
+/**
+ * Ways of handing out CPUs.
+ */
+enum topo_order
+{
+	TOPO_COMPACT, /* fill a node, core by core with hyperthreads together */
+	TOPO_SPREAD /* one per node in turn, whole cores before hyperthreads */
+};
+
+/**
+ * A CPU we may run on, and where it sits.
+ */
+struct topo_cpu
+{
+	int cpu;
+	int node;
+	int core; /* lowest-numbered CPU sharing the core */
+	int sibling; /* position among the core's hyperthreads */
+	int slot; /* position among the node's CPUs with the same `sibling` */
+};
+
+/**
+ * The CPUs this process may use, in each order, from sysfs. Machines without
+ * /sys/devices/system/node look like a single node.
+ */
+struct topo
+{
+	size_t num_cpus;
+	size_t num_nodes; /* nodes with a CPU we may use */
+	struct topo_cpu *compact;
+	struct topo_cpu *spread;
+};
+
+/**
+ * Read the topology.
+ *
+ * Returns 0 on success.
+ */
+int topo_load (struct topo *topo);
+
+void topo_free (struct topo *topo);
+
+/**
+ * The `i`th CPU handed out in order `order`, wrapping around.
+ */
+const struct topo_cpu *topo_pick (const struct topo *topo, enum topo_order order, size_t i);
+
+/**
+ * Every CPU we may use on the nodes of the first `n` CPUs in order `order`.
+ */
+void topo_nodes_of (const struct topo *topo, enum topo_order order, size_t n, cpu_set_t *set);
+
+#endif
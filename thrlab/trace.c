@@ -0,0 +1,332 @@
+#define _DEFAULT_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+
+/* most slots claimed by a thread at a time */
+#define TRACE_CHUNK 64
+
+static struct
+{
+	bool enabled;
+	int fd;
+	struct timespec start;
+	struct timespec (*now) ();
+
+	struct trace_header *header;
+	struct trace_record *records;
+	size_t capacity;
+	size_t size; /* bytes mapped */
+	size_t chunk; /* most slots claimed at a time */
+} tracer =
+	{ .enabled = false
+	};
+
+/* the calling thread's current chunk */
+static __thread size_t trace_next = 0;
+static __thread size_t trace_end = 0;
+
+/* and the size of its next; a thread starts with single slots and doubles
+ * from there, so a customer's few events don't each cost a whole chunk */
+static __thread size_t trace_chunk = 1;
+
+int trace_open
+	( const char *path
+	, size_t capacity
+	, struct timespec start
+	, struct timespec (*now) ()
+	, unsigned int barbers
+	, unsigned int chairs
+	, size_t rate
+	, unsigned int flags
+	)
+{
+	assert (path);
+	assert (capacity > 0);
+	assert (now);
+
+	int status;
+
+	tracer.fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (tracer.fd == -1) goto error_open;
+
+	tracer.size = sizeof (struct trace_header)
+		+ capacity * sizeof (struct trace_record);
+
+	status = ftruncate (tracer.fd, tracer.size);
+	if (status != 0) goto error_truncate;
+
+	tracer.header = mmap
+		( NULL
+		, tracer.size
+		, PROT_READ | PROT_WRITE
+		, MAP_SHARED
+		, tracer.fd
+		, 0
+		);
+	if (tracer.header == MAP_FAILED) goto error_truncate;
+
+	memcpy (tracer.header->magic, TRACE_MAGIC, sizeof (tracer.header->magic));
+	tracer.header->version = TRACE_VERSION;
+	tracer.header->record_size = sizeof (struct trace_record);
+	tracer.header->capacity = capacity;
+	atomic_init (&tracer.header->claimed, 0);
+	tracer.header->barbers = barbers;
+	tracer.header->chairs = chairs;
+	tracer.header->rate = rate;
+	tracer.header->flags = flags;
+
+	tracer.records = (struct trace_record *) (tracer.header + 1);
+	tracer.capacity = capacity;
+	tracer.chunk = (flags & TRACE_RECORD_ONLY) ? 1 : TRACE_CHUNK;
+	tracer.start = start;
+	tracer.now = now;
+	tracer.enabled = true;
+
+	return 0;
+
+error_truncate:
+	close (tracer.fd);
+
+error_open:
+	perror (path);
+	return -1;
+}
+
+int trace_enabled ()
+{
+	return tracer.enabled;
+}
+
+/**
+ * Claim the calling thread's next slot and stamp it with the time.
+ */
+static struct trace_record *trace_claim ()
+{
+	struct timespec now = tracer.now ();
+
+	if (trace_next == trace_end)
+	{
+		size_t chunk = (trace_chunk < tracer.chunk) ? trace_chunk : tracer.chunk;
+
+		trace_next = atomic_fetch_add_explicit
+			( &tracer.header->claimed
+			, chunk
+			, memory_order_relaxed
+			);
+		trace_end = trace_next + chunk;
+		trace_chunk = 2 * chunk;
+
+		/* a wrapped chunk still holds old records; a fresh one is zero,
+		 * and a chunk straddling the wrap is only stale past it */
+		size_t i = (trace_next > tracer.capacity) ? trace_next : tracer.capacity;
+		for (; i < trace_end; ++i)
+			memset (&tracer.records[i % tracer.capacity], 0, sizeof (struct trace_record));
+	}
+
+	struct trace_record *record = &tracer.records[trace_next++ % tracer.capacity];
+
+	record->ns
+		= (uint64_t) (now.tv_sec - tracer.start.tv_sec) * 1000000000
+		+ now.tv_nsec - tracer.start.tv_nsec;
+
+	return record;
+}
+
+void trace_event
+	( enum trace_type type
+	, unsigned int customer
+	, unsigned int room
+	, unsigned int detail
+	)
+{
+	if (!tracer.enabled)
+		return;
+
+	struct trace_record *record = trace_claim ();
+
+	record->customer = customer;
+	record->room = room;
+	record->type = type;
+	record->detail = detail;
+	record->cut_ms = 0;
+}
+
+void trace_arrive (unsigned int customer, unsigned int name, uint32_t cut_ms)
+{
+	if (!tracer.enabled)
+		return;
+
+	struct trace_record *record = trace_claim ();
+
+	record->customer = customer;
+	record->room = TRACE_NO_ROOM;
+	record->type = TRACE_ARRIVE;
+	record->detail = name;
+	record->cut_ms = cut_ms;
+}
+
+void trace_forked ()
+{
+	/* the forking thread's chunk is still the parent's to fill */
+	trace_next = 0;
+	trace_end = 0;
+	trace_chunk = 1;
+}
+
+void trace_close ()
+{
+	if (!tracer.enabled)
+		return;
+
+	tracer.enabled = false;
+
+	size_t claimed = atomic_load (&tracer.header->claimed);
+
+	munmap (tracer.header, tracer.size);
+
+	/* drop the slots that were never claimed */
+	if (claimed < tracer.capacity)
+	{
+		int status = ftruncate
+			( tracer.fd
+			, sizeof (struct trace_header)
+			  + claimed * sizeof (struct trace_record)
+			);
+		if (status != 0) perror ("trace");
+	}
+
+	close (tracer.fd);
+}
+
+/**
+ * A record, and where it was found in the file, to keep sorting stable.
+ */
+struct trace_event
+{
+	struct trace_record record;
+	size_t index;
+};
+
+static int trace_event_compare (const void *a, const void *b)
+{
+	const struct trace_event *x = a;
+	const struct trace_event *y = b;
+
+	if (x->record.ns != y->record.ns)
+		return (x->record.ns < y->record.ns) ? -1 : 1;
+
+	return (x->index < y->index) ? -1 : (x->index > y->index);
+}
+
+static int trace_event_compare_claimed (const void *a, const void *b)
+{
+	const struct trace_event *x = a;
+	const struct trace_event *y = b;
+
+	return (x->index < y->index) ? -1 : (x->index > y->index);
+}
+
+ssize_t trace_read
+	( const char *path
+	, struct trace_header *header
+	, struct trace_record **records
+	)
+{
+	assert (path);
+	assert (header);
+	assert (records);
+
+	struct stat st;
+	struct trace_event *events = NULL;
+	ssize_t count = -1;
+	int error = EINVAL;
+
+	int fd = open (path, O_RDONLY);
+	if (fd == -1) return -1;
+
+	if (fstat (fd, &st) != 0) goto error_stat;
+
+	if ((size_t) st.st_size < sizeof (struct trace_header)) goto done;
+
+	void *map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) goto error_stat;
+
+	*header = *(const struct trace_header *) map;
+
+	if (memcmp (header->magic, TRACE_MAGIC, sizeof (header->magic)) != 0
+		|| header->version != TRACE_VERSION
+		|| header->record_size != sizeof (struct trace_record))
+		goto done_map;
+
+	const struct trace_record *slots = (const struct trace_record *)
+		((const struct trace_header *) map + 1);
+	size_t num_slots = (st.st_size - sizeof (*header)) / sizeof (*slots);
+
+	events = malloc ((num_slots + 1) * sizeof (*events));
+	*records = malloc ((num_slots + 1) * sizeof (**records));
+	if (events == NULL || *records == NULL)
+	{
+		error = ENOMEM;
+		free (*records);
+		goto done_map;
+	}
+
+	/* once wrapped, the oldest slot is the one after the last claimed */
+	size_t oldest = (header->claimed > num_slots) ? header->claimed % num_slots : 0;
+
+	count = 0;
+
+	for (size_t i = 0; i < num_slots; ++i)
+	{
+		if (slots[i].type == TRACE_NONE || slots[i].type > TRACE_LEAVE)
+			continue;
+
+		events[count].record = slots[i];
+		events[count].index = (i + num_slots - oldest) % num_slots;
+		++count;
+	}
+
+	qsort
+		( events
+		, count
+		, sizeof (*events)
+		, (header->flags & TRACE_RECORD_ONLY)
+		  ? trace_event_compare_claimed
+		  : trace_event_compare
+		);
+
+	for (ssize_t i = 0; i < count; ++i)
+		(*records)[i] = events[i].record;
+
+	error = 0;
+
+done_map:
+	munmap (map, st.st_size);
+
+done:
+	free (events);
+	close (fd);
+
+	if (error)
+	{
+		errno = error;
+		return -1;
+	}
+
+	return count;
+
+error_stat:
+	close (fd);
+	return -1;
+}
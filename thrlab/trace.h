@@ -0,0 +1,145 @@
+#ifndef _THRLAB_TRACE_H_
+#define _THRLAB_TRACE_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define TRACE_MAGIC "THRTRACE"
+#define TRACE_VERSION 2
+
+enum trace_type
+{
+	TRACE_NONE, /* unused slot */
+	TRACE_ARRIVE,
+	TRACE_ACCEPT,
+	TRACE_REJECT,
+	TRACE_PREPARE,
+	TRACE_DISMISS,
+	TRACE_LEAVE /* the customer's thread is done with them */
+};
+
+/**
+ * What the harness made of an event; matches the line it would have logged.
+ */
+enum trace_outcome
+{
+	TRACE_OK, /* the expected transition */
+	TRACE_CONFUSED, /* the customer wasn't in a state for this */
+	TRACE_SELF, /* the customer's own thread did the barber's job */
+	TRACE_BUSY, /* prepared in a room that was already taken */
+	TRACE_ROOM, /* dismissed from a room they weren't in */
+	TRACE_SHOP /* prepared or dismissed by another shop's barber */
+};
+
+/**
+ * How a trace was recorded.
+ */
+enum trace_flags
+{
+	/* with thrlab --record-only: nothing was checked, so the outcome of a
+	 * prepare or dismiss only says whether the customer's own thread did
+	 * it (TRACE_SELF) or not (TRACE_OK), and of anything else is TRACE_OK.
+	 * Slots are claimed one at a time, so the file is in the order events
+	 * happened. */
+	TRACE_RECORD_ONLY = 1
+};
+
+/**
+ * A fixed-size trace record.
+ */
+struct trace_record
+{
+	uint64_t ns; /* nanoseconds since the shop opened */
+	uint32_t customer;
+	uint16_t room; /* TRACE_NO_ROOM when not applicable */
+	uint8_t type; /* enum trace_type */
+	uint8_t detail; /* enum trace_outcome, or the name index on arrival */
+	uint32_t cut_ms; /* on arrival, how long the haircut should take */
+};
+
+#define TRACE_NO_ROOM UINT16_MAX
+
+/**
+ * Start of a trace file, followed by `capacity` records. Records are claimed
+ * in per-thread chunks that grow from a single slot, so they are only roughly
+ * in time order, and once the trace wraps the oldest records are overwritten.
+ */
+struct trace_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t capacity;
+	_Atomic uint64_t claimed; /* slots claimed so far, counted in place */
+	uint32_t barbers;
+	uint32_t chairs;
+	uint64_t rate;
+	uint32_t flags; /* enum trace_flags */
+};
+
+/**
+ * Map a trace file of `capacity` records at `path`. Events are stamped with
+ * `now ()` relative to `start`. `flags` are enum trace_flags.
+ *
+ * Returns 0 on success.
+ */
+int trace_open
+	( const char *path
+	, size_t capacity
+	, struct timespec start
+	, struct timespec (*now) ()
+	, unsigned int barbers
+	, unsigned int chairs
+	, size_t rate
+	, unsigned int flags
+	);
+
+/**
+ * Whether a trace is being recorded.
+ */
+int trace_enabled ();
+
+/**
+ * Record an event, if tracing.
+ */
+void trace_event
+	( enum trace_type type
+	, unsigned int customer
+	, unsigned int room
+	, unsigned int detail
+	);
+
+/**
+ * Record an arrival, if tracing; `name` indexes customer_names.
+ */
+void trace_arrive (unsigned int customer, unsigned int name, uint32_t cut_ms);
+
+/**
+ * Carry on tracing in a child forked since `trace_open`, into the same file.
+ * Call it in the child before it records anything.
+ */
+void trace_forked ();
+
+/**
+ * Finish the trace file and unmap it.
+ */
+void trace_close ();
+
+/**
+ * Load the trace at `path` into `*records`, in time order, skipping unused
+ * slots; a TRACE_RECORD_ONLY trace is kept in the order events happened,
+ * which is also time order but settles ties. The caller frees `*records`.
+ *
+ * Returns the number of records, or -1 with errno set; EINVAL means the file
+ * isn't a trace.
+ */
+ssize_t trace_read
+	( const char *path
+	, struct trace_header *header
+	, struct trace_record **records
+	);
+
+#endif
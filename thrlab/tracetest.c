@@ -0,0 +1,96 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+
+/******************************************************************************
+ * Trace ring test: a chunk claimed across the wrap
+ *****************************************************************************/
+
+#define TRACETEST_PATH "thrlab-tracetest.trace"
+
+/* a single thread claims 1, 2, 4 and then 8 slots, so the last chunk is
+ * [7, 15) and straddles the wrap at 10 */
+#define TRACETEST_CAPACITY 10
+#define TRACETEST_EVENTS 11
+
+/* slots 10 to 14 wrap onto 0 to 4; only slot 0 is written again */
+#define TRACETEST_OLDEST 5
+
+static struct timespec tracetest_clock;
+
+static struct timespec tracetest_now ()
+{
+	++tracetest_clock.tv_nsec;
+	return tracetest_clock;
+}
+
+int main ()
+{
+	struct trace_header header;
+	struct trace_record *records;
+	struct timespec start = { 0, 0 };
+	int failed = 0;
+
+	if (trace_open
+		( TRACETEST_PATH
+		, TRACETEST_CAPACITY
+		, start
+		, tracetest_now
+		, 1
+		, 1
+		, 0
+		, 0
+		) != 0)
+		return EXIT_FAILURE;
+
+	for (unsigned int customer = 0; customer < TRACETEST_EVENTS; ++customer)
+		trace_event (TRACE_ACCEPT, customer, TRACE_NO_ROOM, TRACE_OK);
+
+	trace_close ();
+
+	ssize_t count = trace_read (TRACETEST_PATH, &header, &records);
+	unlink (TRACETEST_PATH);
+
+	if (count == -1)
+	{
+		perror (TRACETEST_PATH);
+		return EXIT_FAILURE;
+	}
+
+	if (count != TRACETEST_EVENTS - TRACETEST_OLDEST)
+	{
+		fprintf
+			( stderr
+			, "read %zd records, expected %d\n"
+			, count
+			, TRACETEST_EVENTS - TRACETEST_OLDEST
+			);
+		failed = 1;
+	}
+
+	for (ssize_t i = 0; i < count; ++i)
+	{
+		if ((ssize_t) records[i].customer == TRACETEST_OLDEST + i)
+			continue;
+
+		fprintf
+			( stderr
+			, "record %zd is customer %u, expected %zd\n"
+			, i
+			, records[i].customer
+			, TRACETEST_OLDEST + i
+			);
+		failed = 1;
+	}
+
+	free (records);
+
+	if (failed)
+		return EXIT_FAILURE;
+
+	printf ("trace: a chunk claimed across the wrap left no stale records\n");
+	return EXIT_SUCCESS;
+}
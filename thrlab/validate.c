@@ -0,0 +1,422 @@
+#define _DEFAULT_SOURCE
+#include <argp.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "complaint.h"
+#include "trace.h"
+
+/******************************************************************************
+ * thrlab-validate: check a day recorded with thrlab --record-only
+ *****************************************************************************/
+
+/* exit statuses, besides EXIT_SUCCESS for a day without complaints */
+#define EXIT_COMPLAINTS 1
+#define EXIT_UNCHECKED 2
+
+/* an empty room */
+#define VACANT UINT32_MAX
+
+struct arguments
+{
+	int verbose;
+	const char *path;
+};
+
+/**
+ * Where a customer is, as the harness would have tracked it.
+ */
+enum status
+{
+	STATUS_UNSEEN, /* never arrived in this trace */
+	STATUS_PENDING,
+	STATUS_WAITING,
+	STATUS_CUTTING,
+	STATUS_DONE,
+	STATUS_REJECTED
+};
+
+struct customer
+{
+	enum status status;
+	uint64_t cut_ns; /* how long the haircut should take */
+	uint64_t prepared;
+};
+
+/**
+ * The shop, replayed one transition at a time.
+ */
+struct shop
+{
+	const struct trace_header *header;
+	struct customer *customers;
+	size_t num_customers;
+	uint32_t *rooms; /* who's in each, or VACANT */
+
+	size_t cutting;
+	size_t waiting;
+	size_t pending;
+
+	size_t counts[NUM_COMPLAINTS];
+	int verbose;
+};
+
+static void complain
+	( struct shop *shop
+	, const struct trace_record *r
+	, enum complaint complaint
+	)
+{
+	++shop->counts[complaint];
+
+	if (shop->verbose)
+	{
+		printf
+			( "%9.3f: #%u %s\n"
+			, r->ns / 1000000000.0
+			, r->customer
+			, complaints[complaint].name
+			);
+	}
+}
+
+static void shop_arrive (struct shop *shop, const struct trace_record *r)
+{
+	struct customer *c = &shop->customers[r->customer];
+
+	c->status = STATUS_PENDING;
+	c->cut_ns = (uint64_t) r->cut_ms * 1000000;
+	++shop->pending;
+}
+
+static void shop_accept (struct shop *shop, const struct trace_record *r)
+{
+	struct customer *c = &shop->customers[r->customer];
+
+	switch (c->status)
+	{
+		case STATUS_UNSEEN:
+			break;
+		case STATUS_PENDING:
+			if (shop->waiting >= shop->header->chairs)
+				complain (shop, r, COMPLAINT_ACCEPT_FULL);
+
+			c->status = STATUS_WAITING;
+			++shop->waiting;
+			--shop->pending;
+			break;
+		case STATUS_WAITING:
+			complain (shop, r, COMPLAINT_ACCEPT_WAIT);
+			break;
+		case STATUS_CUTTING:
+			complain (shop, r, COMPLAINT_ACCEPT_CUT);
+			break;
+		case STATUS_DONE:
+			complain (shop, r, COMPLAINT_ACCEPT_DONE);
+			break;
+		case STATUS_REJECTED:
+			complain (shop, r, COMPLAINT_ACCEPT_REJECT);
+			break;
+	}
+}
+
+static void shop_reject (struct shop *shop, const struct trace_record *r)
+{
+	struct customer *c = &shop->customers[r->customer];
+
+	switch (c->status)
+	{
+		case STATUS_UNSEEN:
+			break;
+		case STATUS_PENDING:
+			if (shop->header->chairs > shop->waiting)
+				complain (shop, r, COMPLAINT_REJECT_AVAIL);
+
+			c->status = STATUS_REJECTED;
+			--shop->pending;
+			break;
+		case STATUS_WAITING:
+			complain (shop, r, COMPLAINT_REJECT_WAIT);
+			break;
+		case STATUS_CUTTING:
+			complain (shop, r, COMPLAINT_REJECT_CUT);
+			break;
+		case STATUS_DONE:
+			complain (shop, r, COMPLAINT_REJECT_DONE);
+			break;
+		case STATUS_REJECTED:
+			complain (shop, r, COMPLAINT_REJECT_AGAIN);
+			break;
+	}
+}
+
+static void shop_prepare (struct shop *shop, const struct trace_record *r)
+{
+	struct customer *c = &shop->customers[r->customer];
+	uint32_t *room = &shop->rooms[r->room];
+
+	if (*room != VACANT && *room != r->customer)
+	{
+		complain (shop, r, COMPLAINT_PREPARE_BUSY);
+		return;
+	}
+
+	switch (c->status)
+	{
+		case STATUS_UNSEEN:
+			break;
+		case STATUS_PENDING:
+			complain (shop, r, COMPLAINT_PREPARE_PENDING);
+			break;
+		case STATUS_WAITING:
+			if (r->detail == TRACE_SELF)
+				complain (shop, r, COMPLAINT_PREPARE_SELF);
+
+			if (*room != VACANT)
+			{
+				complain (shop, r, COMPLAINT_PREPARE_BUSY);
+				break;
+			}
+
+			*room = r->customer;
+			c->status = STATUS_CUTTING;
+			c->prepared = r->ns;
+			++shop->cutting;
+			--shop->waiting;
+			break;
+		case STATUS_CUTTING:
+			complain (shop, r, COMPLAINT_PREPARE_AGAIN);
+			break;
+		case STATUS_DONE:
+			complain (shop, r, COMPLAINT_PREPARE_DONE);
+			break;
+		case STATUS_REJECTED:
+			complain (shop, r, COMPLAINT_PREPARE_REJECT);
+			break;
+	}
+}
+
+static void shop_dismiss (struct shop *shop, const struct trace_record *r)
+{
+	struct customer *c = &shop->customers[r->customer];
+	uint32_t *room = &shop->rooms[r->room];
+
+	if (*room != r->customer)
+	{
+		complain (shop, r, COMPLAINT_DISMISS_ROOM);
+		return;
+	}
+
+	switch (c->status)
+	{
+		case STATUS_UNSEEN:
+			break;
+		case STATUS_PENDING:
+			complain (shop, r, COMPLAINT_DISMISS_PENDING);
+			break;
+		case STATUS_WAITING:
+			complain (shop, r, COMPLAINT_DISMISS_WAIT);
+			break;
+		case STATUS_CUTTING:;
+			uint64_t dt = r->ns - c->prepared;
+
+			if (r->detail == TRACE_SELF)
+				complain (shop, r, COMPLAINT_DISMISS_SELF);
+
+			if (dt < c->cut_ns)
+				complain (shop, r, COMPLAINT_CUT_FAST);
+
+			if (dt >= 2 * c->cut_ns)
+				complain (shop, r, COMPLAINT_CUT_SLOW);
+
+			*room = VACANT;
+			c->status = STATUS_DONE;
+			--shop->cutting;
+			break;
+		case STATUS_DONE:
+			complain (shop, r, COMPLAINT_DISMISS_DONE);
+			break;
+		case STATUS_REJECTED:
+			complain (shop, r, COMPLAINT_DISMISS_REJECT);
+			break;
+	}
+}
+
+static void shop_leave (struct shop *shop, const struct trace_record *r)
+{
+	if (shop->customers[r->customer].status == STATUS_CUTTING)
+		complain (shop, r, COMPLAINT_DISMISS_EARLY);
+}
+
+static error_t argparse_opt
+	( int key
+	, char *arg
+	, struct argp_state *state
+	)
+{
+	struct arguments *arguments = state->input;
+
+	switch (key)
+	{
+		case 'v':
+			arguments->verbose = 1;
+			break;
+		case ARGP_KEY_ARG:
+			if (arguments->path) argp_usage (state);
+			arguments->path = arg;
+			break;
+		case ARGP_KEY_END:
+			if (arguments->path == NULL) argp_usage (state);
+			break;
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+
+	return 0;
+}
+
+int main (int argc, char **argv)
+{
+	const struct argp argp =
+		{ .options = (struct argp_option [])
+			{ { .name = "verbose", .key = 'v'
+			  , .doc = "Print each complaint as it comes up"
+			  }
+			, { .name = NULL }
+			}
+		, .parser = argparse_opt
+		, .args_doc = "TRACE"
+		, .doc = "thrlab-validate -- replay a trace recorded with thrlab"
+		         " --record-only and complain the way thrlab would have."
+		         "\vExits with 0 if nobody complained, 1 if somebody did, or 2"
+		         " if the trace couldn't be checked."
+		};
+
+	struct arguments arguments = (struct arguments)
+		{ .verbose = 0
+		, .path = NULL
+		};
+
+	argp_parse (&argp, argc, argv, 0, NULL, &arguments);
+
+	struct trace_header header;
+	struct trace_record *records;
+	ssize_t count = trace_read (arguments.path, &header, &records);
+
+	if (count == -1)
+	{
+		if (errno == EINVAL)
+			fprintf (stderr, "%s: not a thrlab trace\n", arguments.path);
+		else
+			perror (arguments.path);
+
+		return EXIT_UNCHECKED;
+	}
+
+	if (!(header.flags & TRACE_RECORD_ONLY))
+	{
+		fprintf (stderr, "%s: not recorded with --record-only\n", arguments.path);
+		free (records);
+		return EXIT_UNCHECKED;
+	}
+
+	/* customers who arrived before the oldest record can't be followed */
+	if (header.claimed > header.capacity)
+	{
+		fprintf (stderr, "%s: the trace wrapped around, try a bigger --trace-size\n", arguments.path);
+		free (records);
+		return EXIT_UNCHECKED;
+	}
+
+	struct shop shop = (struct shop)
+		{ .header = &header
+		, .customers = NULL
+		, .num_customers = 0
+		, .rooms = NULL
+		, .cutting = 0
+		, .waiting = 0
+		, .pending = 0
+		, .counts = { 0 }
+		, .verbose = arguments.verbose
+		};
+
+	for (ssize_t i = 0; i < count; ++i)
+	{
+		if (records[i].customer >= shop.num_customers)
+			shop.num_customers = records[i].customer + 1;
+	}
+
+	shop.customers = calloc (shop.num_customers + 1, sizeof (*shop.customers));
+	shop.rooms = malloc ((header.barbers + 1) * sizeof (*shop.rooms));
+	if (shop.customers == NULL || shop.rooms == NULL) goto error_memory;
+
+	for (size_t i = 0; i < header.barbers; ++i)
+		shop.rooms[i] = VACANT;
+
+	for (ssize_t i = 0; i < count; ++i)
+	{
+		const struct trace_record *r = &records[i];
+
+		if ((r->type == TRACE_PREPARE || r->type == TRACE_DISMISS) && r->room >= header.barbers)
+		{
+			fprintf (stderr, "%s: a barber works in room %u, of %u\n", arguments.path, r->room, header.barbers);
+			goto error_trace;
+		}
+
+		switch (r->type)
+		{
+			case TRACE_ARRIVE:
+				shop_arrive (&shop, r);
+				break;
+			case TRACE_ACCEPT:
+				shop_accept (&shop, r);
+				break;
+			case TRACE_REJECT:
+				shop_reject (&shop, r);
+				break;
+			case TRACE_PREPARE:
+				shop_prepare (&shop, r);
+				break;
+			case TRACE_DISMISS:
+				shop_dismiss (&shop, r);
+				break;
+			case TRACE_LEAVE:
+				shop_leave (&shop, r);
+				break;
+		}
+	}
+
+	printf
+		( "%u barbers, %u chairs, %zd events checked\n"
+		, header.barbers
+		, header.chairs
+		, count
+		);
+
+	size_t total = complaint_print (shop.counts, shop.cutting, shop.waiting, shop.pending);
+
+	if (total == 0)
+		printf ("No complaints.\n");
+
+	free (shop.rooms);
+	free (shop.customers);
+	free (records);
+
+	return (total == 0) ? EXIT_SUCCESS : EXIT_COMPLAINTS;
+
+error_trace:
+	free (shop.rooms);
+	free (shop.customers);
+	free (records);
+
+	return EXIT_UNCHECKED;
+
+error_memory:
+	free (shop.rooms);
+	free (shop.customers);
+	free (records);
+
+	fprintf (stderr, "%s: out of memory\n", arguments.path);
+	return EXIT_UNCHECKED;
+}
@@ -0,0 +1,337 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "vclock.h"
+
+/* how long the timekeeper naps when there is nothing to do */
+#define VCLOCK_IDLE_NS 100000
+
+struct vclock_sleeper
+{
+	uint64_t deadline;
+	uint64_t seq; /* breaks ties between equal deadlines */
+	sem_t wake;
+};
+
+/**
+ * What a scan of the process' threads found.
+ */
+struct vclock_task
+{
+	pid_t tid;
+	unsigned long switches;
+};
+
+static struct
+{
+	pthread_mutex_t mtx;
+	pthread_t keeper;
+	pid_t keeper_tid;
+	_Atomic bool stopping;
+
+	_Atomic uint64_t now;
+	uint64_t seq;
+
+	/* min-heap of sleepers on (deadline, seq) */
+	struct vclock_sleeper **heap;
+	size_t len;
+	size_t capacity;
+
+	/* the previous and current scan */
+	struct vclock_task *tasks[2];
+	size_t num_tasks[2];
+	size_t task_capacity[2];
+} vclock =
+	{ .mtx = PTHREAD_MUTEX_INITIALIZER
+	};
+
+static bool vclock_before
+	( const struct vclock_sleeper *a
+	, const struct vclock_sleeper *b
+	)
+{
+	if (a->deadline != b->deadline)
+		return a->deadline < b->deadline;
+
+	return a->seq < b->seq;
+}
+
+static void vclock_push (struct vclock_sleeper *sleeper)
+{
+	if (vclock.len == vclock.capacity)
+	{
+		vclock.capacity = vclock.capacity ? 2 * vclock.capacity : 64;
+		vclock.heap = realloc
+			( vclock.heap
+			, vclock.capacity * sizeof (*vclock.heap)
+			);
+		if (vclock.heap == NULL) exit (EXIT_FAILURE);
+	}
+
+	size_t i = vclock.len++;
+
+	while (i > 0 && vclock_before (sleeper, vclock.heap[(i - 1) / 2]))
+	{
+		vclock.heap[i] = vclock.heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+
+	vclock.heap[i] = sleeper;
+}
+
+static struct vclock_sleeper *vclock_pop ()
+{
+	assert (vclock.len > 0);
+
+	struct vclock_sleeper *top = vclock.heap[0];
+	struct vclock_sleeper *last = vclock.heap[--vclock.len];
+	size_t i = 0;
+
+	while (2 * i + 1 < vclock.len)
+	{
+		size_t child = 2 * i + 1;
+
+		if (child + 1 < vclock.len
+			&& vclock_before (vclock.heap[child + 1], vclock.heap[child]))
+			++child;
+
+		if (!vclock_before (vclock.heap[child], last))
+			break;
+
+		vclock.heap[i] = vclock.heap[child];
+		i = child;
+	}
+
+	vclock.heap[i] = last;
+
+	return top;
+}
+
+/**
+ * Record the state of every thread but the timekeeper in scan `which`.
+ * Returns false as soon as one of them might be running.
+ */
+static bool vclock_scan (int which)
+{
+	DIR *dir = opendir ("/proc/self/task");
+	if (dir == NULL) return false;
+
+	struct dirent *entry;
+	bool blocked = true;
+	char path[64];
+	char buf[2048];
+
+	vclock.num_tasks[which] = 0;
+
+	while (blocked && (entry = readdir (dir)) != NULL)
+	{
+		if (entry->d_name[0] == '.')
+			continue;
+
+		pid_t tid = atoi (entry->d_name);
+
+		if (tid == vclock.keeper_tid)
+			continue;
+
+		snprintf (path, sizeof (path), "/proc/self/task/%d/status", tid);
+
+		int fd = open (path, O_RDONLY);
+		if (fd == -1) continue; /* it just exited */
+
+		ssize_t len = read (fd, buf, sizeof (buf) - 1);
+		close (fd);
+
+		if (len <= 0) continue;
+		buf[len] = '\0';
+
+		const char *state = strstr (buf, "\nState:");
+		const char *voluntary = strstr (buf, "\nvoluntary_ctxt_switches:");
+		const char *involuntary = strstr (buf, "\nnonvoluntary_ctxt_switches:");
+
+		if (state == NULL || voluntary == NULL || involuntary == NULL)
+		{
+			blocked = false;
+			break;
+		}
+
+		state += strlen ("\nState:");
+		while (*state == ' ' || *state == '\t') ++state;
+
+		/* sleeping interruptibly, or gone */
+		if (*state != 'S' && *state != 'Z')
+		{
+			blocked = false;
+			break;
+		}
+
+		if (vclock.num_tasks[which] == vclock.task_capacity[which])
+		{
+			vclock.task_capacity[which] = vclock.task_capacity[which]
+				? 2 * vclock.task_capacity[which]
+				: 64;
+			vclock.tasks[which] = realloc
+				( vclock.tasks[which]
+				, vclock.task_capacity[which] * sizeof (**vclock.tasks)
+				);
+			if (vclock.tasks[which] == NULL) exit (EXIT_FAILURE);
+		}
+
+		vclock.tasks[which][vclock.num_tasks[which]++] = (struct vclock_task)
+			{ .tid = tid
+			, .switches
+				= strtoul (voluntary + strlen ("\nvoluntary_ctxt_switches:"), NULL, 10)
+				+ strtoul (involuntary + strlen ("\nnonvoluntary_ctxt_switches:"), NULL, 10)
+			};
+	}
+
+	closedir (dir);
+
+	return blocked;
+}
+
+/**
+ * Whether every other thread is blocked. Two scans must agree, with nobody
+ * having been scheduled in between; otherwise a thread woken behind the
+ * first scan's back could go unnoticed.
+ */
+static bool vclock_quiescent ()
+{
+	if (!vclock_scan (0) || !vclock_scan (1))
+		return false;
+
+	if (vclock.num_tasks[0] != vclock.num_tasks[1])
+		return false;
+
+	for (size_t i = 0; i < vclock.num_tasks[0]; ++i)
+	{
+		if (vclock.tasks[0][i].tid != vclock.tasks[1][i].tid
+			|| vclock.tasks[0][i].switches != vclock.tasks[1][i].switches)
+			return false;
+	}
+
+	return true;
+}
+
+static void vclock_nap ()
+{
+	struct timespec ts = { .tv_sec = 0, .tv_nsec = VCLOCK_IDLE_NS };
+
+	nanosleep (&ts, NULL);
+}
+
+static void *vclock_keeper (void *arg)
+{
+	(void) arg;
+
+	int status;
+
+	vclock.keeper_tid = gettid ();
+
+	while (!atomic_load (&vclock.stopping))
+	{
+		status = pthread_mutex_lock (&vclock.mtx);
+		assert (status == 0);
+
+		bool sleeping = vclock.len > 0;
+
+		status = pthread_mutex_unlock (&vclock.mtx);
+		assert (status == 0);
+
+		if (!sleeping)
+		{
+			vclock_nap ();
+			continue;
+		}
+
+		if (!vclock_quiescent ())
+		{
+			sched_yield ();
+			continue;
+		}
+
+		status = pthread_mutex_lock (&vclock.mtx);
+		assert (status == 0);
+
+		struct vclock_sleeper *next = vclock_pop ();
+
+		if (next->deadline > atomic_load (&vclock.now))
+			atomic_store (&vclock.now, next->deadline);
+
+		sem_post (&next->wake);
+
+		status = pthread_mutex_unlock (&vclock.mtx);
+		assert (status == 0);
+	}
+
+	return NULL;
+}
+
+int vclock_init ()
+{
+	int status;
+
+	atomic_init (&vclock.now, 0);
+	atomic_init (&vclock.stopping, false);
+	vclock.seq = 0;
+	vclock.heap = NULL;
+	vclock.len = 0;
+	vclock.capacity = 0;
+
+	status = pthread_create (&vclock.keeper, NULL, vclock_keeper, NULL);
+	if (status != 0) return -1;
+
+	return 0;
+}
+
+uint64_t vclock_now ()
+{
+	return atomic_load (&vclock.now);
+}
+
+void vclock_sleep (uint64_t ns)
+{
+	int status;
+	struct vclock_sleeper sleeper;
+
+	status = sem_init (&sleeper.wake, 0, 0);
+	assert (status == 0);
+
+	status = pthread_mutex_lock (&vclock.mtx);
+	assert (status == 0);
+
+	sleeper.deadline = atomic_load (&vclock.now) + ns;
+	sleeper.seq = vclock.seq++;
+	vclock_push (&sleeper);
+
+	status = pthread_mutex_unlock (&vclock.mtx);
+	assert (status == 0);
+
+	while (sem_wait (&sleeper.wake) == -1)
+		assert (errno == EINTR);
+
+	sem_destroy (&sleeper.wake);
+}
+
+void vclock_shutdown ()
+{
+	atomic_store (&vclock.stopping, true);
+
+	int status = pthread_join (vclock.keeper, NULL);
+	assert (status == 0);
+
+	free (vclock.heap);
+	free (vclock.tasks[0]);
+	free (vclock.tasks[1]);
+}
@@ -0,0 +1,37 @@
+#ifndef _THRLAB_VCLOCK_H_
+#define _THRLAB_VCLOCK_H_
+
+#include <stdint.h>
+
+/**
+ * A virtual clock for discrete-event simulation.
+ *
+ * Sleeping threads are queued on their wake-up time. Whenever every other
+ * thread in the process is blocked, the clock jumps to the earliest wake-up
+ * time and wakes that one sleeper. Sleepers due at the same time are woken
+ * one at a time, in the order they went to sleep.
+ */
+
+/**
+ * Start the clock at zero.
+ *
+ * Returns 0 on success.
+ */
+int vclock_init ();
+
+/**
+ * Nanoseconds of virtual time elapsed since `vclock_init`.
+ */
+uint64_t vclock_now ();
+
+/**
+ * Block the calling thread for `ns` nanoseconds of virtual time.
+ */
+void vclock_sleep (uint64_t ns);
+
+/**
+ * Stop the clock. Threads still sleeping are never woken.
+ */
+void vclock_shutdown ();
+
+#endif